@@ -0,0 +1,93 @@
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+#include "../src/ErrorLogger/ErrorLogger.hpp"
+#include "../src/Scanner/Scanner.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Measures how fast the scanner turns source code into tokens
+//
+// Usage: wisScannerBench [iterations] [files...]
+//
+// Every file is scanned `iterations` times (10 by default) and the fastest run is reported. Without any files, a
+// source of a few megabytes made up of typical code is generated and scanned instead. Build with WIS_NO_SIMD defined
+// to measure the scanner without the vectorized runs from Runs.cpp
+namespace {
+std::string generated_source() {
+    const std::string function =
+        "fn fibonacci_with_a_long_name(n: int, memo: ref [int]) -> int {\n"
+        "    if (n < 2) { return n; }\n"
+        "    var total: int = 0\n"
+        "    for (var i = 0; i < size(memo); ++i) {\n"
+        "        total += memo[i] * 3 / 2 + 1 - 42 // Comments are skipped\n"
+        "    }\n"
+        "    /* As are\n       multiline comments */\n"
+        "    while (total > 1000 and not false or true) { total = total >> 1; }\n"
+        "    const message: string = \"the total is\\t\" + \"large\"\n"
+        "    return fibonacci_with_a_long_name(n - 1, memo) + total\n"
+        "}\n\n";
+
+    std::string source{};
+    while (source.size() < 4 * 1024 * 1024) {
+        source += function;
+    }
+    return source;
+}
+
+void bench(const std::string &name, std::string_view source, std::size_t iterations) {
+    using clock = std::chrono::steady_clock;
+
+    double best = 0;
+    std::size_t token_count = 0;
+    for (std::size_t i = 0; i < iterations; i++) {
+        std::deque<std::string> strings{};
+        Scanner scanner{source, strings};
+
+        auto start = clock::now();
+        token_count = scanner.scan().size();
+        double seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+        best = (i == 0) ? seconds : std::min(best, seconds);
+    }
+
+    double megabytes = static_cast<double>(source.size()) / (1024.0 * 1024.0);
+    std::cout << name << ": " << source.size() << " bytes, " << token_count << " tokens, best of " << iterations
+              << ": " << best * 1000.0 << " ms (" << megabytes / best << " MB/s, "
+              << static_cast<double>(token_count) / best / 1e6 << " M tokens/s)\n";
+}
+} // namespace
+
+int main(int argc, char **argv) {
+    std::size_t iterations = 10;
+    int first_file = 1;
+    if (argc > 1 && std::all_of(argv[1], argv[1] + std::char_traits<char>::length(argv[1]), ::isdigit)) {
+        iterations = std::max(std::strtoul(argv[1], nullptr, 10), 1ul);
+        first_file = 2;
+    }
+
+    if (first_file >= argc) {
+        std::string source = generated_source();
+        logger.set_source(source);
+        bench("<generated>", source, iterations);
+        return 0;
+    }
+
+    for (int i = first_file; i < argc; i++) {
+        std::ifstream file{argv[i], std::ios::in};
+        if (not file.is_open()) {
+            std::cerr << "Unable to open file '" << argv[i] << "'\n";
+            return 1;
+        }
+        std::string source{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+        logger.set_source(source);
+        bench(argv[i], source, iterations);
+    }
+    return 0;
+}
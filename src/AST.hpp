@@ -6,10 +6,10 @@
 #ifndef AST_HPP
 #define AST_HPP
 
+#include "NodeArena.hpp"
 #include "Token.hpp"
 #include "VisitorTypes.hpp"
 
-#include <memory>
 #include <string>
 #include <string_view>
 #include <tuple>
@@ -19,9 +19,9 @@ struct Expr;
 struct Stmt;
 struct BaseType;
 
-using ExprNode = std::unique_ptr<Expr>;
-using StmtNode = std::unique_ptr<Stmt>;
-using TypeNode = std::unique_ptr<BaseType>;
+using ExprNode = NodeHandle<Expr>;
+using StmtNode = NodeHandle<Stmt>;
+using TypeNode = NodeHandle<BaseType>;
 
 using RequiresCopy = bool;
 
@@ -55,6 +55,7 @@ struct BreakStmt;
 struct ClassStmt;
 struct ContinueStmt;
 struct ExpressionStmt;
+struct ForEachStmt;
 struct FunctionStmt;
 struct IfStmt;
 struct ReturnStmt;
@@ -98,6 +99,7 @@ struct Visitor {
     virtual StmtVisitorType visit(ClassStmt &stmt) = 0;
     virtual StmtVisitorType visit(ContinueStmt &stmt) = 0;
     virtual StmtVisitorType visit(ExpressionStmt &stmt) = 0;
+    virtual StmtVisitorType visit(ForEachStmt &stmt) = 0;
     virtual StmtVisitorType visit(FunctionStmt &stmt) = 0;
     virtual StmtVisitorType visit(IfStmt &stmt) = 0;
     virtual StmtVisitorType visit(ReturnStmt &stmt) = 0;
@@ -140,6 +142,7 @@ enum class NodeType {
     ClassStmt,
     ContinueStmt,
     ExpressionStmt,
+    ForEachStmt,
     FunctionStmt,
     IfStmt,
     ReturnStmt,
@@ -378,14 +381,14 @@ struct ListExpr final : public Expr {
 
     Token bracket{};
     std::vector<ElementType> elements{};
-    std::unique_ptr<ListType> type{};
+    NodeHandle<ListType> type{};
 
     std::string_view string_tag() override final { return "ListExpr"; }
 
     NodeType type_tag() override final { return NodeType::ListExpr; }
 
     ListExpr() = default;
-    ListExpr(Token bracket, std::vector<ElementType> elements, std::unique_ptr<ListType> type)
+    ListExpr(Token bracket, std::vector<ElementType> elements, NodeHandle<ListType> type)
         : bracket{std::move(bracket)}, elements{std::move(elements)}, type{std::move(type)} {}
 
     ExprVisitorType accept(Visitor &visitor) override final { return visitor.visit(*this); }
@@ -537,14 +540,14 @@ struct TupleExpr final : public Expr {
 
     Token brace{};
     std::vector<ElementType> elements{};
-    std::unique_ptr<TupleType> type{};
+    NodeHandle<TupleType> type{};
 
     std::string_view string_tag() override final { return "TupleExpr"; }
 
     NodeType type_tag() override final { return NodeType::TupleExpr; }
 
     TupleExpr() = default;
-    TupleExpr(Token brace, std::vector<ElementType> elements, std::unique_ptr<TupleType> type)
+    TupleExpr(Token brace, std::vector<ElementType> elements, NodeHandle<TupleType> type)
         : brace{std::move(brace)}, elements{std::move(elements)}, type{std::move(type)} {}
 
     ExprVisitorType accept(Visitor &visitor) override final { return visitor.visit(*this); }
@@ -611,8 +614,8 @@ struct BreakStmt final : public Stmt {
 enum class VisibilityType { PRIVATE, PROTECTED, PUBLIC };
 
 struct ClassStmt final : public Stmt {
-    using MemberType = std::pair<std::unique_ptr<VarStmt>, VisibilityType>;
-    using MethodType = std::pair<std::unique_ptr<FunctionStmt>, VisibilityType>;
+    using MemberType = std::pair<NodeHandle<VarStmt>, VisibilityType>;
+    using MethodType = std::pair<NodeHandle<FunctionStmt>, VisibilityType>;
 
     Token name{};
     FunctionStmt *ctor{};
@@ -658,6 +661,28 @@ struct ExpressionStmt final : public Stmt {
     StmtVisitorType accept(Visitor &visitor) override final { return visitor.visit(*this); }
 };
 
+struct ForEachStmt final : public Stmt {
+    Token keyword{};
+    Token name{};
+    ExprNode iterable{};
+    StmtNode body{};
+    TypeNode type{};
+
+    std::string_view string_tag() override final { return "ForEachStmt"; }
+
+    NodeType type_tag() override final { return NodeType::ForEachStmt; }
+
+    ForEachStmt() = default;
+    ForEachStmt(Token keyword, Token name, ExprNode iterable, StmtNode body, TypeNode type)
+        : keyword{std::move(keyword)},
+          name{std::move(name)},
+          iterable{std::move(iterable)},
+          body{std::move(body)},
+          type{std::move(type)} {}
+
+    StmtVisitorType accept(Visitor &visitor) override final { return visitor.visit(*this); }
+};
+
 struct FunctionStmt final : public Stmt {
     Token name{};
     TypeNode return_type{};
@@ -780,17 +805,19 @@ struct WhileStmt final : public Stmt {
     ExprNode condition{};
     StmtNode body{};
     StmtNode increment{};
+    std::size_t stack_slot{};
 
     std::string_view string_tag() override final { return "WhileStmt"; }
 
     NodeType type_tag() override final { return NodeType::WhileStmt; }
 
     WhileStmt() = default;
-    WhileStmt(Token keyword, ExprNode condition, StmtNode body, StmtNode increment)
+    WhileStmt(Token keyword, ExprNode condition, StmtNode body, StmtNode increment, std::size_t stack_slot)
         : keyword{std::move(keyword)},
           condition{std::move(condition)},
           body{std::move(body)},
-          increment{std::move(increment)} {}
+          increment{std::move(increment)},
+          stack_slot{stack_slot} {}
 
     StmtVisitorType accept(Visitor &visitor) override final { return visitor.visit(*this); }
 };
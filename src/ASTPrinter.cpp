@@ -2,6 +2,8 @@
 /* See LICENSE at project root for license details */
 #include "ASTPrinter.hpp"
 
+#include "ErrorLogger/ErrorLogger.hpp"
+
 #include <algorithm>
 #include <iostream>
 
@@ -61,7 +63,7 @@ std::ostream &print_access_specifier(VisibilityType visibility) {
     return std::cout;
 }
 
-std::string escape(const std::string &string_value) {
+std::string escape(std::string_view string_value) {
     std::string result{};
     auto is_escape = [](char ch) {
         switch (ch) {
@@ -103,6 +105,15 @@ std::ostream &print_token(const Token &token) {
                      << token.end;
 }
 
+// The type information of an expression only keeps the location of its token, so the lexeme is taken from the source
+std::ostream &print_token(const TokenLocation &token) {
+    std::string_view lexeme{};
+    if (token.end <= logger.source.size()) {
+        lexeme = logger.source.substr(token.start, token.end - token.start);
+    }
+    return print_token(Token{token.type, lexeme, token.line, token.start, token.end});
+}
+
 void ASTPrinter::print_stmt(StmtNode &stmt) {
     print(stmt.get());
 }
@@ -401,6 +412,25 @@ StmtVisitorType ASTPrinter::visit(ExpressionStmt &stmt) {
     current_depth--;
 }
 
+StmtVisitorType ASTPrinter::visit(ForEachStmt &stmt) {
+    print_tabs(current_depth);
+    print_token(stmt.keyword) << '\n';
+    current_depth++;
+    print_tabs(current_depth);
+    std::cout << "Variable:\n";
+    current_depth++;
+    print_tabs(current_depth);
+    print_token(stmt.name) << '\n';
+    current_depth--;
+    print_tabs(current_depth);
+    std::cout << "Iterable:\n";
+    print(stmt.iterable.get());
+    print_tabs(current_depth);
+    std::cout << "Body:\n";
+    print(stmt.body.get());
+    current_depth--;
+}
+
 StmtVisitorType ASTPrinter::visit(FunctionStmt &stmt) {
     print_tabs(current_depth);
     print_token(stmt.name) << '\n';
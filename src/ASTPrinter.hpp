@@ -47,6 +47,7 @@ class ASTPrinter final : Visitor {
     StmtVisitorType visit(ClassStmt &stmt) override final;
     StmtVisitorType visit(ContinueStmt &stmt) override final;
     StmtVisitorType visit(ExpressionStmt &stmt) override final;
+    StmtVisitorType visit(ForEachStmt &stmt) override final;
     StmtVisitorType visit(FunctionStmt &stmt) override final;
     StmtVisitorType visit(IfStmt &stmt) override final;
     StmtVisitorType visit(ReturnStmt &stmt) override final;
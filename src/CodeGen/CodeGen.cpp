@@ -4,31 +4,53 @@
 
 #include "../Common.hpp"
 #include "../ErrorLogger/ErrorLogger.hpp"
+#include "../IR/Lowering.hpp"
 #include "../VirtualMachine/Value.hpp"
 
+#include <utility>
+
 std::vector<RuntimeModule> Generator::compiled_modules{};
 
 Generator::Generator() {
     for (auto &native : native_functions) {
         natives[native.name] = native;
     }
+
+    ir_passes.add(std::make_unique<UnreachableBlocks>());
+    ir_passes.add(std::make_unique<MergeBlocks>());
+    ir_passes.add(std::make_unique<ConstantPropagation>());
+    ir_passes.add(std::make_unique<AlgebraicSimplification>());
+    ir_passes.add(std::make_unique<DeadValues>());
 }
 
 void Generator::begin_scope() {
-    scopes.push({});
+    scopes.emplace_back();
 }
 
 void Generator::end_scope() {
-    for (auto begin = scopes.top().crbegin(); begin != scopes.top().crend(); begin++) {
-        if ((*begin)->primitive == Type::STRING) {
-            current_chunk->emit_instruction(Instruction::POP_STRING, 0);
-        } else if (((*begin)->primitive == Type::LIST || (*begin)->primitive == Type::TUPLE) && not(*begin)->is_ref) {
-            current_chunk->emit_instruction(Instruction::POP_LIST, 0);
-        } else {
-            current_chunk->emit_instruction(Instruction::POP, 0);
+    for (auto begin = scopes.back().crbegin(); begin != scopes.back().crend(); begin++) {
+        emit_pop(*begin, 0);
+    }
+    scopes.pop_back();
+}
+
+void Generator::emit_pop(const BaseType *type, std::size_t line_number) {
+    if (type->primitive == Type::STRING) {
+        current_chunk->emit_instruction(Instruction::POP_STRING, line_number);
+    } else if ((type->primitive == Type::LIST || type->primitive == Type::TUPLE) && not type->is_ref) {
+        current_chunk->emit_instruction(Instruction::POP_LIST, line_number);
+    } else {
+        current_chunk->emit_instruction(Instruction::POP, line_number);
+    }
+}
+
+void Generator::emit_pops_until(std::size_t scope_count, std::size_t line_number) {
+    // Pops the locals of the innermost scopes without closing them, used when jumping out of them
+    for (std::size_t i = scopes.size(); i > scope_count; i--) {
+        for (auto begin = scopes[i - 1].crbegin(); begin != scopes[i - 1].crend(); begin++) {
+            emit_pop(*begin, line_number);
         }
     }
-    scopes.pop();
 }
 
 void Generator::patch_jump(std::size_t jump_idx, std::size_t jump_amount) {
@@ -54,9 +76,42 @@ RuntimeModule Generator::compile(Module &module) {
     }
 
     end_scope();
+    peephole.optimize(compiled.top_level_code);
     return compiled;
 }
 
+const PeepholeOptimizer &Generator::get_peephole_optimizer() const noexcept {
+    return peephole;
+}
+
+const Inliner &Generator::get_inliner() const noexcept {
+    return inliner;
+}
+
+const LoopInvariants &Generator::get_loop_invariants() const noexcept {
+    return loop_invariants;
+}
+
+const BoundsChecks &Generator::get_bounds_checks() const noexcept {
+    return bounds_checks;
+}
+
+const EscapeAnalysis &Generator::get_escape_analysis() const noexcept {
+    return escape_analysis;
+}
+
+const std::vector<std::unique_ptr<IRFunction>> &Generator::get_ir_functions() const noexcept {
+    return ir_functions;
+}
+
+void Generator::set_inline_calls(bool inline_calls) noexcept {
+    this->inline_calls = inline_calls;
+}
+
+void Generator::set_use_ir(bool use_ir) noexcept {
+    this->use_ir = use_ir;
+}
+
 void Generator::emit_conversion(NumericConversionType conversion_type, std::size_t line_number) {
     switch (conversion_type) {
         case NumericConversionType::FLOAT_TO_INT:
@@ -73,12 +128,124 @@ void Generator::emit_three_bytes_of(std::size_t value) {
     current_chunk->bytes.back() |= value & 0x00ff'ffff;
 }
 
+void Generator::emit_stack_slot(IdentifierType type, std::size_t stack_slot) {
+    // The type resolver does not know about the values hoisted out of loops, so the locals declared after them have to
+    // be moved up past them
+    std::size_t shift = 0;
+    if (type == IdentifierType::LOCAL) {
+        for (auto [first_local, count] : hoisted_slots) {
+            if (stack_slot >= first_local) {
+                shift += count;
+            }
+        }
+    }
+    emit_three_bytes_of(stack_slot + shift);
+}
+
+std::size_t Generator::hoisted_count() const noexcept {
+    std::size_t count = 0;
+    for (auto [first_local, hoisted] : hoisted_slots) {
+        count += hoisted;
+    }
+    return count;
+}
+
 ExprVisitorType Generator::compile(Expr *expr) {
+    if (auto hoisted = hoisted_values.find(expr); hoisted != hoisted_values.end()) {
+        current_chunk->emit_instruction(Instruction::ACCESS_LOCAL, expr->resolved.token.line);
+        emit_three_bytes_of(hoisted->second);
+        return {};
+    }
     return expr->accept(*this);
 }
 
+ExprVisitorType Generator::compile_lazy_range(Expr *expr) {
+    Expr *inner = expr;
+    while (inner->type_tag() == NodeType::GroupingExpr) {
+        inner = dynamic_cast<GroupingExpr *>(inner)->expr.get();
+    }
+    if (inner->type_tag() == NodeType::BinaryExpr) {
+        if (auto *range = dynamic_cast<BinaryExpr *>(inner); range->resolved.token.type == TokenType::DOT_DOT ||
+                                                             range->resolved.token.type == TokenType::DOT_DOT_EQUAL) {
+            lazy_range = range;
+        }
+    }
+    return compile(expr);
+}
+
 StmtVisitorType Generator::compile(Stmt *stmt) {
+    exits_block = false;
     stmt->accept(*this);
+    switch (stmt->type_tag()) {
+        case NodeType::BlockStmt:
+        case NodeType::BreakStmt:
+        case NodeType::ContinueStmt:
+        case NodeType::IfStmt:
+        case NodeType::ReturnStmt: break;
+        // Loops and switches can always be left by a break or by their condition failing
+        default: exits_block = false;
+    }
+}
+
+std::optional<bool> Generator::constant_condition(Expr *condition) noexcept {
+    while (condition->type_tag() == NodeType::GroupingExpr) {
+        condition = dynamic_cast<GroupingExpr *>(condition)->expr.get();
+    }
+    if (auto *literal = dynamic_cast<LiteralExpr *>(condition); literal != nullptr && literal->value.is_bool()) {
+        return literal->value.to_bool();
+    }
+    return std::nullopt;
+}
+
+bool Generator::is_pure(Expr *expr) noexcept {
+    // Whether evaluating the expression has no effect other than producing its value. Operations that can raise a
+    // runtime error (division, shifts, indexing) are not considered pure, since dropping them would hide the error
+    switch (expr->type_tag()) {
+        case NodeType::LiteralExpr:
+        case NodeType::VariableExpr: return true;
+        case NodeType::GroupingExpr: return is_pure(dynamic_cast<GroupingExpr *>(expr)->expr.get());
+        case NodeType::UnaryExpr: {
+            auto *unary = dynamic_cast<UnaryExpr *>(expr);
+            return unary->oper.type != TokenType::PLUS_PLUS && unary->oper.type != TokenType::MINUS_MINUS &&
+                   is_pure(unary->right.get());
+        }
+        case NodeType::BinaryExpr: {
+            auto *binary = dynamic_cast<BinaryExpr *>(expr);
+            switch (binary->resolved.token.type) {
+                case TokenType::SLASH:
+                case TokenType::MODULO:
+                case TokenType::LEFT_SHIFT:
+                case TokenType::RIGHT_SHIFT:
+                case TokenType::DOT_DOT:
+                case TokenType::DOT_DOT_EQUAL: return false;
+                default: return is_pure(binary->left.get()) && is_pure(binary->right.get());
+            }
+        }
+        case NodeType::LogicalExpr: {
+            auto *logical = dynamic_cast<LogicalExpr *>(expr);
+            return is_pure(logical->left.get()) && is_pure(logical->right.get());
+        }
+        case NodeType::TernaryExpr: {
+            auto *ternary = dynamic_cast<TernaryExpr *>(expr);
+            return is_pure(ternary->left.get()) && is_pure(ternary->middle.get()) && is_pure(ternary->right.get());
+        }
+        default: return false;
+    }
+}
+
+bool Generator::can_inline(CallExpr &expr, const Inliner::Candidate &candidate) noexcept {
+    // Arguments are evaluated wherever their parameter is used in the inlined body instead of once before the call,
+    // so they must not have side effects, and they are only duplicated when that is as cheap as the original access
+    for (std::size_t i = 0; i < expr.args.size(); i++) {
+        Expr *value = std::get<ExprNode>(expr.args[i]).get();
+        bool is_trivial =
+            value->type_tag() == NodeType::LiteralExpr || value->type_tag() == NodeType::VariableExpr;
+        if (std::get<RequiresCopy>(expr.args[i]) || not is_pure(value) ||
+            (candidate.param_uses[i] > 1 && not is_trivial)) {
+            return false;
+        }
+    }
+    return true;
 }
 
 BaseTypeVisitorType Generator::compile(BaseType *type) {
@@ -123,7 +290,7 @@ ExprVisitorType Generator::visit(AssignExpr &expr) {
             current_chunk->emit_instruction(
                 expr.target_type == IdentifierType::LOCAL ? Instruction::ACCESS_LOCAL : Instruction::ACCESS_GLOBAL,
                 expr.resolved.token.line);
-            emit_three_bytes_of(expr.resolved.stack_slot);
+            emit_stack_slot(expr.target_type, expr.resolved.stack_slot);
             if (expr.resolved.info->is_ref) {
                 current_chunk->emit_instruction(Instruction::DEREF, expr.resolved.token.line);
             }
@@ -156,7 +323,7 @@ ExprVisitorType Generator::visit(AssignExpr &expr) {
         }
     }
 
-    emit_three_bytes_of(expr.resolved.stack_slot);
+    emit_stack_slot(expr.target_type, expr.resolved.stack_slot);
     return {};
 }
 
@@ -185,6 +352,34 @@ ExprVisitorType Generator::visit(BinaryExpr &expr) {
         }
     };
 
+    // Picks the instruction for a comparison from the types of its operands, so that comparisons of ints, floats and
+    // strings do not have to check the tags of the values at runtime
+    auto comparison = [&expr, requires_floating](Instruction integral, Instruction floating, Instruction generic) {
+        Type left = expr.left->resolved.info->primitive;
+        Type right = expr.right->resolved.info->primitive;
+        if (requires_floating) {
+            return floating;
+        } else if (left == Type::INT && right == Type::INT) {
+            return integral;
+        } else if (generic == Instruction::EQUAL && left == Type::STRING && right == Type::STRING) {
+            return Instruction::SEQ;
+        } else if (generic == Instruction::EQUAL && (left == Type::LIST || left == Type::TUPLE)) {
+            return Instruction::EQUAL_SL;
+        }
+        return generic;
+    };
+
+    // Integral division by a constant that is not zero can never fail, so the check for zero can be skipped
+    auto division = [&expr, requires_floating](Instruction floating, Instruction checked, Instruction unchecked) {
+        if (requires_floating) {
+            return floating;
+        } else if (expr.right->type_tag() == NodeType::LiteralExpr) {
+            LiteralValue &divisor = dynamic_cast<LiteralExpr *>(expr.right.get())->value;
+            return divisor.is_int() && divisor.to_int() != 0 ? unchecked : checked;
+        }
+        return checked;
+    };
+
     if (expr.resolved.token.type != TokenType::DOT_DOT && expr.resolved.token.type != TokenType::DOT_DOT_EQUAL) {
         compile_left();
         compile_right();
@@ -193,6 +388,11 @@ ExprVisitorType Generator::visit(BinaryExpr &expr) {
     switch (expr.resolved.token.type) {
         case TokenType::LEFT_SHIFT:
             if (expr.left->resolved.info->primitive == Type::LIST) {
+                // A list appended by name has to be copied, the list would otherwise hold a reference to it which
+                // dangles once the name goes out of scope
+                if (expr.right->resolved.info->primitive == Type::LIST) {
+                    current_chunk->emit_instruction(Instruction::COPY_LIST, expr.resolved.token.line);
+                }
                 current_chunk->emit_instruction(Instruction::APPEND_LIST, expr.resolved.token.line);
             } else {
                 current_chunk->emit_instruction(Instruction::SHIFT_LEFT, expr.resolved.token.line);
@@ -210,37 +410,35 @@ ExprVisitorType Generator::visit(BinaryExpr &expr) {
         case TokenType::BIT_XOR: current_chunk->emit_instruction(Instruction::BIT_XOR, expr.resolved.token.line); break;
         case TokenType::MODULO:
             current_chunk->emit_instruction(
-                requires_floating ? Instruction::FMOD : Instruction::IMOD, expr.resolved.token.line);
+                division(Instruction::FMOD, Instruction::IMOD, Instruction::IMOD_NONZERO), expr.resolved.token.line);
             break;
 
         case TokenType::EQUAL_EQUAL:
-            if (expr.left->resolved.info->primitive == Type::LIST ||
-                expr.left->resolved.info->primitive == Type::TUPLE ||
-                expr.left->resolved.info->primitive == Type::STRING) {
-                current_chunk->emit_instruction(Instruction::EQUAL_SL, expr.resolved.token.line);
-            } else {
-                current_chunk->emit_instruction(Instruction::EQUAL, expr.resolved.token.line);
-            }
+            current_chunk->emit_instruction(
+                comparison(Instruction::IEQ, Instruction::FEQ, Instruction::EQUAL), expr.resolved.token.line);
+            break;
+        case TokenType::GREATER:
+            current_chunk->emit_instruction(
+                comparison(Instruction::IGT, Instruction::FGT, Instruction::GREATER), expr.resolved.token.line);
+            break;
+        case TokenType::LESS:
+            current_chunk->emit_instruction(
+                comparison(Instruction::ILT, Instruction::FLT, Instruction::LESSER), expr.resolved.token.line);
             break;
-        case TokenType::GREATER: current_chunk->emit_instruction(Instruction::GREATER, expr.resolved.token.line); break;
-        case TokenType::LESS: current_chunk->emit_instruction(Instruction::LESSER, expr.resolved.token.line); break;
 
         case TokenType::NOT_EQUAL:
-            if (expr.left->resolved.info->primitive == Type::LIST ||
-                expr.left->resolved.info->primitive == Type::TUPLE ||
-                expr.left->resolved.info->primitive == Type::STRING) {
-                current_chunk->emit_instruction(Instruction::EQUAL_SL, expr.resolved.token.line);
-            } else {
-                current_chunk->emit_instruction(Instruction::EQUAL, expr.resolved.token.line);
-            }
+            current_chunk->emit_instruction(
+                comparison(Instruction::IEQ, Instruction::FEQ, Instruction::EQUAL), expr.resolved.token.line);
             current_chunk->emit_instruction(Instruction::NOT, expr.resolved.token.line);
             break;
         case TokenType::GREATER_EQUAL:
-            current_chunk->emit_instruction(Instruction::LESSER, expr.resolved.token.line);
+            current_chunk->emit_instruction(
+                comparison(Instruction::ILT, Instruction::FLT, Instruction::LESSER), expr.resolved.token.line);
             current_chunk->emit_instruction(Instruction::NOT, expr.resolved.token.line);
             break;
         case TokenType::LESS_EQUAL:
-            current_chunk->emit_instruction(Instruction::GREATER, expr.resolved.token.line);
+            current_chunk->emit_instruction(
+                comparison(Instruction::IGT, Instruction::FGT, Instruction::GREATER), expr.resolved.token.line);
             current_chunk->emit_instruction(Instruction::NOT, expr.resolved.token.line);
             break;
 
@@ -261,7 +459,7 @@ ExprVisitorType Generator::visit(BinaryExpr &expr) {
             break;
         case TokenType::SLASH:
             current_chunk->emit_instruction(
-                requires_floating ? Instruction::FDIV : Instruction::IDIV, expr.resolved.token.line);
+                division(Instruction::FDIV, Instruction::IDIV, Instruction::IDIV_NONZERO), expr.resolved.token.line);
             break;
         case TokenType::STAR:
             current_chunk->emit_instruction(
@@ -270,67 +468,15 @@ ExprVisitorType Generator::visit(BinaryExpr &expr) {
 
         case TokenType::DOT_DOT:
         case TokenType::DOT_DOT_EQUAL: {
-            current_chunk->emit_constant(Value{0}, expr.resolved.token.line);
-            current_chunk->emit_instruction(Instruction::MAKE_LIST, expr.resolved.token.line);
+            bool is_lazy = lazy_range == &expr;
+            lazy_range = nullptr;
             compile_left();
             compile_right();
-            /* This is effectively an unrolled while loop of the kind:
-             *
-             * {
-             *      var list = []
-             *      var x = left_expr
-             *      var y = right_expr
-             *      while (x < y) or while (x <= y) {
-             *          list.append(x)
-             *          x = x + 1
-             *      }
-             *      list
-             * }
-             */
-            std::size_t jump_to_cond =
-                current_chunk->emit_instruction(Instruction::JUMP_FORWARD, expr.resolved.token.line);
-            emit_three_bytes_of(0);
-
-            // list.append(x)
-            std::size_t jump_back =
-                current_chunk->emit_instruction(Instruction::ACCESS_FROM_TOP, expr.resolved.token.line);
-            emit_three_bytes_of(3);
-            current_chunk->emit_instruction(Instruction::ACCESS_FROM_TOP, expr.resolved.token.line);
-            emit_three_bytes_of(3);
-            current_chunk->emit_instruction(Instruction::APPEND_LIST, expr.resolved.token.line);
-            current_chunk->emit_instruction(Instruction::POP, expr.resolved.token.line);
-
-            // x = x + 1
-            current_chunk->emit_instruction(Instruction::ACCESS_FROM_TOP, expr.resolved.token.line);
-            emit_three_bytes_of(2);
-            current_chunk->emit_constant(Value{1}, expr.resolved.token.line);
-            current_chunk->emit_instruction(Instruction::IADD, expr.resolved.token.line);
-            current_chunk->emit_instruction(Instruction::ASSIGN_FROM_TOP, expr.resolved.token.line);
-            emit_three_bytes_of(3);
-            current_chunk->emit_instruction(Instruction::POP, expr.resolved.token.line);
-
-            // Emit x < y or !(x > y) depending on .. or ..=
-            std::size_t loop_cond =
-                current_chunk->emit_instruction(Instruction::ACCESS_FROM_TOP, expr.resolved.token.line);
-            emit_three_bytes_of(2);
-            current_chunk->emit_instruction(Instruction::ACCESS_FROM_TOP, expr.resolved.token.line);
-            emit_three_bytes_of(2);
-            if (expr.resolved.token.type == TokenType::DOT_DOT) {
-                current_chunk->emit_instruction(Instruction::LESSER, expr.resolved.token.line);
-            } else {
-                current_chunk->emit_instruction(Instruction::GREATER, expr.resolved.token.line);
-                current_chunk->emit_instruction(Instruction::NOT, expr.resolved.token.line);
+            current_chunk->emit_instruction(Instruction::MAKE_RANGE, expr.resolved.token.line);
+            emit_three_bytes_of(expr.resolved.token.type == TokenType::DOT_DOT_EQUAL);
+            if (not is_lazy) {
+                current_chunk->emit_instruction(Instruction::RANGE_TO_LIST, expr.resolved.token.line);
             }
-
-            // Jump back to the start of the loop
-            std::size_t loop_end =
-                current_chunk->emit_instruction(Instruction::POP_JUMP_BACK_IF_TRUE, expr.resolved.token.line);
-            emit_three_bytes_of(0);
-            current_chunk->emit_instruction(Instruction::POP, expr.resolved.token.line);
-            current_chunk->emit_instruction(Instruction::POP, expr.resolved.token.line);
-
-            patch_jump(jump_to_cond, loop_cond - jump_to_cond - 1);
-            patch_jump(loop_end, loop_end - jump_back + 1);
             break;
         }
 
@@ -341,6 +487,20 @@ ExprVisitorType Generator::visit(BinaryExpr &expr) {
 }
 
 ExprVisitorType Generator::visit(CallExpr &expr) {
+    if (inline_calls && not expr.is_native_call &&
+        (expr.function->type_tag() == NodeType::VariableExpr ||
+            expr.function->type_tag() == NodeType::ScopeAccessExpr)) {
+        FunctionStmt *called = expr.function->resolved.func;
+        if (const Inliner::Candidate *candidate = inliner.candidate_for(called);
+            candidate != nullptr && can_inline(expr, *candidate)) {
+            inliner.record(called->name.lexeme, current_module->name, expr.resolved.token.line);
+            inlined_call = &expr;
+            compile(candidate->body);
+            inlined_call = nullptr;
+            return {};
+        }
+    }
+
     // Emit a null value on the stack just before the parameters of the function which is being called. This will serve
     // as the stack slot in which to save the return value of the function before destroying any arguments or locals.
     current_chunk->emit_instruction(Instruction::PUSH_NULL, expr.resolved.token.line);
@@ -356,7 +516,7 @@ ExprVisitorType Generator::visit(CallExpr &expr) {
                     } else {
                         current_chunk->emit_instruction(Instruction::MAKE_REF_TO_GLOBAL, value->resolved.token.line);
                     }
-                    emit_three_bytes_of(value->resolved.stack_slot);
+                    emit_stack_slot(dynamic_cast<VariableExpr *>(value.get())->type, value->resolved.stack_slot);
                 } else if (value->type_tag() == NodeType::IndexExpr) {
                     IndexExpr *list = dynamic_cast<IndexExpr *>(value.get());
                     compile(list->object.get());
@@ -365,7 +525,7 @@ ExprVisitorType Generator::visit(CallExpr &expr) {
                 } else {
                     current_chunk->emit_instruction(Instruction::MAKE_REF_TO_LOCAL, value->resolved.token.line);
                     // This is a fallback, but I don't think it would ever be triggered
-                    emit_three_bytes_of(value->resolved.stack_slot);
+                    emit_stack_slot(IdentifierType::LOCAL, value->resolved.stack_slot);
                 }
             } else if (not param.second->is_ref && value->resolved.info->is_ref) {
                 compile(value.get());
@@ -374,7 +534,7 @@ ExprVisitorType Generator::visit(CallExpr &expr) {
                 compile(value.get());
             }
         } else {
-            compile(value.get());
+            compile_lazy_range(value.get());
         }
 
         if (std::get<NumericConversionType>(arg) != NumericConversionType::NONE) {
@@ -399,7 +559,7 @@ ExprVisitorType Generator::visit(CallExpr &expr) {
     }
     if (expr.is_native_call) {
         auto *called = dynamic_cast<VariableExpr *>(expr.function.get());
-        current_chunk->emit_string(called->name.lexeme, called->name.line);
+        current_chunk->emit_string(std::string{called->name.lexeme}, called->name.line);
         current_chunk->emit_instruction(Instruction::CALL_NATIVE, expr.resolved.token.line);
         auto begin = expr.args.crbegin();
         for (; begin != expr.args.crend(); begin++) {
@@ -442,8 +602,8 @@ ExprVisitorType Generator::visit(CommaExpr &expr) {
 ExprVisitorType Generator::visit(GetExpr &expr) {
     if (expr.object->resolved.info->primitive == Type::TUPLE && expr.name.type == TokenType::INT_VALUE) {
         compile(expr.object.get());
-        current_chunk->emit_constant(Value{std::stoi(expr.name.lexeme)}, expr.name.line);
-        current_chunk->emit_instruction(Instruction::INDEX_LIST, expr.resolved.token.line);
+        current_chunk->emit_instruction(Instruction::INDEX_TUPLE, expr.resolved.token.line);
+        emit_three_bytes_of(std::stoi(std::string{expr.name.lexeme}));
     }
     return {};
 }
@@ -457,16 +617,21 @@ ExprVisitorType Generator::visit(GroupingExpr &expr) {
 }
 
 ExprVisitorType Generator::visit(IndexExpr &expr) {
-    compile(expr.object.get());
+    compile_lazy_range(expr.object.get());
     compile(expr.index.get());
     if (expr.index->resolved.info->is_ref) {
         current_chunk->emit_instruction(Instruction::DEREF, expr.index->resolved.token.line);
     }
+    bool in_bounds = bounds_checks.is_in_bounds(expr.object.get(), expr.index.get());
     if (expr.object->resolved.info->primitive == Type::LIST) {
-        current_chunk->emit_instruction(Instruction::CHECK_LIST_INDEX, expr.resolved.token.line);
+        if (not in_bounds) {
+            current_chunk->emit_instruction(Instruction::CHECK_LIST_INDEX, expr.resolved.token.line);
+        }
         current_chunk->emit_instruction(Instruction::INDEX_LIST, expr.resolved.token.line);
     } else if (expr.object->resolved.info->primitive == Type::STRING) {
-        current_chunk->emit_instruction(Instruction::CHECK_STRING_INDEX, expr.resolved.token.line);
+        if (not in_bounds) {
+            current_chunk->emit_instruction(Instruction::CHECK_STRING_INDEX, expr.resolved.token.line);
+        }
         current_chunk->emit_instruction(Instruction::INDEX_STRING, expr.resolved.token.line);
     }
     return {};
@@ -476,9 +641,8 @@ ExprVisitorType Generator::visit(ListExpr &expr) {
     current_chunk->emit_constant(
         Value{dynamic_cast<LiteralExpr *>(expr.type->size.get())->value.to_int()}, expr.bracket.line);
     current_chunk->emit_instruction(Instruction::MAKE_LIST, expr.bracket.line);
-    std::size_t stack_slot = 0;
-    if (not scopes.empty()) {
-        stack_slot = scopes.top().size();
+    if (std::exchange(frame_list, nullptr) == &expr) {
+        emit_three_bytes_of(1);
     }
     std::size_t i = 0;
     for (ListExpr::ElementType &element : expr.elements) {
@@ -507,7 +671,7 @@ ExprVisitorType Generator::visit(ListExpr &expr) {
                 } else if (bound_var->type == IdentifierType::GLOBAL) {
                     current_chunk->emit_instruction(Instruction::MAKE_REF_TO_GLOBAL, bound_var->name.line);
                 }
-                emit_three_bytes_of(bound_var->resolved.stack_slot);
+                emit_stack_slot(bound_var->type, bound_var->resolved.stack_slot);
             }
         } else {
             compile(element_expr.get()); // A reference not binding to an lvalue
@@ -531,7 +695,9 @@ ExprVisitorType Generator::visit(ListAssignExpr &expr) {
     if (expr.list.index->resolved.info->is_ref) {
         current_chunk->emit_instruction(Instruction::DEREF, expr.list.index->resolved.token.line);
     }
-    current_chunk->emit_instruction(Instruction::CHECK_LIST_INDEX, expr.resolved.token.line);
+    if (not bounds_checks.is_in_bounds(expr.list.object.get(), expr.list.index.get())) {
+        current_chunk->emit_instruction(Instruction::CHECK_LIST_INDEX, expr.resolved.token.line);
+    }
 
     switch (expr.resolved.token.type) {
         case TokenType::EQUAL: {
@@ -648,9 +814,9 @@ ExprVisitorType Generator::visit(ScopeNameExpr &expr) {
 ExprVisitorType Generator::visit(SetExpr &expr) {
     if (expr.object->resolved.info->primitive == Type::TUPLE && expr.name.type == TokenType::INT_VALUE) {
         compile(expr.object.get());
-        current_chunk->emit_constant(Value{std::stoi(expr.name.lexeme)}, expr.name.line);
         compile(expr.value.get());
-        current_chunk->emit_instruction(Instruction::ASSIGN_LIST, expr.name.line);
+        current_chunk->emit_instruction(Instruction::ASSIGN_TUPLE, expr.name.line);
+        emit_three_bytes_of(std::stoi(std::string{expr.name.lexeme}));
     }
     return {};
 }
@@ -702,15 +868,15 @@ ExprVisitorType Generator::visit(ThisExpr &expr) {
 }
 
 ExprVisitorType Generator::visit(TupleExpr &expr) {
-    current_chunk->emit_constant(Value{static_cast<Value::IntType>(expr.elements.size())}, expr.resolved.token.line);
-    current_chunk->emit_instruction(Instruction::MAKE_LIST, expr.resolved.token.line);
-    std::size_t i = 0;
+    /*
+     * As the number of elements in a tuple is known at compile time, the elements are compiled one after the other
+     * onto the stack and then collected into the tuple with a single instruction, so `{1, "a"}` compiles to
+     *
+     * CONSTANT              -> 0 | value = 1
+     * CONSTANT_STRING       -> 1 | value = "a"
+     * MAKE_TUPLE            | 2 element(s)
+     */
     for (auto &element : expr.elements) {
-        current_chunk->emit_instruction(Instruction::ACCESS_FROM_TOP, expr.resolved.token.line);
-        emit_three_bytes_of(1);
-        current_chunk->emit_constant(
-            Value{static_cast<Value::IntType>(i)}, std::get<ExprNode>(element)->resolved.token.line);
-
         compile(std::get<ExprNode>(element).get());
 
         if (std::get<RequiresCopy>(element)) {
@@ -719,10 +885,9 @@ ExprVisitorType Generator::visit(TupleExpr &expr) {
         if (std::get<NumericConversionType>(element) != NumericConversionType::NONE) {
             emit_conversion(std::get<NumericConversionType>(element), std::get<ExprNode>(element)->resolved.token.line);
         }
-        current_chunk->emit_instruction(Instruction::ASSIGN_LIST, expr.resolved.token.line);
-        current_chunk->emit_instruction(Instruction::POP, expr.resolved.token.line);
-        i++;
     }
+    current_chunk->emit_instruction(Instruction::MAKE_TUPLE, expr.resolved.token.line);
+    emit_three_bytes_of(expr.elements.size());
     return {};
 }
 
@@ -745,7 +910,7 @@ ExprVisitorType Generator::visit(UnaryExpr &expr) {
                 current_chunk->emit_instruction(
                     variable->type == IdentifierType::LOCAL ? Instruction::ACCESS_LOCAL : Instruction::ACCESS_GLOBAL,
                     variable->resolved.token.line);
-                emit_three_bytes_of(variable->resolved.stack_slot);
+                emit_stack_slot(variable->type, variable->resolved.stack_slot);
 
                 if (variable->resolved.info->primitive == Type::FLOAT) {
                     current_chunk->emit_constant(Value{1.0}, expr.oper.line);
@@ -759,7 +924,7 @@ ExprVisitorType Generator::visit(UnaryExpr &expr) {
                 current_chunk->emit_instruction(
                     variable->type == IdentifierType::LOCAL ? Instruction::ASSIGN_LOCAL : Instruction::ASSIGN_GLOBAL,
                     expr.oper.line);
-                emit_three_bytes_of(variable->resolved.stack_slot);
+                emit_stack_slot(variable->type, variable->resolved.stack_slot);
             }
             break;
         }
@@ -769,6 +934,21 @@ ExprVisitorType Generator::visit(UnaryExpr &expr) {
 }
 
 ExprVisitorType Generator::visit(VariableExpr &expr) {
+    if (inlined_call != nullptr) {
+        // Only parameters can be used in the body of an inlined function, and their stack slot is their position
+        CallExpr *call = std::exchange(inlined_call, nullptr);
+        auto &[value, conversion, requires_copy] = call->args[expr.resolved.stack_slot];
+        compile(value.get());
+        if (value->resolved.info->is_ref) {
+            current_chunk->emit_instruction(Instruction::DEREF, value->resolved.token.line);
+        }
+        if (conversion != NumericConversionType::NONE) {
+            emit_conversion(conversion, value->resolved.token.line);
+        }
+        inlined_call = call;
+        return {};
+    }
+
     switch (expr.type) {
         case IdentifierType::LOCAL:
         case IdentifierType::GLOBAL:
@@ -786,13 +966,13 @@ ExprVisitorType Generator::visit(VariableExpr &expr) {
                         current_chunk->emit_instruction(Instruction::ACCESS_GLOBAL, expr.name.line);
                     }
                 }
-                emit_three_bytes_of(expr.resolved.stack_slot);
+                emit_stack_slot(expr.type, expr.resolved.stack_slot);
             } else {
                 compile_error({"Too many variables in current scope"});
             }
             return {};
         case IdentifierType::FUNCTION:
-            current_chunk->emit_string(expr.name.lexeme, expr.name.line);
+            current_chunk->emit_string(std::string{expr.name.lexeme}, expr.name.line);
             current_chunk->emit_instruction(Instruction::LOAD_FUNCTION, expr.name.line);
             return {};
         case IdentifierType::CLASS: break;
@@ -802,28 +982,52 @@ ExprVisitorType Generator::visit(VariableExpr &expr) {
 
 StmtVisitorType Generator::visit(BlockStmt &stmt) {
     begin_scope();
+    bool exits = false;
+    Stmt *previous = nullptr;
     for (auto &statement : stmt.stmts) {
+        if (statement->type_tag() == NodeType::WhileStmt) {
+            loop_counter = dynamic_cast<VarStmt *>(previous);
+        }
         compile(statement.get());
+        if (exits_block) {
+            // Nothing after this statement can be reached, not even the pops at the end of the scope
+            exits = true;
+            break;
+        }
+        previous = statement.get();
     }
-    end_scope();
+
+    if (exits) {
+        scopes.pop_back();
+    } else {
+        end_scope();
+    }
+    exits_block = exits;
 }
 
 StmtVisitorType Generator::visit(BreakStmt &stmt) {
+    emit_pops_until(break_scopes.top(), stmt.keyword.line);
     std::size_t break_idx = current_chunk->emit_instruction(Instruction::JUMP_FORWARD, stmt.keyword.line);
     emit_three_bytes_of(0);
     break_stmts.top().push_back(break_idx);
+    exits_block = true;
 }
 
 StmtVisitorType Generator::visit(ClassStmt &stmt) {}
 
 StmtVisitorType Generator::visit(ContinueStmt &stmt) {
+    emit_pops_until(continue_scopes.top(), stmt.keyword.line);
     std::size_t continue_idx = current_chunk->emit_instruction(Instruction::JUMP_FORWARD, stmt.keyword.line);
     emit_three_bytes_of(0);
     continue_stmts.top().push_back(continue_idx);
+    exits_block = true;
 }
 
 StmtVisitorType Generator::visit(ExpressionStmt &stmt) {
-    compile(stmt.expr.get());
+    if (is_pure(stmt.expr.get())) {
+        return;
+    }
+    compile_lazy_range(stmt.expr.get());
     if (stmt.expr->resolved.info->primitive == Type::STRING) {
         current_chunk->emit_instruction(Instruction::POP_STRING, current_chunk->line_numbers.back().first);
     } else if (stmt.expr->resolved.info->primitive == Type::LIST ||
@@ -834,43 +1038,153 @@ StmtVisitorType Generator::visit(ExpressionStmt &stmt) {
     }
 }
 
+StmtVisitorType Generator::visit(ForEachStmt &stmt) {
+    /*
+     * Taking an example of
+     * for x in list {
+     *      x
+     * }
+     *
+     * This will compile to
+     *
+     * ACCESS_LOCAL_LIST     | access local 0                        ) - The iterated value
+     * CONSTANT              -> 0 | value = 0                        ) - The index of the next element
+     * PUSH_NULL                                                     ) - The loop variable
+     * JUMP_FORWARD          | offset = +12 bytes, jump to = 24 -+
+     * ACCESS_LOCAL          | access local 3 <------------------+-+ ] - The body of the loop
+     * POP                                                       | | ]
+     * FOR_ITER              | offset = -8 bytes, jump to = 16 <-+-+
+     * POP
+     * POP
+     * POP_LIST
+     *
+     * FOR_ITER works on the three values on top of the stack: when the index is within the bounds of the iterated
+     * value, it stores the element at that index in the loop variable, increments the index and jumps back to the
+     * start of the body. As the bounds check doubles as the loop condition, no CHECK_LIST_INDEX, INDEX_LIST or call
+     * to size() is required per element.
+     */
+    compile_lazy_range(stmt.iterable.get());
+    current_chunk->emit_constant(Value{0}, stmt.keyword.line);
+    if (stmt.type->primitive == Type::STRING) {
+        // Keep a valid string in the loop variable, so that it can be unconditionally popped with POP_STRING
+        current_chunk->emit_string("", stmt.keyword.line);
+    } else {
+        current_chunk->emit_instruction(Instruction::PUSH_NULL, stmt.keyword.line);
+    }
+
+    break_stmts.emplace();
+    continue_stmts.emplace();
+    break_scopes.push(scopes.size());
+    continue_scopes.push(scopes.size());
+
+    std::size_t jump_begin_idx = current_chunk->emit_instruction(Instruction::JUMP_FORWARD, stmt.keyword.line);
+    emit_three_bytes_of(0);
+
+    std::size_t loop_back_idx = current_chunk->bytes.size();
+    compile(stmt.body.get());
+
+    std::size_t iterate_idx = current_chunk->emit_instruction(Instruction::FOR_ITER, stmt.keyword.line);
+    emit_three_bytes_of(0);
+
+    std::size_t loop_end_idx = current_chunk->bytes.size();
+
+    patch_jump(iterate_idx, iterate_idx - loop_back_idx + 1);
+    patch_jump(jump_begin_idx, iterate_idx - jump_begin_idx - 1);
+
+    for (std::size_t continue_idx : continue_stmts.top()) {
+        patch_jump(continue_idx, iterate_idx - continue_idx - 1);
+    }
+
+    for (std::size_t break_idx : break_stmts.top()) {
+        patch_jump(break_idx, loop_end_idx - break_idx - 1);
+    }
+
+    continue_stmts.pop();
+    break_stmts.pop();
+    continue_scopes.pop();
+    break_scopes.pop();
+
+    emit_pop(stmt.type.get(), stmt.keyword.line);
+    current_chunk->emit_instruction(Instruction::POP, stmt.keyword.line);
+    if (stmt.iterable->resolved.info->primitive == Type::LIST) {
+        current_chunk->emit_instruction(Instruction::POP_LIST, stmt.keyword.line);
+    } else if (stmt.iterable->resolved.info->is_ref) {
+        current_chunk->emit_instruction(Instruction::POP, stmt.keyword.line);
+    } else {
+        current_chunk->emit_instruction(Instruction::POP_STRING, stmt.keyword.line);
+    }
+}
+
 StmtVisitorType Generator::visit(FunctionStmt &stmt) {
+    if (use_ir && IRLowering::can_lower(stmt)) {
+        IRLowering lowering{inline_calls ? &inliner : nullptr, current_module->name};
+        if (std::unique_ptr<IRFunction> lowered = lowering.lower(stmt); lowered != nullptr) {
+            ir_passes.run(*lowered);
+
+            RuntimeFunction function{};
+            function.arity = stmt.params.size();
+            function.name = stmt.name.lexeme;
+            ir_backend.compile(*lowered, function.code);
+            peephole.optimize(function.code);
+            current_compiled->functions[std::string{stmt.name.lexeme}] = std::move(function);
+            ir_functions.push_back(std::move(lowered));
+            return;
+        }
+    }
+
+    std::unordered_set<const VarStmt *> enclosing_frame_lists =
+        std::exchange(frame_lists, escape_analysis.find(stmt));
     begin_scope();
     RuntimeFunction function{};
     function.arity = stmt.params.size();
     function.name = stmt.name.lexeme;
 
     for (auto begin = stmt.params.cbegin(); begin != stmt.params.cend(); begin++) {
-        scopes.top().push_back(begin->second.get());
+        scopes.back().push_back(begin->second.get());
     }
 
     current_chunk = &function.code;
     compile(stmt.body.get());
 
-    end_scope();
-    for (auto begin = stmt.params.crbegin(); begin != stmt.params.crend(); begin++) {
-        if (begin->second->primitive == Type::STRING) {
-            current_chunk->emit_instruction(Instruction::POP_STRING, 0);
-        } else if (begin->second->primitive == Type::LIST && not begin->second->is_ref) {
-            current_chunk->emit_instruction(Instruction::POP_LIST, 0);
-        } else {
-            current_chunk->emit_instruction(Instruction::POP, 0);
+    if (exits_block) {
+        // Every path through the body returns, so the function can never fall off its end
+        scopes.pop_back();
+    } else {
+        end_scope();
+        for (auto begin = stmt.params.crbegin(); begin != stmt.params.crend(); begin++) {
+            if (begin->second->primitive == Type::STRING) {
+                current_chunk->emit_instruction(Instruction::POP_STRING, 0);
+            } else if (begin->second->primitive == Type::LIST && not begin->second->is_ref) {
+                current_chunk->emit_instruction(Instruction::POP_LIST, 0);
+            } else {
+                current_chunk->emit_instruction(Instruction::POP, 0);
+            }
         }
-    }
 
-    if (stmt.return_type->primitive != Type::NULL_) {
-        if (auto *body = dynamic_cast<BlockStmt *>(stmt.body.get());
-            (not body->stmts.empty() && body->stmts.back()->type_tag() != NodeType::ReturnStmt) ||
-            body->stmts.empty()) {
+        if (stmt.return_type->primitive != Type::NULL_) {
             current_chunk->emit_instruction(Instruction::TRAP_RETURN, stmt.name.line);
         }
     }
 
-    current_compiled->functions[stmt.name.lexeme] = std::move(function);
+    peephole.optimize(function.code);
+    current_compiled->functions[std::string{stmt.name.lexeme}] = std::move(function);
     current_chunk = &current_compiled->top_level_code;
+    frame_lists = std::move(enclosing_frame_lists);
 }
 
 StmtVisitorType Generator::visit(IfStmt &stmt) {
+    if (std::optional<bool> condition = constant_condition(stmt.condition.get()); condition.has_value()) {
+        // Only the branch that is taken is compiled
+        if (*condition) {
+            compile(stmt.thenBranch.get());
+        } else if (stmt.elseBranch != nullptr) {
+            compile(stmt.elseBranch.get());
+        } else {
+            exits_block = false;
+        }
+        return;
+    }
+
     compile(stmt.condition.get());
     if (stmt.condition->resolved.info->is_ref) {
         current_chunk->emit_instruction(Instruction::DEREF, stmt.condition->resolved.token.line);
@@ -879,9 +1193,10 @@ StmtVisitorType Generator::visit(IfStmt &stmt) {
     emit_three_bytes_of(0);
     // Reserve three bytes for the offset
     compile(stmt.thenBranch.get());
+    bool then_exits = exits_block;
 
     std::size_t over_else = 0;
-    if (stmt.elseBranch != nullptr) {
+    if (stmt.elseBranch != nullptr && not then_exits) {
         over_else = current_chunk->emit_instruction(Instruction::JUMP_FORWARD, stmt.keyword.line);
         emit_three_bytes_of(0);
     }
@@ -906,9 +1221,13 @@ StmtVisitorType Generator::visit(IfStmt &stmt) {
      */
     if (stmt.elseBranch != nullptr) {
         compile(stmt.elseBranch.get());
-
-        std::size_t after_else = current_chunk->bytes.size();
-        patch_jump(over_else, after_else - over_else - 1);
+        if (not then_exits) {
+            std::size_t after_else = current_chunk->bytes.size();
+            patch_jump(over_else, after_else - over_else - 1);
+        }
+        exits_block = then_exits && exits_block;
+    } else {
+        exits_block = false;
     }
 }
 
@@ -925,7 +1244,8 @@ StmtVisitorType Generator::visit(ReturnStmt &stmt) {
     }
 
     current_chunk->emit_instruction(Instruction::RETURN, stmt.keyword.line);
-    emit_three_bytes_of(stmt.locals_popped);
+    emit_three_bytes_of(stmt.locals_popped + hoisted_count());
+    exits_block = true;
 }
 
 StmtVisitorType Generator::visit(SwitchStmt &stmt) {
@@ -957,6 +1277,7 @@ StmtVisitorType Generator::visit(SwitchStmt &stmt) {
      *
      */
     break_stmts.emplace();
+    break_scopes.push(scopes.size());
     compile(stmt.condition.get());
     if (stmt.condition->resolved.info->is_ref) {
         current_chunk->emit_instruction(Instruction::DEREF, stmt.condition->resolved.token.line);
@@ -993,6 +1314,7 @@ StmtVisitorType Generator::visit(SwitchStmt &stmt) {
     }
 
     break_stmts.pop();
+    break_scopes.pop();
 }
 
 StmtVisitorType Generator::visit(TypeStmt &stmt) {}
@@ -1032,7 +1354,11 @@ StmtVisitorType Generator::visit(VarStmt &stmt) {
             current_chunk->emit_constant(Value{0}, stmt.name.line);
         }
         current_chunk->emit_instruction(Instruction::MAKE_LIST, stmt.name.line);
+        emit_three_bytes_of(frame_lists.count(&stmt));
     } else if (stmt.initializer != nullptr) {
+        if (frame_lists.count(&stmt)) {
+            frame_list = dynamic_cast<ListExpr *>(stmt.initializer.get());
+        }
         if (stmt.type->is_ref && not stmt.initializer->resolved.info->is_ref &&
             stmt.initializer->type_tag() == NodeType::VariableExpr) {
             if (dynamic_cast<VariableExpr *>(stmt.initializer.get())->type == IdentifierType::LOCAL) {
@@ -1040,7 +1366,8 @@ StmtVisitorType Generator::visit(VarStmt &stmt) {
             } else {
                 current_chunk->emit_instruction(Instruction::MAKE_REF_TO_GLOBAL, stmt.name.line);
             }
-            emit_three_bytes_of(stmt.initializer->resolved.stack_slot);
+            emit_stack_slot(dynamic_cast<VariableExpr *>(stmt.initializer.get())->type,
+                stmt.initializer->resolved.stack_slot);
         } else if (stmt.type->is_ref && not stmt.initializer->resolved.info->is_ref &&
                    stmt.initializer->type_tag() == NodeType::IndexExpr) {
             auto *list = dynamic_cast<IndexExpr *>(stmt.initializer.get());
@@ -1065,7 +1392,7 @@ StmtVisitorType Generator::visit(VarStmt &stmt) {
     } else {
         current_chunk->emit_instruction(Instruction::PUSH_NULL, stmt.name.line);
     }
-    scopes.top().push_back(stmt.type.get());
+    scopes.back().push_back(stmt.type.get());
 }
 
 StmtVisitorType Generator::visit(WhileStmt &stmt) {
@@ -1096,22 +1423,49 @@ StmtVisitorType Generator::visit(WhileStmt &stmt) {
      * POP                                                       | | }
      * ACCESS_LOCAL          | access local 0 <------------------+ | ] - These three instructions are the condition
      * CONSTANT              -> 2 | value = 5                      | ]
-     * LESSER                                                      | ]
+     * ILT                                                         | ]
      * POP_JUMP_BACK_IF_TRUE | offset = -40 bytes, jump to = 8 ----+
      * POP
      * HALT
      *
      *   From this, the control flow should be obvious. I have tried to mirror
      *   what gcc generates for a loop in C.
+     *
+     *   Parts of the condition that have the same value on every iteration (like `size(x)` in
+     *   `i < size(x)` when nothing is appended to or popped from any list in the loop) are
+     *   computed once before the JUMP_FORWARD, and kept in the stack slots just below the locals
+     *   of the loop until it ends. The condition then accesses those slots instead.
      */
+    VarStmt *counter = std::exchange(loop_counter, nullptr);
+    std::vector<Expr *> invariants{};
+    if (current_chunk != &current_compiled->top_level_code) {
+        invariants = loop_invariants.find(stmt);
+    }
+    if (not invariants.empty()) {
+        begin_scope();
+        std::size_t stack_slot = stmt.stack_slot + hoisted_count();
+        for (Expr *invariant : invariants) {
+            compile(invariant);
+            scopes.back().push_back(invariant->resolved.info);
+            hoisted_values[invariant] = stack_slot++;
+        }
+        hoisted_slots.emplace_back(stmt.stack_slot, invariants.size());
+    }
+
     break_stmts.emplace();
     continue_stmts.emplace();
+    break_scopes.push(scopes.size());
+    continue_scopes.push(scopes.size());
 
     std::size_t jump_begin_idx = current_chunk->emit_instruction(Instruction::JUMP_FORWARD, stmt.keyword.line);
     emit_three_bytes_of(0);
 
     std::size_t loop_back_idx = current_chunk->bytes.size();
+    bool counted = bounds_checks.enter_loop(stmt, counter);
     compile(stmt.body.get());
+    if (counted) {
+        bounds_checks.leave_loop();
+    }
 
     std::size_t increment_idx = current_chunk->bytes.size();
     if (stmt.increment != nullptr) {
@@ -1142,6 +1496,16 @@ StmtVisitorType Generator::visit(WhileStmt &stmt) {
 
     continue_stmts.pop();
     break_stmts.pop();
+    continue_scopes.pop();
+    break_scopes.pop();
+
+    if (not invariants.empty()) {
+        for (Expr *invariant : invariants) {
+            hoisted_values.erase(invariant);
+        }
+        hoisted_slots.pop_back();
+        end_scope();
+    }
 }
 
 BaseTypeVisitorType Generator::visit(PrimitiveType &type) {
@@ -7,34 +7,92 @@
 #define CODE_GEN_HPP
 
 #include "../AST.hpp"
+#include "../IR/Backend.hpp"
+#include "../IR/IR.hpp"
+#include "../IR/Passes.hpp"
+#include "../Optimizer/BoundsChecks.hpp"
+#include "../Optimizer/EscapeAnalysis.hpp"
+#include "../Optimizer/Inliner.hpp"
+#include "../Optimizer/LoopInvariants.hpp"
+#include "../Optimizer/Peephole.hpp"
 #include "../VirtualMachine/Chunk.hpp"
 #include "../VirtualMachine/Module.hpp"
 #include "../VirtualMachine/Natives.hpp"
 
+#include <memory>
+#include <optional>
 #include <stack>
 #include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 
 class Generator final : Visitor {
     Chunk *current_chunk{nullptr};
     Module *current_module{nullptr};
     RuntimeModule *current_compiled{nullptr};
-    std::stack<std::vector<const BaseType *>> scopes{};
+    std::vector<std::vector<const BaseType *>> scopes{};
     std::stack<std::vector<std::size_t>> break_stmts{};
     // Push a new vector for every loop or switch statement encountered within a loop or switch statement, with the
     // vector tracking the indexes of the breaks
     std::stack<std::vector<std::size_t>> continue_stmts{};
     // Similar thing as for break statements
+    std::stack<std::size_t> break_scopes{};
+    std::stack<std::size_t> continue_scopes{};
+    // The number of scopes that were open when entering the loop or switch statement, so that break and continue can
+    // pop the locals of all the scopes they jump out of
     std::unordered_map<std::string_view, NativeFn> natives{};
+    BinaryExpr *lazy_range{nullptr};
+    // A range expression that is only read from (indexed, passed to a native, ...) and can thus be left as a RANGE
+    // value instead of being materialized into a list
+    PeepholeOptimizer peephole{};
+    Inliner inliner{};
+    bool inline_calls{true};
+    CallExpr *inlined_call{nullptr};
+    // The call whose function body is currently being compiled in place of it, parameters are replaced with the
+    // arguments of this call
+    bool exits_block{false};
+    // Set after compiling a statement that returns, breaks or continues on every path it can take, so that the code
+    // following it in the same block can be dropped
+    LoopInvariants loop_invariants{};
+    std::unordered_map<Expr *, std::size_t> hoisted_values{};
+    // The invariant parts of the conditions of the loops being compiled, mapped to the stack slots holding their values
+    std::vector<std::pair<std::size_t, std::size_t>> hoisted_slots{};
+    // For every loop with hoisted values, the stack slot the type resolver gave to its first local and the number of
+    // values hoisted, which sit below the locals of the loop and move them up the stack
+    BoundsChecks bounds_checks{};
+    VarStmt *loop_counter{nullptr};
+    // The variable declared just before the loop statement being compiled in the same block, which is how for-loops
+    // are desugared
+    EscapeAnalysis escape_analysis{};
+    std::unordered_set<const VarStmt *> frame_lists{};
+    // The lists declared in the function being compiled that never outlive a call to it, which are allocated from the
+    // frame arena of the VM
+    ListExpr *frame_list{nullptr};
+    // The list expression initializing one of those lists, so that it is created in the frame arena
+    bool use_ir{true};
+    PassManager ir_passes{};
+    IRBackend ir_backend{};
+    std::vector<std::unique_ptr<IRFunction>> ir_functions{};
+    // The functions that were compiled through the IR instead of straight from the AST, after the passes were run
 
     void begin_scope();
     void end_scope();
+    void emit_pop(const BaseType *type, std::size_t line_number);
+    void emit_pops_until(std::size_t scope_count, std::size_t line_number);
     void patch_jump(std::size_t jump_idx, std::size_t jump_amount);
     void emit_conversion(NumericConversionType conversion_type, std::size_t line_number);
     void emit_three_bytes_of(std::size_t value);
+    void emit_stack_slot(IdentifierType type, std::size_t stack_slot);
+    [[nodiscard]] std::size_t hoisted_count() const noexcept;
 
     std::size_t recursively_compile_size(ListType *list);
+    [[nodiscard]] static std::optional<bool> constant_condition(Expr *condition) noexcept;
+    [[nodiscard]] static bool is_pure(Expr *expr) noexcept;
+    [[nodiscard]] static bool can_inline(CallExpr &expr, const Inliner::Candidate &candidate) noexcept;
 
     ExprVisitorType compile(Expr *expr);
+    ExprVisitorType compile_lazy_range(Expr *expr);
     StmtVisitorType compile(Stmt *stmt);
     BaseTypeVisitorType compile(BaseType *type);
 
@@ -43,6 +101,14 @@ class Generator final : Visitor {
 
     Generator();
     RuntimeModule compile(Module &module);
+    [[nodiscard]] const PeepholeOptimizer &get_peephole_optimizer() const noexcept;
+    [[nodiscard]] const Inliner &get_inliner() const noexcept;
+    [[nodiscard]] const LoopInvariants &get_loop_invariants() const noexcept;
+    [[nodiscard]] const BoundsChecks &get_bounds_checks() const noexcept;
+    [[nodiscard]] const EscapeAnalysis &get_escape_analysis() const noexcept;
+    [[nodiscard]] const std::vector<std::unique_ptr<IRFunction>> &get_ir_functions() const noexcept;
+    void set_inline_calls(bool inline_calls) noexcept;
+    void set_use_ir(bool use_ir) noexcept;
 
     ExprVisitorType visit(AssignExpr &expr) override final;
     ExprVisitorType visit(BinaryExpr &expr) override final;
@@ -70,6 +136,7 @@ class Generator final : Visitor {
     StmtVisitorType visit(ClassStmt &stmt) override final;
     StmtVisitorType visit(ContinueStmt &stmt) override final;
     StmtVisitorType visit(ExpressionStmt &stmt) override final;
+    StmtVisitorType visit(ForEachStmt &stmt) override final;
     StmtVisitorType visit(FunctionStmt &stmt) override final;
     StmtVisitorType visit(IfStmt &stmt) override final;
     StmtVisitorType visit(ReturnStmt &stmt) override final;
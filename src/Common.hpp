@@ -31,7 +31,8 @@
     } while (0)
 #endif
 
+// Nodes are allocated from the arena of the module that is being parsed (see NodeArena.hpp)
 #define allocate_node(T, ...)                                                                                          \
-    new T { __VA_ARGS__ }
+    NodeArena::current().adopt(new (NodeArena::current().allocate(sizeof(T), alignof(T))) T{__VA_ARGS__})
 
 #endif
\ No newline at end of file
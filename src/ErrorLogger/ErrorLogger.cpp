@@ -6,7 +6,7 @@
 
 #include <iostream>
 
-ErrorLogger logger{};
+thread_local ErrorLogger logger{};
 
 void ErrorLogger::set_module_name(std::string_view name) {
     this->module_name = name;
@@ -16,13 +16,18 @@ void ErrorLogger::set_source(std::string_view file_source) {
     this->source = file_source;
 }
 
-void print_message(const std::vector<std::string> &message, const Token &where, const std::string_view prefix) {
-    std::cerr << "\n  | In module '" << logger.module_name << "',";
-    std::cerr << "\n!-| line " << where.line << " | " << prefix << ": ";
+void ErrorLogger::set_output(std::ostream &stream) {
+    this->output = &stream;
+}
+
+void print_message(const std::vector<std::string> &message, const TokenLocation &where, const std::string_view prefix) {
+    std::ostream &out = *logger.output;
+    out << "\n  | In module '" << logger.module_name << "',";
+    out << "\n!-| line " << where.line << " | " << prefix << ": ";
     for (const std::string &str : message) {
-        std::cerr << str;
+        out << str;
     }
-    std::cerr << '\n';
+    out << '\n';
     std::size_t line_start = where.start;
     std::size_t line_end = where.end;
     while (line_start > 0 && logger.source[line_start] != '\n') {
@@ -32,31 +37,31 @@ void print_message(const std::vector<std::string> &message, const Token &where,
         line_end++;
     }
 
-    std::cerr << " >| ";
+    out << " >| ";
     for (std::size_t i{line_start}; i < line_end; i++) {
-        std::cerr << logger.source[i];
+        out << logger.source[i];
         if (logger.source[i] == '\n') {
-            std::cerr << " >| ";
+            out << " >| ";
         }
     }
-    std::cerr << "\n >| ";
+    out << "\n >| ";
     for (std::size_t i{line_start + 1}; i < line_end; i++) {
         if (i == where.start || line_start == where.start) {
-            std::cerr << '^';
+            out << '^';
         } else if (where.start < i && i < where.end) {
-            std::cerr << '-';
+            out << '-';
         } else {
-            std::cerr << ' ';
+            out << ' ';
         }
     }
-    std::cerr << '\n';
+    out << '\n';
 }
 
-void warning(std::vector<std::string> message, const Token &where) {
+void warning(std::vector<std::string> message, const TokenLocation &where) {
     print_message(message, where, "Warning");
 }
 
-void error(std::vector<std::string> message, const Token &where) {
+void error(std::vector<std::string> message, const TokenLocation &where) {
     logger.had_error = true;
     print_message(message, where, "Error");
 }
@@ -64,6 +69,10 @@ void error(std::vector<std::string> message, const Token &where) {
 void runtime_error(const std::string_view message, std::size_t line_number) {
     logger.had_runtime_error = true;
     std::cerr << "\n!-| line " << line_number << " | Error: " << message << '\n';
+    // Code that is run from a bytecode file has no source to show the line from
+    if (logger.source.empty()) {
+        return;
+    }
     std::size_t line_count = 1;
     std::size_t i = 0;
     for (; line_count < line_number; i++) {
@@ -79,18 +88,20 @@ void runtime_error(const std::string_view message, std::size_t line_number) {
 }
 
 void note(std::vector<std::string> message) {
-    std::cerr << "->| note: ";
+    std::ostream &out = *logger.output;
+    out << "->| note: ";
     for (const std::string &str : message) {
-        std::cerr << str;
+        out << str;
     }
-    std::cerr << '\n';
+    out << '\n';
 }
 
 void compile_error(std::vector<std::string> message) {
-    std::cerr << "\n  | In module '" << logger.module_name << "',";
-    std::cerr << "\n!-| Compile error: ";
+    std::ostream &out = *logger.output;
+    out << "\n  | In module '" << logger.module_name << "',";
+    out << "\n!-| Compile error: ";
     for (const std::string &str : message) {
-        std::cerr << str;
+        out << str;
     }
-    std::cerr << '\n';
+    out << '\n';
 }
\ No newline at end of file
@@ -8,6 +8,7 @@
 
 #include "../Token.hpp"
 
+#include <iostream>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -17,14 +18,17 @@ struct ErrorLogger {
     bool had_runtime_error{false};
     std::string_view source{};
     std::string_view module_name{};
+    std::ostream *output{&std::cerr}; // Modules loaded on other threads collect their messages here to print them later
     void set_module_name(std::string_view name);
     void set_source(std::string_view file_source);
+    void set_output(std::ostream &stream);
 };
 
-extern ErrorLogger logger;
+// Each thread has a logger of its own, so that several modules can be compiled at once without mixing up their sources
+extern thread_local ErrorLogger logger;
 
-void warning(std::vector<std::string> message, const Token &where);
-void error(std::vector<std::string> message, const Token &where);
+void warning(std::vector<std::string> message, const TokenLocation &where);
+void error(std::vector<std::string> message, const TokenLocation &where);
 void runtime_error(std::string_view message, std::size_t line_number);
 void note(std::vector<std::string> message);
 void compile_error(std::vector<std::string> message);
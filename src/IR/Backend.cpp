@@ -0,0 +1,432 @@
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+#include "Backend.hpp"
+
+#include "../Common.hpp"
+#include "../ErrorLogger/ErrorLogger.hpp"
+#include "../VirtualMachine/Value.hpp"
+
+#include <algorithm>
+
+void IRBackend::compile(IRFunction &function, Chunk &chunk) {
+    this->function = &function;
+    this->chunk = &chunk;
+    users.clear();
+    use_counts.clear();
+    folded.clear();
+    slots.clear();
+    block_starts.clear();
+    jumps.clear();
+
+    split_critical_edges();
+    count_uses();
+    fold_trees();
+    assign_slots();
+
+    for (std::size_t i = 0; i < slot_count; i++) {
+        chunk.emit_instruction(Instruction::PUSH_NULL, 0);
+    }
+    for (std::size_t i = 0; i < function.blocks.size(); i++) {
+        BasicBlock *next = i + 1 < function.blocks.size() ? function.blocks[i + 1].get() : nullptr;
+        block_starts[function.blocks[i].get()] = chunk.bytes.size();
+        emit_block(function.blocks[i].get(), next);
+    }
+    patch_jumps();
+}
+
+void IRBackend::split_critical_edges() {
+    // The values of the PHIs in a block are stored at the end of its predecessors, which cannot be done in a block
+    // that also goes somewhere else
+    for (std::size_t i = 0; i < function->blocks.size(); i++) {
+        BasicBlock *block = function->blocks[i].get();
+        if (block->terminator != IRTerminator::BRANCH || block->successors[0] == block->successors[1]) {
+            continue;
+        }
+
+        for (BasicBlock *&target : block->successors) {
+            if (std::none_of(target->instructions.begin(), target->instructions.end(),
+                    [](const auto &instruction) { return instruction->opcode == IROpcode::PHI; })) {
+                continue;
+            }
+
+            auto split = std::make_unique<BasicBlock>();
+            split->id = function->next_block_id++;
+            split->predecessors.push_back(block);
+            split->terminator = IRTerminator::JUMP;
+            split->successors = {target, nullptr};
+            split->line = block->line;
+
+            target->predecessors[target->predecessor_index(block)] = split.get();
+            target = split.get();
+            function->blocks.insert(function->blocks.begin() + i + 1, std::move(split));
+        }
+    }
+}
+
+void IRBackend::count_uses() {
+    for (auto &block : function->blocks) {
+        for (auto &instruction : block->instructions) {
+            for (IRInstruction *operand : instruction->operands) {
+                users[operand].push_back(instruction.get());
+                use_counts[operand]++;
+            }
+        }
+        if (block->value != nullptr) {
+            use_counts[block->value]++;
+        }
+    }
+}
+
+void IRBackend::fold_trees() {
+    for (auto &block : function->blocks) {
+        fold_trees(block.get());
+    }
+}
+
+void IRBackend::fold_trees(BasicBlock *block) {
+    std::unordered_map<IRInstruction *, std::size_t> positions{};
+    for (auto &instruction : block->instructions) {
+        positions[instruction.get()] = positions.size();
+
+        if (instruction->opcode == IROpcode::PHI || instruction->opcode == IROpcode::CONSTANT ||
+            instruction->opcode == IROpcode::PARAM || use_counts[instruction.get()] != 1) {
+            continue;
+        }
+        if (block->value == instruction.get()) {
+            folded.insert(instruction.get()); // Used by the terminator of the same block
+        } else if (auto &used_by = users[instruction.get()];
+                   not used_by.empty() && used_by[0]->block == block && used_by[0]->opcode != IROpcode::PHI) {
+            folded.insert(instruction.get());
+        }
+    }
+
+    // A tree is evaluated in the order of the operands of its root, which can be different from the order in which
+    // the instructions were in the block (like in `var a = f(); var b = g(); return b - a;`). Side effects have to
+    // happen in the original order, so any side effecting instruction that ends up being evaluated too late is
+    // computed on its own instead
+    while (true) {
+        std::vector<IRInstruction *> effects{};
+        for (IRInstruction *root : roots(block)) {
+            collect_effects(root, effects);
+        }
+        if (block->value != nullptr && folded.count(block->value)) {
+            collect_effects(block->value, effects);
+        }
+
+        IRInstruction *latest = nullptr;
+        IRInstruction *out_of_order = nullptr;
+        for (IRInstruction *effect : effects) {
+            if (latest != nullptr && positions[effect] < positions[latest]) {
+                out_of_order = folded.count(effect) ? effect : latest;
+                break;
+            }
+            latest = effect;
+        }
+        if (out_of_order == nullptr) {
+            break;
+        }
+        folded.erase(out_of_order);
+    }
+}
+
+void IRBackend::assign_slots() {
+    std::size_t next_slot = function->params.size();
+    for (auto &block : function->blocks) {
+        for (auto &instruction : block->instructions) {
+            if (instruction->opcode == IROpcode::PHI) {
+                slots[instruction.get()] = next_slot++;
+            }
+        }
+    }
+
+    for (auto &block : function->blocks) {
+        std::vector<IRInstruction *> block_roots = roots(block.get());
+        for (std::size_t i = 0; i < block_roots.size(); i++) {
+            IRInstruction *root = block_roots[i];
+            if (use_counts[root] == 0) {
+                continue;
+            }
+
+            // A value only used by a PHI in the next block can be stored straight into the slot of the PHI, as long
+            // as the old value of the PHI is not needed anymore after this in the block
+            IRInstruction *phi = users[root].empty() ? nullptr : users[root].front();
+            if (use_counts[root] == 1 && phi != nullptr && phi->opcode == IROpcode::PHI &&
+                block->terminator == IRTerminator::JUMP && phi->block == block->successors[0]) {
+                bool is_read_later = std::any_of(block_roots.begin() + i + 1, block_roots.end(),
+                    [this, phi](IRInstruction *later) { return reads_slot(later, slots[phi]); });
+                for (auto [target, value] : edge_copies(block.get(), phi->block)) {
+                    is_read_later = is_read_later || value == phi;
+                }
+                if (not is_read_later) {
+                    slots[root] = slots[phi];
+                    continue;
+                }
+            }
+            slots[root] = next_slot++;
+        }
+    }
+    slot_count = next_slot - function->params.size();
+}
+
+void IRBackend::collect_effects(IRInstruction *root, std::vector<IRInstruction *> &effects) const {
+    for (IRInstruction *operand : root->operands) {
+        if (folded.count(operand)) {
+            collect_effects(operand, effects);
+        }
+    }
+    if (root->has_side_effects()) {
+        effects.push_back(root);
+    }
+}
+
+bool IRBackend::reads_slot(IRInstruction *root, std::size_t slot) const {
+    return std::any_of(root->operands.begin(), root->operands.end(), [this, slot](IRInstruction *operand) {
+        if (folded.count(operand)) {
+            return reads_slot(operand, slot);
+        }
+        auto found = slots.find(operand);
+        return found != slots.end() && found->second == slot;
+    });
+}
+
+std::vector<IRInstruction *> IRBackend::roots(BasicBlock *block) const {
+    std::vector<IRInstruction *> block_roots{};
+    for (auto &instruction : block->instructions) {
+        if (instruction->opcode != IROpcode::PHI && instruction->opcode != IROpcode::CONSTANT &&
+            instruction->opcode != IROpcode::PARAM && not folded.count(instruction.get())) {
+            block_roots.push_back(instruction.get());
+        }
+    }
+    return block_roots;
+}
+
+std::vector<std::pair<IRInstruction *, IRInstruction *>> IRBackend::edge_copies(
+    BasicBlock *from, BasicBlock *to) const {
+    std::vector<std::pair<IRInstruction *, IRInstruction *>> copies{};
+    std::size_t index = to->predecessor_index(from);
+    for (auto &instruction : to->instructions) {
+        if (instruction->opcode != IROpcode::PHI) {
+            continue;
+        }
+        IRInstruction *value = instruction->operands[index];
+        auto slot = slots.find(value);
+        if (slot == slots.end() || slot->second != slots.at(instruction.get())) {
+            copies.emplace_back(instruction.get(), value);
+        }
+    }
+    return copies;
+}
+
+void IRBackend::emit_block(BasicBlock *block, BasicBlock *next) {
+    for (IRInstruction *root : roots(block)) {
+        if (std::vector<IRInstruction *> effects{}; use_counts[root] == 0) {
+            collect_effects(root, effects);
+            if (effects.empty()) {
+                continue;
+            }
+        }
+        emit_tree(root);
+        if (auto slot = slots.find(root); slot != slots.end()) {
+            chunk->emit_instruction(Instruction::ASSIGN_LOCAL, root->line);
+            chunk->bytes.back() |= slot->second & 0x00ff'ffff;
+        }
+        chunk->emit_instruction(Instruction::POP, root->line);
+    }
+
+    switch (block->terminator) {
+        case IRTerminator::JUMP: {
+            // All the values are loaded before any of them is stored, since a PHI can be the value of another PHI
+            auto copies = edge_copies(block, block->successors[0]);
+            for (auto [phi, value] : copies) {
+                emit_value(value);
+            }
+            for (auto copy = copies.rbegin(); copy != copies.rend(); copy++) {
+                chunk->emit_instruction(Instruction::ASSIGN_LOCAL, block->line);
+                chunk->bytes.back() |= slots[copy->first] & 0x00ff'ffff;
+                chunk->emit_instruction(Instruction::POP, block->line);
+            }
+            if (block->successors[0] != next) {
+                emit_jump(Instruction::JUMP_FORWARD, Instruction::JUMP_BACKWARD, block->successors[0],
+                    block->line);
+            }
+            break;
+        }
+        case IRTerminator::BRANCH: {
+            emit_value(block->value);
+            BasicBlock *if_true = block->successors[0];
+            BasicBlock *if_false = block->successors[1];
+            if (if_false == next) {
+                emit_jump(Instruction::POP_JUMP_IF_TRUE, Instruction::POP_JUMP_BACK_IF_TRUE, if_true,
+                    block->line);
+            } else if (if_true == next) {
+                // There is no backward jump if false, so the condition is negated for that instead
+                bool is_forward = block_starts.count(if_false) == 0;
+                if (not is_forward) {
+                    chunk->emit_instruction(Instruction::NOT, block->line);
+                }
+                emit_jump(Instruction::POP_JUMP_IF_FALSE, Instruction::POP_JUMP_BACK_IF_TRUE, if_false,
+                    block->line);
+            } else {
+                emit_jump(Instruction::POP_JUMP_IF_TRUE, Instruction::POP_JUMP_BACK_IF_TRUE, if_true,
+                    block->line);
+                emit_jump(Instruction::JUMP_FORWARD, Instruction::JUMP_BACKWARD, if_false, block->line);
+            }
+            break;
+        }
+        case IRTerminator::RETURN:
+            if (block->value != nullptr) {
+                emit_value(block->value);
+            } else {
+                chunk->emit_instruction(Instruction::PUSH_NULL, block->line);
+            }
+            chunk->emit_instruction(Instruction::RETURN, block->line);
+            chunk->bytes.back() |= (function->params.size() + slot_count) & 0x00ff'ffff;
+            break;
+        case IRTerminator::TRAP: chunk->emit_instruction(Instruction::TRAP_RETURN, block->line); break;
+        case IRTerminator::NONE: unreachable();
+    }
+}
+
+void IRBackend::emit_value(IRInstruction *value) {
+    switch (value->opcode) {
+        case IROpcode::CONSTANT:
+            switch (value->constant.index()) {
+                case LiteralValue::tag::INT:
+                    chunk->emit_constant(Value{std::get<LiteralValue::tag::INT>(value->constant.value)}, value->line);
+                    break;
+                case LiteralValue::tag::DOUBLE:
+                    chunk->emit_constant(
+                        Value{std::get<LiteralValue::tag::DOUBLE>(value->constant.value)}, value->line);
+                    break;
+                case LiteralValue::tag::BOOL:
+                    chunk->emit_instruction(std::get<LiteralValue::tag::BOOL>(value->constant.value)
+                                                ? Instruction::PUSH_TRUE
+                                                : Instruction::PUSH_FALSE,
+                        value->line);
+                    break;
+                default: chunk->emit_instruction(Instruction::PUSH_NULL, value->line); break;
+            }
+            break;
+        case IROpcode::PARAM:
+            chunk->emit_instruction(Instruction::ACCESS_LOCAL, value->line);
+            chunk->bytes.back() |= value->index & 0x00ff'ffff;
+            break;
+        default:
+            if (folded.count(value)) {
+                emit_tree(value);
+            } else {
+                chunk->emit_instruction(Instruction::ACCESS_LOCAL, value->line);
+                chunk->bytes.back() |= slots[value] & 0x00ff'ffff;
+            }
+            break;
+    }
+}
+
+void IRBackend::emit_tree(IRInstruction *root) {
+    std::size_t line = root->line;
+    if (root->opcode == IROpcode::CALL || root->opcode == IROpcode::CALL_NATIVE) {
+        // The null is where the return value is stored, see Generator::visit(CallExpr &)
+        chunk->emit_instruction(Instruction::PUSH_NULL, line);
+        for (IRInstruction *operand : root->operands) {
+            emit_value(operand);
+        }
+        chunk->emit_string(std::string{root->callee}, line);
+        if (root->opcode == IROpcode::CALL) {
+            chunk->emit_instruction(Instruction::LOAD_FUNCTION, line);
+            chunk->emit_instruction(Instruction::CALL_FUNCTION, line);
+        } else {
+            chunk->emit_instruction(Instruction::CALL_NATIVE, line);
+            for (std::size_t i = 0; i < root->operands.size(); i++) {
+                chunk->emit_instruction(Instruction::POP, line);
+            }
+        }
+        return;
+    }
+
+    for (IRInstruction *operand : root->operands) {
+        emit_value(operand);
+    }
+
+    bool is_floating = root->type == Type::FLOAT;
+    // Comparisons produce a bool, the instruction is picked from the type of the (converted) operands instead. Only
+    // booleans are left to the generic instructions
+    auto comparison = [root](Instruction integral, Instruction floating, Instruction generic) {
+        switch (root->operands[0]->type) {
+            case Type::INT: return integral;
+            case Type::FLOAT: return floating;
+            default: return generic;
+        }
+    };
+    auto division = [root, is_floating](Instruction floating, Instruction checked, Instruction unchecked) {
+        if (is_floating) {
+            return floating;
+        }
+        return root->operands[1]->is_nonzero_constant() ? unchecked : checked;
+    };
+    switch (root->opcode) {
+        case IROpcode::ADD: chunk->emit_instruction(is_floating ? Instruction::FADD : Instruction::IADD, line); break;
+        case IROpcode::SUB: chunk->emit_instruction(is_floating ? Instruction::FSUB : Instruction::ISUB, line); break;
+        case IROpcode::MUL: chunk->emit_instruction(is_floating ? Instruction::FMUL : Instruction::IMUL, line); break;
+        case IROpcode::DIV:
+            chunk->emit_instruction(division(Instruction::FDIV, Instruction::IDIV, Instruction::IDIV_NONZERO), line);
+            break;
+        case IROpcode::MOD:
+            chunk->emit_instruction(division(Instruction::FMOD, Instruction::IMOD, Instruction::IMOD_NONZERO), line);
+            break;
+        case IROpcode::NEG: chunk->emit_instruction(is_floating ? Instruction::FNEG : Instruction::INEG, line); break;
+
+        case IROpcode::BIT_AND: chunk->emit_instruction(Instruction::BIT_AND, line); break;
+        case IROpcode::BIT_OR: chunk->emit_instruction(Instruction::BIT_OR, line); break;
+        case IROpcode::BIT_XOR: chunk->emit_instruction(Instruction::BIT_XOR, line); break;
+        case IROpcode::BIT_NOT: chunk->emit_instruction(Instruction::BIT_NOT, line); break;
+        case IROpcode::SHIFT_LEFT: chunk->emit_instruction(Instruction::SHIFT_LEFT, line); break;
+        case IROpcode::SHIFT_RIGHT: chunk->emit_instruction(Instruction::SHIFT_RIGHT, line); break;
+
+        case IROpcode::NOT: chunk->emit_instruction(Instruction::NOT, line); break;
+        case IROpcode::EQUAL:
+            chunk->emit_instruction(comparison(Instruction::IEQ, Instruction::FEQ, Instruction::EQUAL), line);
+            break;
+        case IROpcode::NOT_EQUAL:
+            chunk->emit_instruction(comparison(Instruction::IEQ, Instruction::FEQ, Instruction::EQUAL), line);
+            chunk->emit_instruction(Instruction::NOT, line);
+            break;
+        case IROpcode::LESS:
+            chunk->emit_instruction(comparison(Instruction::ILT, Instruction::FLT, Instruction::LESSER), line);
+            break;
+        case IROpcode::LESS_EQUAL:
+            chunk->emit_instruction(comparison(Instruction::IGT, Instruction::FGT, Instruction::GREATER), line);
+            chunk->emit_instruction(Instruction::NOT, line);
+            break;
+        case IROpcode::GREATER:
+            chunk->emit_instruction(comparison(Instruction::IGT, Instruction::FGT, Instruction::GREATER), line);
+            break;
+        case IROpcode::GREATER_EQUAL:
+            chunk->emit_instruction(comparison(Instruction::ILT, Instruction::FLT, Instruction::LESSER), line);
+            chunk->emit_instruction(Instruction::NOT, line);
+            break;
+
+        case IROpcode::INT_TO_FLOAT: chunk->emit_instruction(Instruction::INT_TO_FLOAT, line); break;
+        case IROpcode::FLOAT_TO_INT: chunk->emit_instruction(Instruction::FLOAT_TO_INT, line); break;
+
+        default: unreachable();
+    }
+}
+
+void IRBackend::emit_jump(Instruction forward, Instruction backward, BasicBlock *to, std::size_t line) {
+    // Blocks are emitted in order, so a block that has already been started is behind the jump
+    bool is_forward = block_starts.count(to) == 0;
+    std::size_t index = chunk->emit_instruction(is_forward ? forward : backward, line);
+    jumps.push_back({index, to, is_forward});
+}
+
+void IRBackend::patch_jumps() {
+    for (auto [index, target, is_forward] : jumps) {
+        std::size_t target_index = block_starts[target];
+        std::size_t offset = is_forward ? target_index - index - 1 : index + 1 - target_index;
+        if (offset >= Chunk::const_long_max) {
+            compile_error({"Size of jump is greater than that allowed by the instruction set"});
+            continue;
+        }
+        chunk->bytes[index] |= offset & 0x00ff'ffff;
+    }
+}
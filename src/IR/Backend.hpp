@@ -0,0 +1,64 @@
+#pragma once
+
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+
+#ifndef BACKEND_HPP
+#define BACKEND_HPP
+
+#include "../VirtualMachine/Chunk.hpp"
+#include "IR.hpp"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Emits bytecode for a function in the IR. The VM is a stack machine, so values are turned back into expression trees
+// where possible: a value that is used exactly once, by an instruction later on in the same block, is computed right
+// where it is used instead of being stored. Every other value gets a stack slot of its own after the parameters, which
+// are all pushed when the function is entered and popped by RETURN. The value of a PHI is stored into its slot at the
+// end of each of its predecessors (a predecessor ending in a branch gets a new block for this), unless the value
+// coming from that predecessor can be computed straight into the slot of the PHI.
+class IRBackend {
+    struct Jump {
+        std::size_t index{};
+        BasicBlock *target{};
+        bool is_forward{};
+    };
+
+    IRFunction *function{nullptr};
+    Chunk *chunk{nullptr};
+
+    std::unordered_map<IRInstruction *, std::vector<IRInstruction *>> users{};
+    std::unordered_map<IRInstruction *, std::size_t> use_counts{};
+    std::unordered_set<IRInstruction *> folded{};
+    std::unordered_map<IRInstruction *, std::size_t> slots{};
+    std::unordered_map<const BasicBlock *, std::size_t> block_starts{};
+    std::vector<Jump> jumps{};
+    std::size_t slot_count{};
+
+    void split_critical_edges();
+    void count_uses();
+    void fold_trees();
+    void fold_trees(BasicBlock *block);
+    void assign_slots();
+
+    // The side effecting instructions of a block (including the ones folded into other instructions) in the order in
+    // which they would be emitted
+    void collect_effects(IRInstruction *root, std::vector<IRInstruction *> &effects) const;
+    [[nodiscard]] bool reads_slot(IRInstruction *root, std::size_t slot) const;
+    [[nodiscard]] std::vector<IRInstruction *> roots(BasicBlock *block) const;
+    [[nodiscard]] std::vector<std::pair<IRInstruction *, IRInstruction *>> edge_copies(
+        BasicBlock *from, BasicBlock *to) const;
+
+    void emit_block(BasicBlock *block, BasicBlock *next);
+    void emit_value(IRInstruction *value);
+    void emit_tree(IRInstruction *root);
+    void emit_jump(Instruction forward, Instruction backward, BasicBlock *to, std::size_t line);
+    void patch_jumps();
+
+  public:
+    void compile(IRFunction &function, Chunk &chunk);
+};
+
+#endif
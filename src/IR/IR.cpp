@@ -0,0 +1,252 @@
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+#include "IR.hpp"
+
+#include "../Common.hpp"
+
+#include <algorithm>
+
+bool IRInstruction::is_constant() const noexcept {
+    return opcode == IROpcode::CONSTANT;
+}
+
+bool IRInstruction::is_nonzero_constant() const noexcept {
+    return is_constant() && constant.is_numeric() && constant.to_numeric() != 0;
+}
+
+bool IRInstruction::has_side_effects() const noexcept {
+    switch (opcode) {
+        // Dividing the smallest int by -1 traps, so that is the only constant divisor that is not safe
+        case IROpcode::DIV:
+        case IROpcode::MOD:
+            return not operands[1]->is_nonzero_constant() ||
+                   (operands[1]->constant.is_int() && operands[1]->constant.to_numeric() == -1);
+        case IROpcode::SHIFT_LEFT:
+        case IROpcode::SHIFT_RIGHT: return not operands[1]->is_constant() || operands[1]->constant.to_numeric() < 0;
+        case IROpcode::CALL:
+        case IROpcode::CALL_NATIVE: return true;
+        default: return false;
+    }
+}
+
+std::size_t BasicBlock::successor_count() const noexcept {
+    switch (terminator) {
+        case IRTerminator::JUMP: return 1;
+        case IRTerminator::BRANCH: return 2;
+        default: return 0;
+    }
+}
+
+std::size_t BasicBlock::predecessor_index(const BasicBlock *predecessor) const noexcept {
+    return std::find(predecessors.begin(), predecessors.end(), predecessor) - predecessors.begin();
+}
+
+BasicBlock *IRFunction::create_block() {
+    auto &block = blocks.emplace_back(std::make_unique<BasicBlock>());
+    block->id = next_block_id++;
+    return block.get();
+}
+
+IRInstruction *IRFunction::append(
+    BasicBlock *block, IROpcode opcode, Type type, std::vector<IRInstruction *> operands, std::size_t line) {
+    auto &instruction = block->instructions.emplace_back(std::make_unique<IRInstruction>());
+    instruction->id = next_value_id++;
+    instruction->opcode = opcode;
+    instruction->type = type;
+    instruction->operands = std::move(operands);
+    instruction->block = block;
+    instruction->line = line;
+    return instruction.get();
+}
+
+IRInstruction *IRFunction::prepend_phi(BasicBlock *block, Type type, std::size_t line) {
+    auto phi = std::make_unique<IRInstruction>();
+    phi->id = next_value_id++;
+    phi->opcode = IROpcode::PHI;
+    phi->type = type;
+    phi->block = block;
+    phi->line = line;
+    return block->instructions.insert(block->instructions.begin(), std::move(phi))->get();
+}
+
+IRInstruction *IRFunction::constant(BasicBlock *block, LiteralValue value, Type type, std::size_t line) {
+    IRInstruction *instruction = append(block, IROpcode::CONSTANT, type, {}, line);
+    instruction->constant = std::move(value);
+    return instruction;
+}
+
+void IRFunction::jump(BasicBlock *from, BasicBlock *to, std::size_t line) {
+    from->terminator = IRTerminator::JUMP;
+    from->successors = {to, nullptr};
+    from->line = line;
+    to->predecessors.push_back(from);
+}
+
+void IRFunction::branch(
+    BasicBlock *from, IRInstruction *condition, BasicBlock *if_true, BasicBlock *if_false, std::size_t line) {
+    from->terminator = IRTerminator::BRANCH;
+    from->value = condition;
+    from->successors = {if_true, if_false};
+    from->line = line;
+    if_true->predecessors.push_back(from);
+    if_false->predecessors.push_back(from);
+}
+
+void IRFunction::remove_edge(BasicBlock *from, BasicBlock *to) {
+    std::size_t index = to->predecessor_index(from);
+    if (index == to->predecessors.size()) {
+        return;
+    }
+    to->predecessors.erase(to->predecessors.begin() + index);
+    for (auto &instruction : to->instructions) {
+        if (instruction->opcode != IROpcode::PHI) {
+            break;
+        }
+        instruction->operands.erase(instruction->operands.begin() + index);
+    }
+}
+
+void IRFunction::replace_uses(IRInstruction *value, IRInstruction *replacement) {
+    for (auto &block : blocks) {
+        for (auto &instruction : block->instructions) {
+            std::replace(instruction->operands.begin(), instruction->operands.end(), value, replacement);
+        }
+        if (block->value == value) {
+            block->value = replacement;
+        }
+    }
+}
+
+std::string_view opcode_name(IROpcode opcode) noexcept {
+    switch (opcode) {
+        case IROpcode::PARAM: return "param";
+        case IROpcode::CONSTANT: return "const";
+        case IROpcode::PHI: return "phi";
+        case IROpcode::ADD: return "add";
+        case IROpcode::SUB: return "sub";
+        case IROpcode::MUL: return "mul";
+        case IROpcode::DIV: return "div";
+        case IROpcode::MOD: return "mod";
+        case IROpcode::NEG: return "neg";
+        case IROpcode::BIT_AND: return "bit_and";
+        case IROpcode::BIT_OR: return "bit_or";
+        case IROpcode::BIT_XOR: return "bit_xor";
+        case IROpcode::BIT_NOT: return "bit_not";
+        case IROpcode::SHIFT_LEFT: return "shift_left";
+        case IROpcode::SHIFT_RIGHT: return "shift_right";
+        case IROpcode::NOT: return "not";
+        case IROpcode::EQUAL: return "equal";
+        case IROpcode::NOT_EQUAL: return "not_equal";
+        case IROpcode::LESS: return "less";
+        case IROpcode::LESS_EQUAL: return "less_equal";
+        case IROpcode::GREATER: return "greater";
+        case IROpcode::GREATER_EQUAL: return "greater_equal";
+        case IROpcode::INT_TO_FLOAT: return "int_to_float";
+        case IROpcode::FLOAT_TO_INT: return "float_to_int";
+        case IROpcode::CALL: return "call";
+        case IROpcode::CALL_NATIVE: return "call_native";
+    }
+    unreachable();
+}
+
+namespace {
+std::string_view type_name(Type type) noexcept {
+    switch (type) {
+        case Type::BOOL: return "bool";
+        case Type::INT: return "int";
+        case Type::FLOAT: return "float";
+        case Type::NULL_: return "null";
+        default: return "?";
+    }
+}
+
+void print_constant(std::ostream &out, const LiteralValue &value) {
+    switch (value.index()) {
+        case LiteralValue::tag::INT: out << std::get<LiteralValue::tag::INT>(value.value); break;
+        case LiteralValue::tag::DOUBLE: out << std::get<LiteralValue::tag::DOUBLE>(value.value); break;
+        case LiteralValue::tag::BOOL: out << (std::get<LiteralValue::tag::BOOL>(value.value) ? "true" : "false"); break;
+        default: out << "null"; break;
+    }
+}
+} // namespace
+
+void IRFunction::print(std::ostream &out) const {
+    /*
+     * For example, `fn f(x: int) -> int { var y = 0; while (y < x) { ++y; } return y; }` is printed as
+     *
+     * function f(int) -> int
+     * bb0:
+     *     %0 = param int 0
+     *     %1 = const int 0
+     *     jump bb3
+     * bb1: ; preds: bb3
+     *     %4 = const int 1
+     *     %5 = add int %2, %4
+     *     jump bb3
+     * bb3: ; preds: bb0, bb1
+     *     %2 = phi int [%1, bb0], [%5, bb1]
+     *     %3 = less bool %2, %0
+     *     branch %3, bb1, bb2
+     * bb2: ; preds: bb3
+     *     return %2
+     */
+    out << "function " << name << '(';
+    for (std::size_t i = 0; i < params.size(); i++) {
+        out << (i > 0 ? ", " : "") << type_name(params[i]);
+    }
+    out << ") -> " << type_name(return_type) << '\n';
+
+    for (const auto &block : blocks) {
+        out << "bb" << block->id << ':';
+        if (not block->predecessors.empty()) {
+            out << " ; preds: ";
+            for (std::size_t i = 0; i < block->predecessors.size(); i++) {
+                out << (i > 0 ? ", " : "") << "bb" << block->predecessors[i]->id;
+            }
+        }
+        out << '\n';
+
+        for (const auto &instruction : block->instructions) {
+            out << "    %" << instruction->id << " = " << opcode_name(instruction->opcode) << ' '
+                << type_name(instruction->type);
+            switch (instruction->opcode) {
+                case IROpcode::PARAM: out << ' ' << instruction->index; break;
+                case IROpcode::CONSTANT:
+                    out << ' ';
+                    print_constant(out, instruction->constant);
+                    break;
+                case IROpcode::PHI:
+                    for (std::size_t i = 0; i < instruction->operands.size(); i++) {
+                        out << (i > 0 ? ", [%" : " [%") << instruction->operands[i]->id << ", bb"
+                            << block->predecessors[i]->id << ']';
+                    }
+                    break;
+                case IROpcode::CALL:
+                case IROpcode::CALL_NATIVE: out << ' ' << instruction->callee; [[fallthrough]];
+                default:
+                    for (std::size_t i = 0; i < instruction->operands.size(); i++) {
+                        out << (i > 0 ? ", %" : " %") << instruction->operands[i]->id;
+                    }
+                    break;
+            }
+            out << '\n';
+        }
+
+        switch (block->terminator) {
+            case IRTerminator::NONE: out << "    <no terminator>\n"; break;
+            case IRTerminator::JUMP: out << "    jump bb" << block->successors[0]->id << '\n'; break;
+            case IRTerminator::BRANCH:
+                out << "    branch %" << block->value->id << ", bb" << block->successors[0]->id << ", bb"
+                    << block->successors[1]->id << '\n';
+                break;
+            case IRTerminator::RETURN:
+                out << "    return";
+                if (block->value != nullptr) {
+                    out << " %" << block->value->id;
+                }
+                out << '\n';
+                break;
+            case IRTerminator::TRAP: out << "    trap\n"; break;
+        }
+    }
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+
+#ifndef IR_HPP
+#define IR_HPP
+
+#include "../VisitorTypes.hpp"
+
+#include <array>
+#include <memory>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+// The intermediate representation that functions are lowered to between the type checked AST and bytecode. Every
+// value is defined exactly once (static single assignment form), by an instruction in a basic block. Local variables
+// do not exist in it: a read of a variable is replaced by the value last assigned to it, and where control flow
+// merges different values of a variable, a PHI instruction at the start of the merging block selects the value that
+// corresponds to the edge that was taken.
+//
+// Values are typed with the primitive type of the AST (only INT, FLOAT and BOOL are used for now, or NULL_ for calls
+// to functions that return nothing). Operands of arithmetic and comparisons always have the same type, conversions
+// are explicit INT_TO_FLOAT and FLOAT_TO_INT instructions.
+enum class IROpcode {
+    PARAM,    // A parameter of the function, `index` is its position
+    CONSTANT, // `constant` holds the value
+    PHI,      // One operand for every predecessor of the block, in the same order as `BasicBlock::predecessors`
+
+    ADD,
+    SUB,
+    MUL,
+    DIV, // Division and modulo raise a runtime error when dividing by zero
+    MOD,
+    NEG,
+
+    BIT_AND,
+    BIT_OR,
+    BIT_XOR,
+    BIT_NOT,
+    SHIFT_LEFT, // Shifts report a runtime error when shifting by a negative amount
+    SHIFT_RIGHT,
+
+    NOT,
+    EQUAL,
+    NOT_EQUAL,
+    LESS,
+    LESS_EQUAL, // As in the VM, `a <= b` is `not (a > b)` and `a >= b` is `not (a < b)`, which matters for NaNs
+    GREATER,
+    GREATER_EQUAL,
+
+    INT_TO_FLOAT,
+    FLOAT_TO_INT,
+
+    CALL,       // Calls the function named `callee` in the module being compiled with the operands as arguments
+    CALL_NATIVE // Calls the native function named `callee`
+};
+
+struct BasicBlock;
+
+struct IRInstruction {
+    std::size_t id{};
+    IROpcode opcode{};
+    Type type{};
+    std::vector<IRInstruction *> operands{};
+    LiteralValue constant{};
+    std::size_t index{};
+    std::string_view callee{};
+    BasicBlock *block{nullptr};
+    std::size_t line{};
+
+    [[nodiscard]] bool is_constant() const noexcept;
+    // Whether the instruction is a numeric constant other than zero, so that dividing by it can never fail
+    [[nodiscard]] bool is_nonzero_constant() const noexcept;
+    // Whether the instruction can raise an error or do anything else than produce its value, so that it cannot be
+    // removed when its value is not used, or be evaluated in a different order than other such instructions
+    [[nodiscard]] bool has_side_effects() const noexcept;
+};
+
+enum class IRTerminator {
+    NONE,   // Only while the block is being built
+    JUMP,   // To `successors[0]`
+    BRANCH, // To `successors[0]` if `value` is true, to `successors[1]` otherwise
+    RETURN, // Returns `value`, or null if it is nullptr
+    TRAP    // Raises the error for reaching the end of a function that should have returned a value
+};
+
+struct BasicBlock {
+    std::size_t id{};
+    std::vector<std::unique_ptr<IRInstruction>> instructions{}; // PHI instructions always come first
+    std::vector<BasicBlock *> predecessors{};
+    IRTerminator terminator{IRTerminator::NONE};
+    IRInstruction *value{nullptr};
+    std::array<BasicBlock *, 2> successors{};
+    std::size_t line{}; // The line of the terminator
+
+    [[nodiscard]] std::size_t successor_count() const noexcept;
+    [[nodiscard]] std::size_t predecessor_index(const BasicBlock *predecessor) const noexcept;
+};
+
+struct IRFunction {
+    std::string_view name{};
+    std::vector<Type> params{};
+    Type return_type{};
+    std::vector<std::unique_ptr<BasicBlock>> blocks{}; // The first block is the entry, blocks are kept in the order in
+                                                       // which they are laid out in the bytecode
+    std::size_t next_value_id{};
+    std::size_t next_block_id{};
+
+    [[nodiscard]] BasicBlock *create_block();
+    IRInstruction *append(BasicBlock *block, IROpcode opcode, Type type, std::vector<IRInstruction *> operands,
+        std::size_t line);
+    IRInstruction *prepend_phi(BasicBlock *block, Type type, std::size_t line);
+    IRInstruction *constant(BasicBlock *block, LiteralValue value, Type type, std::size_t line);
+
+    void jump(BasicBlock *from, BasicBlock *to, std::size_t line);
+    void branch(BasicBlock *from, IRInstruction *condition, BasicBlock *if_true, BasicBlock *if_false,
+        std::size_t line);
+    // Removes the edge from `from` to `to` along with the corresponding operands of the PHIs in `to`
+    void remove_edge(BasicBlock *from, BasicBlock *to);
+
+    // Replaces every use of `value` (as an operand or as the value of a terminator) with `replacement`
+    void replace_uses(IRInstruction *value, IRInstruction *replacement);
+
+    void print(std::ostream &out) const;
+};
+
+[[nodiscard]] std::string_view opcode_name(IROpcode opcode) noexcept;
+
+#endif
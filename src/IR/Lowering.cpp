@@ -0,0 +1,701 @@
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+#include "Lowering.hpp"
+
+#include <algorithm>
+
+IRLowering::IRLowering(Inliner *inliner, std::string_view module_name)
+    : inliner{inliner}, module_name{module_name} {}
+
+bool IRLowering::is_value_type(const BaseType *type) noexcept {
+    return not type->is_ref &&
+           (type->primitive == Type::INT || type->primitive == Type::FLOAT || type->primitive == Type::BOOL);
+}
+
+bool IRLowering::can_call(FunctionStmt *function) {
+    if (function == nullptr || function->return_type->is_ref ||
+        (not is_value_type(function->return_type.get()) && function->return_type->primitive != Type::NULL_)) {
+        return false;
+    }
+    return std::all_of(function->params.begin(), function->params.end(),
+        [](const auto &param) { return is_value_type(param.second.get()); });
+}
+
+bool IRLowering::can_lower(FunctionStmt &function) {
+    return can_call(&function) && can_lower(function.body.get());
+}
+
+bool IRLowering::can_lower(Stmt *stmt) {
+    if (stmt == nullptr) {
+        return true;
+    }
+
+    switch (stmt->type_tag()) {
+        case NodeType::BlockStmt: {
+            auto *block = dynamic_cast<BlockStmt *>(stmt);
+            return std::all_of(block->stmts.begin(), block->stmts.end(),
+                [](const StmtNode &inner) { return can_lower(inner.get()); });
+        }
+        case NodeType::BreakStmt:
+        case NodeType::ContinueStmt: return true;
+        case NodeType::ExpressionStmt: return can_lower(dynamic_cast<ExpressionStmt *>(stmt)->expr.get());
+        case NodeType::IfStmt: {
+            auto *if_stmt = dynamic_cast<IfStmt *>(stmt);
+            return can_lower(if_stmt->condition.get()) && can_lower(if_stmt->thenBranch.get()) &&
+                   can_lower(if_stmt->elseBranch.get());
+        }
+        case NodeType::ReturnStmt: {
+            auto *return_stmt = dynamic_cast<ReturnStmt *>(stmt);
+            return return_stmt->value == nullptr || can_lower(return_stmt->value.get());
+        }
+        case NodeType::VarStmt: {
+            auto *var = dynamic_cast<VarStmt *>(stmt);
+            return is_value_type(var->type.get()) && var->initializer != nullptr && can_lower(var->initializer.get());
+        }
+        case NodeType::WhileStmt: {
+            auto *loop = dynamic_cast<WhileStmt *>(stmt);
+            return can_lower(loop->condition.get()) && can_lower(loop->body.get()) &&
+                   can_lower(loop->increment.get());
+        }
+        default: return false;
+    }
+}
+
+bool IRLowering::can_lower(Expr *expr) {
+    if (not is_value_type(expr->resolved.info) && expr->resolved.info->primitive != Type::NULL_) {
+        return false;
+    }
+
+    switch (expr->type_tag()) {
+        case NodeType::AssignExpr: {
+            auto *assign = dynamic_cast<AssignExpr *>(expr);
+            switch (assign->resolved.token.type) {
+                case TokenType::EQUAL:
+                case TokenType::PLUS_EQUAL:
+                case TokenType::MINUS_EQUAL:
+                case TokenType::STAR_EQUAL:
+                case TokenType::SLASH_EQUAL: break;
+                default: return false;
+            }
+            return assign->target_type == IdentifierType::LOCAL && is_value_type(assign->resolved.info) &&
+                   is_value_type(assign->value->resolved.info) && can_lower(assign->value.get());
+        }
+        case NodeType::BinaryExpr: {
+            auto *binary = dynamic_cast<BinaryExpr *>(expr);
+            switch (binary->resolved.token.type) {
+                case TokenType::PLUS:
+                case TokenType::MINUS:
+                case TokenType::STAR:
+                case TokenType::SLASH:
+                case TokenType::MODULO:
+                case TokenType::LEFT_SHIFT:
+                case TokenType::RIGHT_SHIFT:
+                case TokenType::BIT_AND:
+                case TokenType::BIT_OR:
+                case TokenType::BIT_XOR:
+                case TokenType::EQUAL_EQUAL:
+                case TokenType::NOT_EQUAL:
+                case TokenType::LESS:
+                case TokenType::LESS_EQUAL:
+                case TokenType::GREATER:
+                case TokenType::GREATER_EQUAL: break;
+                default: return false;
+            }
+            return is_value_type(binary->left->resolved.info) && is_value_type(binary->right->resolved.info) &&
+                   can_lower(binary->left.get()) && can_lower(binary->right.get());
+        }
+        case NodeType::CallExpr: {
+            auto *call = dynamic_cast<CallExpr *>(expr);
+            if (call->function->type_tag() != NodeType::VariableExpr) {
+                return false;
+            }
+            auto *called = dynamic_cast<VariableExpr *>(call->function.get());
+            if (call->is_native_call) {
+                if (called->name.lexeme != "print" && called->name.lexeme != "int" && called->name.lexeme != "float") {
+                    return false;
+                }
+            } else if (called->type != IdentifierType::FUNCTION || not can_call(called->resolved.func) ||
+                       called->resolved.func->params.size() != call->args.size()) {
+                return false;
+            }
+            return std::all_of(call->args.begin(), call->args.end(), [](const auto &arg) {
+                Expr *value = std::get<ExprNode>(arg).get();
+                return not std::get<RequiresCopy>(arg) && is_value_type(value->resolved.info) && can_lower(value);
+            });
+        }
+        case NodeType::GroupingExpr: return can_lower(dynamic_cast<GroupingExpr *>(expr)->expr.get());
+        case NodeType::LiteralExpr: {
+            auto *literal = dynamic_cast<LiteralExpr *>(expr);
+            return literal->value.is_int() || literal->value.is_double() || literal->value.is_bool();
+        }
+        case NodeType::LogicalExpr: {
+            auto *logical = dynamic_cast<LogicalExpr *>(expr);
+            return logical->left->resolved.info->primitive == Type::BOOL &&
+                   logical->right->resolved.info->primitive == Type::BOOL &&
+                   is_value_type(logical->left->resolved.info) && is_value_type(logical->right->resolved.info) &&
+                   can_lower(logical->left.get()) && can_lower(logical->right.get());
+        }
+        case NodeType::TernaryExpr: {
+            auto *ternary = dynamic_cast<TernaryExpr *>(expr);
+            return is_value_type(ternary->left->resolved.info) && is_value_type(ternary->resolved.info) &&
+                   ternary->middle->resolved.info->primitive == ternary->resolved.info->primitive &&
+                   ternary->right->resolved.info->primitive == ternary->resolved.info->primitive &&
+                   can_lower(ternary->left.get()) && can_lower(ternary->middle.get()) &&
+                   can_lower(ternary->right.get());
+        }
+        case NodeType::UnaryExpr: {
+            auto *unary = dynamic_cast<UnaryExpr *>(expr);
+            if (not is_value_type(unary->right->resolved.info)) {
+                return false;
+            }
+            switch (unary->oper.type) {
+                case TokenType::MINUS:
+                case TokenType::NOT:
+                case TokenType::BIT_NOT: return can_lower(unary->right.get());
+                case TokenType::PLUS_PLUS:
+                case TokenType::MINUS_MINUS: {
+                    auto *variable = dynamic_cast<VariableExpr *>(unary->right.get());
+                    return variable != nullptr && variable->type == IdentifierType::LOCAL &&
+                           (variable->resolved.info->primitive == Type::INT ||
+                               variable->resolved.info->primitive == Type::FLOAT);
+                }
+                default: return false;
+            }
+        }
+        case NodeType::VariableExpr: {
+            auto *variable = dynamic_cast<VariableExpr *>(expr);
+            return variable->type == IdentifierType::LOCAL && is_value_type(variable->resolved.info);
+        }
+        default: return false;
+    }
+}
+
+std::unique_ptr<IRFunction> IRLowering::lower(FunctionStmt &stmt) {
+    function = std::make_unique<IRFunction>();
+    function->name = stmt.name.lexeme;
+    function->return_type = stmt.return_type->primitive;
+
+    BasicBlock *entry = function->create_block();
+    start_block(entry);
+    seal_block(entry);
+    for (auto &[name, type] : stmt.params) {
+        IRInstruction *param = emit(IROpcode::PARAM, type->primitive, {}, name.line);
+        param->index = function->params.size();
+        write_variable(function->params.size(), entry, param);
+        function->params.push_back(type->primitive);
+    }
+    next_slot = function->params.size();
+
+    lower(stmt.body.get());
+    if (current->terminator == IRTerminator::NONE) {
+        // Only functions returning null can reach their end, the type checker makes sure that every other one returns
+        current->terminator = function->return_type == Type::NULL_ ? IRTerminator::RETURN : IRTerminator::TRAP;
+        current->line = stmt.name.line;
+    }
+    if (failed) {
+        return nullptr;
+    }
+
+    // PHIs that turned out to be unnecessary are only removed now, since they could still be referred to while the
+    // function was being lowered
+    for (auto &block : function->blocks) {
+        auto &instructions = block->instructions;
+        instructions.erase(std::remove_if(instructions.begin(), instructions.end(),
+                               [this](const auto &instruction) { return replaced_phis.count(instruction.get()); }),
+            instructions.end());
+    }
+
+    std::vector<std::unique_ptr<BasicBlock>> blocks{};
+    for (BasicBlock *block : layout) {
+        auto owned = std::find_if(function->blocks.begin(), function->blocks.end(),
+            [block](const auto &candidate) { return candidate.get() == block; });
+        blocks.push_back(std::move(*owned));
+    }
+    function->blocks = std::move(blocks);
+    return std::move(function);
+}
+
+void IRLowering::start_block(BasicBlock *block) {
+    current = block;
+    layout.push_back(block);
+}
+
+void IRLowering::seal_block(BasicBlock *block) {
+    for (auto [slot, phi] : incomplete_phis[block]) {
+        pending_phis.erase(phi);
+        add_phi_operands(slot, phi);
+    }
+    incomplete_phis.erase(block);
+    sealed.insert(block);
+}
+
+void IRLowering::start_unreachable_block() {
+    // Code after a return, break or continue is still lowered, the block it is in is removed later on
+    BasicBlock *block = function->create_block();
+    start_block(block);
+    seal_block(block);
+}
+
+void IRLowering::write_variable(std::size_t slot, BasicBlock *block, IRInstruction *value) {
+    definitions[block][slot] = resolve(value);
+}
+
+IRInstruction *IRLowering::read_variable(std::size_t slot, BasicBlock *block, Type type, std::size_t line) {
+    if (auto &defined = definitions[block]; defined.count(slot)) {
+        return resolve(defined[slot]);
+    }
+    return read_variable_recursive(slot, block, type, line);
+}
+
+IRInstruction *IRLowering::read_variable_recursive(std::size_t slot, BasicBlock *block, Type type, std::size_t line) {
+    IRInstruction *value{};
+    if (not sealed.count(block)) {
+        // Not all predecessors of the block are known yet, so its operands are added when the block is sealed
+        value = function->prepend_phi(block, type, line);
+        incomplete_phis[block].emplace_back(slot, value);
+        pending_phis.insert(value);
+    } else if (block->predecessors.empty()) {
+        // The variable is read in unreachable code
+        value = zero(type, line);
+    } else if (block->predecessors.size() == 1) {
+        value = read_variable(slot, block->predecessors[0], type, line);
+    } else {
+        // Breaks cycles by defining the variable in this block before looking at the predecessors
+        IRInstruction *phi = function->prepend_phi(block, type, line);
+        pending_phis.insert(phi);
+        write_variable(slot, block, phi);
+        value = add_phi_operands(slot, phi);
+    }
+    write_variable(slot, block, value);
+    return resolve(value);
+}
+
+IRInstruction *IRLowering::add_phi_operands(std::size_t slot, IRInstruction *phi) {
+    for (BasicBlock *predecessor : phi->block->predecessors) {
+        phi->operands.push_back(read_variable(slot, predecessor, phi->type, phi->line));
+    }
+    pending_phis.erase(phi);
+    return remove_trivial_phi(phi);
+}
+
+IRInstruction *IRLowering::remove_trivial_phi(IRInstruction *phi) {
+    IRInstruction *same = nullptr;
+    for (IRInstruction *operand : phi->operands) {
+        if (operand == same || operand == phi) {
+            continue;
+        }
+        if (same != nullptr) {
+            return phi; // The PHI merges at least two different values
+        }
+        same = operand;
+    }
+    if (same == nullptr) {
+        same = zero(phi->type, phi->line); // Only reachable from itself, or not reachable at all
+    }
+
+    std::vector<IRInstruction *> users{};
+    for (auto &block : function->blocks) {
+        for (auto &instruction : block->instructions) {
+            if (instruction->opcode == IROpcode::PHI && instruction.get() != phi &&
+                not pending_phis.count(instruction.get()) && not replaced_phis.count(instruction.get()) &&
+                std::find(instruction->operands.begin(), instruction->operands.end(), phi) !=
+                    instruction->operands.end()) {
+                users.push_back(instruction.get());
+            }
+        }
+    }
+
+    function->replace_uses(phi, same);
+    for (auto &[block, defined] : definitions) {
+        for (auto &[slot, value] : defined) {
+            if (value == phi) {
+                value = same;
+            }
+        }
+    }
+    phi->operands.clear();
+    replaced_phis[phi] = same;
+
+    for (IRInstruction *user : users) {
+        if (not replaced_phis.count(user)) {
+            remove_trivial_phi(user);
+        }
+    }
+    return resolve(same);
+}
+
+IRInstruction *IRLowering::resolve(IRInstruction *value) const {
+    for (auto replaced = replaced_phis.find(value); replaced != replaced_phis.end();
+         replaced = replaced_phis.find(value)) {
+        value = replaced->second;
+    }
+    return value;
+}
+
+IRInstruction *IRLowering::zero(Type type, std::size_t line) {
+    // Placed in the entry block so that it is available everywhere
+    BasicBlock *entry = function->blocks.front().get();
+    switch (type) {
+        case Type::FLOAT: return function->constant(entry, LiteralValue{0.0}, type, line);
+        case Type::BOOL: return function->constant(entry, LiteralValue{false}, type, line);
+        default: return function->constant(entry, LiteralValue{0}, Type::INT, line);
+    }
+}
+
+IRInstruction *IRLowering::emit(IROpcode opcode, Type type, std::vector<IRInstruction *> operands, std::size_t line) {
+    for (IRInstruction *&operand : operands) {
+        operand = resolve(operand);
+    }
+    return function->append(current, opcode, type, std::move(operands), line);
+}
+
+IRInstruction *IRLowering::convert(IRInstruction *value, NumericConversionType conversion, std::size_t line) {
+    switch (conversion) {
+        case NumericConversionType::FLOAT_TO_INT: return emit(IROpcode::FLOAT_TO_INT, Type::INT, {value}, line);
+        case NumericConversionType::INT_TO_FLOAT: return emit(IROpcode::INT_TO_FLOAT, Type::FLOAT, {value}, line);
+        default: return value;
+    }
+}
+
+IRInstruction *IRLowering::join(BasicBlock *block,
+    const std::vector<std::pair<BasicBlock *, IRInstruction *>> &incoming, Type type, std::size_t line) {
+    IRInstruction *phi = function->prepend_phi(block, type, line);
+    for (BasicBlock *predecessor : block->predecessors) {
+        auto value = std::find_if(incoming.begin(), incoming.end(),
+            [predecessor](const auto &edge) { return edge.first == predecessor; });
+        phi->operands.push_back(resolve(value->second));
+    }
+    return remove_trivial_phi(phi);
+}
+
+void IRLowering::branch(IRInstruction *condition, BasicBlock *if_true, BasicBlock *if_false, std::size_t line) {
+    function->branch(current, resolve(condition), if_true, if_false, line);
+}
+
+void IRLowering::lower(Stmt *stmt) {
+    switch (stmt->type_tag()) {
+        case NodeType::BlockStmt: {
+            std::size_t first_slot = next_slot;
+            for (auto &inner : dynamic_cast<BlockStmt *>(stmt)->stmts) {
+                lower(inner.get());
+            }
+            next_slot = first_slot;
+            break;
+        }
+        case NodeType::BreakStmt:
+            function->jump(current, loops.back().break_target, dynamic_cast<BreakStmt *>(stmt)->keyword.line);
+            start_unreachable_block();
+            break;
+        case NodeType::ContinueStmt:
+            function->jump(current, loops.back().continue_target, dynamic_cast<ContinueStmt *>(stmt)->keyword.line);
+            start_unreachable_block();
+            break;
+        case NodeType::ExpressionStmt:
+            static_cast<void>(lower(dynamic_cast<ExpressionStmt *>(stmt)->expr.get()));
+            break;
+        case NodeType::IfStmt: {
+            auto *if_stmt = dynamic_cast<IfStmt *>(stmt);
+            BasicBlock *then_block = function->create_block();
+            BasicBlock *else_block = if_stmt->elseBranch != nullptr ? function->create_block() : nullptr;
+            BasicBlock *merge_block = function->create_block();
+
+            lower_condition(if_stmt->condition.get(), then_block, else_block != nullptr ? else_block : merge_block);
+            start_block(then_block);
+            seal_block(then_block);
+            lower(if_stmt->thenBranch.get());
+            function->jump(current, merge_block, if_stmt->keyword.line);
+
+            if (else_block != nullptr) {
+                start_block(else_block);
+                seal_block(else_block);
+                lower(if_stmt->elseBranch.get());
+                function->jump(current, merge_block, if_stmt->keyword.line);
+            }
+            start_block(merge_block);
+            seal_block(merge_block);
+            break;
+        }
+        case NodeType::ReturnStmt: {
+            auto *return_stmt = dynamic_cast<ReturnStmt *>(stmt);
+            // Like the generator, the returned value is not converted to the return type of the function
+            IRInstruction *value = return_stmt->value != nullptr ? resolve(lower(return_stmt->value.get())) : nullptr;
+            current->terminator = IRTerminator::RETURN;
+            current->value = value;
+            current->line = return_stmt->keyword.line;
+            start_unreachable_block();
+            break;
+        }
+        case NodeType::VarStmt: {
+            auto *var = dynamic_cast<VarStmt *>(stmt);
+            IRInstruction *value = convert(lower(var->initializer.get()), var->conversion_type, var->name.line);
+            write_variable(next_slot++, current, value);
+            break;
+        }
+        case NodeType::WhileStmt: {
+            /*
+             * The loop is laid out the same way as the generator lays out loops, with the condition at the bottom:
+             *
+             *     jump condition
+             * body:
+             *     ...
+             * increment:             <- continue jumps here
+             *     ...
+             * condition:
+             *     branch body, exit  <- POP_JUMP_BACK_IF_TRUE
+             * exit:                  <- break jumps here
+             *
+             * The condition has to be lowered before the body though, so that the body knows its predecessor, and
+             * is moved to its place afterwards
+             */
+            auto *loop = dynamic_cast<WhileStmt *>(stmt);
+            BasicBlock *condition = function->create_block();
+            BasicBlock *body = function->create_block();
+            BasicBlock *increment = function->create_block();
+            BasicBlock *exit = function->create_block();
+
+            function->jump(current, condition, loop->keyword.line);
+            std::size_t condition_begin = layout.size();
+            start_block(condition);
+            lower_condition(loop->condition.get(), body, exit);
+            std::size_t condition_end = layout.size();
+
+            start_block(body);
+            seal_block(body);
+            loops.push_back({exit, increment});
+            lower(loop->body.get());
+            loops.pop_back();
+            function->jump(current, increment, loop->keyword.line);
+
+            start_block(increment);
+            seal_block(increment);
+            if (loop->increment != nullptr) {
+                lower(loop->increment.get());
+            }
+            function->jump(current, condition, loop->keyword.line);
+            seal_block(condition);
+
+            std::rotate(layout.begin() + condition_begin, layout.begin() + condition_end, layout.end());
+            start_block(exit);
+            seal_block(exit);
+            break;
+        }
+        default: failed = true; break;
+    }
+}
+
+IRInstruction *IRLowering::lower(Expr *expr) {
+    std::size_t line = expr->resolved.token.line;
+    switch (expr->type_tag()) {
+        case NodeType::AssignExpr: {
+            auto *assign = dynamic_cast<AssignExpr *>(expr);
+            Type type = assign->resolved.info->primitive;
+            if (inlined_args != nullptr || assign->resolved.stack_slot >= next_slot) {
+                failed = true;
+                return zero(type, line);
+            }
+
+            IROpcode opcode{};
+            switch (assign->resolved.token.type) {
+                case TokenType::PLUS_EQUAL: opcode = IROpcode::ADD; break;
+                case TokenType::MINUS_EQUAL: opcode = IROpcode::SUB; break;
+                case TokenType::STAR_EQUAL: opcode = IROpcode::MUL; break;
+                case TokenType::SLASH_EQUAL: opcode = IROpcode::DIV; break;
+                default: {
+                    IRInstruction *value = convert(lower(assign->value.get()), assign->conversion_type, line);
+                    write_variable(assign->resolved.stack_slot, current, value);
+                    return value;
+                }
+            }
+            IRInstruction *target = read_variable(assign->resolved.stack_slot, current, type, line);
+            IRInstruction *value = convert(lower(assign->value.get()), assign->conversion_type, line);
+            IRInstruction *result = emit(opcode, type == Type::FLOAT ? Type::FLOAT : Type::INT, {target, value}, line);
+            write_variable(assign->resolved.stack_slot, current, result);
+            return result;
+        }
+        case NodeType::BinaryExpr: {
+            auto *binary = dynamic_cast<BinaryExpr *>(expr);
+            Type left_type = binary->left->resolved.info->primitive;
+            Type right_type = binary->right->resolved.info->primitive;
+            bool requires_floating = left_type == Type::FLOAT || right_type == Type::FLOAT;
+
+            IRInstruction *left = lower(binary->left.get());
+            if (left_type == Type::INT && right_type == Type::FLOAT) {
+                left = emit(IROpcode::INT_TO_FLOAT, Type::FLOAT, {left}, line);
+            }
+            IRInstruction *right = lower(binary->right.get());
+            if (left_type == Type::FLOAT && right_type == Type::INT) {
+                right = emit(IROpcode::INT_TO_FLOAT, Type::FLOAT, {right}, line);
+            }
+
+            Type arithmetic = requires_floating ? Type::FLOAT : Type::INT;
+            switch (binary->resolved.token.type) {
+                case TokenType::PLUS: return emit(IROpcode::ADD, arithmetic, {left, right}, line);
+                case TokenType::MINUS: return emit(IROpcode::SUB, arithmetic, {left, right}, line);
+                case TokenType::STAR: return emit(IROpcode::MUL, arithmetic, {left, right}, line);
+                case TokenType::SLASH: return emit(IROpcode::DIV, arithmetic, {left, right}, line);
+                case TokenType::MODULO: return emit(IROpcode::MOD, arithmetic, {left, right}, line);
+                case TokenType::LEFT_SHIFT: return emit(IROpcode::SHIFT_LEFT, Type::INT, {left, right}, line);
+                case TokenType::RIGHT_SHIFT: return emit(IROpcode::SHIFT_RIGHT, Type::INT, {left, right}, line);
+                case TokenType::BIT_AND: return emit(IROpcode::BIT_AND, Type::INT, {left, right}, line);
+                case TokenType::BIT_OR: return emit(IROpcode::BIT_OR, Type::INT, {left, right}, line);
+                case TokenType::BIT_XOR: return emit(IROpcode::BIT_XOR, Type::INT, {left, right}, line);
+                case TokenType::EQUAL_EQUAL: return emit(IROpcode::EQUAL, Type::BOOL, {left, right}, line);
+                case TokenType::NOT_EQUAL: return emit(IROpcode::NOT_EQUAL, Type::BOOL, {left, right}, line);
+                case TokenType::LESS: return emit(IROpcode::LESS, Type::BOOL, {left, right}, line);
+                case TokenType::LESS_EQUAL: return emit(IROpcode::LESS_EQUAL, Type::BOOL, {left, right}, line);
+                case TokenType::GREATER: return emit(IROpcode::GREATER, Type::BOOL, {left, right}, line);
+                case TokenType::GREATER_EQUAL: return emit(IROpcode::GREATER_EQUAL, Type::BOOL, {left, right}, line);
+                default: failed = true; return left;
+            }
+        }
+        case NodeType::CallExpr: return lower_call(*dynamic_cast<CallExpr *>(expr));
+        case NodeType::GroupingExpr: return lower(dynamic_cast<GroupingExpr *>(expr)->expr.get());
+        case NodeType::LiteralExpr: {
+            auto *literal = dynamic_cast<LiteralExpr *>(expr);
+            Type type = literal->value.is_int() ? Type::INT : (literal->value.is_double() ? Type::FLOAT : Type::BOOL);
+            return function->constant(current, literal->value, type, line);
+        }
+        case NodeType::LogicalExpr: {
+            // `a and b` is `a ? b : a` and `a or b` is `a ? a : b`
+            auto *logical = dynamic_cast<LogicalExpr *>(expr);
+            IRInstruction *left = lower(logical->left.get());
+            BasicBlock *left_end = current;
+            BasicBlock *right_block = function->create_block();
+            BasicBlock *merge_block = function->create_block();
+            if (logical->resolved.token.type == TokenType::OR) {
+                branch(left, merge_block, right_block, line);
+            } else {
+                branch(left, right_block, merge_block, line);
+            }
+
+            start_block(right_block);
+            seal_block(right_block);
+            IRInstruction *right = lower(logical->right.get());
+            BasicBlock *right_end = current;
+            function->jump(current, merge_block, line);
+
+            start_block(merge_block);
+            seal_block(merge_block);
+            return join(merge_block, {{left_end, left}, {right_end, right}}, Type::BOOL, line);
+        }
+        case NodeType::TernaryExpr: {
+            auto *ternary = dynamic_cast<TernaryExpr *>(expr);
+            BasicBlock *then_block = function->create_block();
+            BasicBlock *else_block = function->create_block();
+            BasicBlock *merge_block = function->create_block();
+            lower_condition(ternary->left.get(), then_block, else_block);
+
+            start_block(then_block);
+            seal_block(then_block);
+            IRInstruction *then_value = lower(ternary->middle.get());
+            BasicBlock *then_end = current;
+            function->jump(current, merge_block, line);
+
+            start_block(else_block);
+            seal_block(else_block);
+            IRInstruction *else_value = lower(ternary->right.get());
+            BasicBlock *else_end = current;
+            function->jump(current, merge_block, line);
+
+            start_block(merge_block);
+            seal_block(merge_block);
+            return join(merge_block, {{then_end, then_value}, {else_end, else_value}},
+                ternary->resolved.info->primitive, line);
+        }
+        case NodeType::UnaryExpr: {
+            auto *unary = dynamic_cast<UnaryExpr *>(expr);
+            line = unary->oper.line;
+            Type type = unary->right->resolved.info->primitive;
+            switch (unary->oper.type) {
+                case TokenType::MINUS: return emit(IROpcode::NEG, type, {lower(unary->right.get())}, line);
+                case TokenType::NOT: return emit(IROpcode::NOT, Type::BOOL, {lower(unary->right.get())}, line);
+                case TokenType::BIT_NOT: return emit(IROpcode::BIT_NOT, Type::INT, {lower(unary->right.get())}, line);
+                default: break;
+            }
+
+            std::size_t slot = unary->right->resolved.stack_slot;
+            if (inlined_args != nullptr || slot >= next_slot) {
+                failed = true;
+                return zero(type, line);
+            }
+            IRInstruction *one = type == Type::FLOAT ? function->constant(current, LiteralValue{1.0}, type, line)
+                                                     : function->constant(current, LiteralValue{1}, type, line);
+            IRInstruction *result =
+                emit(unary->oper.type == TokenType::PLUS_PLUS ? IROpcode::ADD : IROpcode::SUB, type,
+                    {read_variable(slot, current, type, line), one}, line);
+            write_variable(slot, current, result);
+            return result;
+        }
+        case NodeType::VariableExpr: {
+            auto *variable = dynamic_cast<VariableExpr *>(expr);
+            std::size_t slot = variable->resolved.stack_slot;
+            if (inlined_args != nullptr) {
+                // Only parameters can be used in the body of an inlined function
+                return (*inlined_args)[slot];
+            } else if (slot >= next_slot) {
+                failed = true;
+                return zero(variable->resolved.info->primitive, line);
+            }
+            return read_variable(slot, current, variable->resolved.info->primitive, line);
+        }
+        default: failed = true; return zero(Type::INT, line);
+    }
+}
+
+void IRLowering::lower_condition(Expr *condition, BasicBlock *if_true, BasicBlock *if_false) {
+    // Conditions are lowered straight into branches, so that `and`, `or` and `not` do not need to produce a value
+    while (condition->type_tag() == NodeType::GroupingExpr) {
+        condition = dynamic_cast<GroupingExpr *>(condition)->expr.get();
+    }
+
+    if (condition->type_tag() == NodeType::LogicalExpr) {
+        auto *logical = dynamic_cast<LogicalExpr *>(condition);
+        BasicBlock *right_block = function->create_block();
+        if (logical->resolved.token.type == TokenType::OR) {
+            lower_condition(logical->left.get(), if_true, right_block);
+        } else {
+            lower_condition(logical->left.get(), right_block, if_false);
+        }
+        start_block(right_block);
+        seal_block(right_block);
+        lower_condition(logical->right.get(), if_true, if_false);
+    } else if (auto *unary = dynamic_cast<UnaryExpr *>(condition);
+               unary != nullptr && unary->oper.type == TokenType::NOT) {
+        lower_condition(unary->right.get(), if_false, if_true);
+    } else {
+        branch(lower(condition), if_true, if_false, condition->resolved.token.line);
+    }
+}
+
+IRInstruction *IRLowering::lower_call(CallExpr &expr) {
+    std::size_t line = expr.resolved.token.line;
+    std::vector<IRInstruction *> args{};
+    for (auto &[value, conversion, requires_copy] : expr.args) {
+        args.push_back(convert(lower(value.get()), conversion, value->resolved.token.line));
+    }
+
+    auto *called = dynamic_cast<VariableExpr *>(expr.function.get());
+    if (expr.is_native_call) {
+        IRInstruction *call = emit(IROpcode::CALL_NATIVE, expr.resolved.info->primitive, std::move(args), line);
+        call->callee = called->name.lexeme;
+        return call;
+    }
+
+    FunctionStmt *function_stmt = called->resolved.func;
+    if (inliner != nullptr) {
+        // Unlike in the generator, the arguments have already been evaluated once, so they can be used any number of
+        // times in the body
+        if (const Inliner::Candidate *candidate = inliner->candidate_for(function_stmt);
+            candidate != nullptr && can_lower(candidate->body)) {
+            inliner->record(function_stmt->name.lexeme, module_name, line);
+            inlined_args = &args;
+            IRInstruction *result = lower(candidate->body);
+            inlined_args = nullptr;
+            return result;
+        }
+    }
+
+    IRInstruction *call = emit(IROpcode::CALL, function_stmt->return_type->primitive, std::move(args), line);
+    call->callee = function_stmt->name.lexeme;
+    return call;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+
+#ifndef LOWERING_HPP
+#define LOWERING_HPP
+
+#include "../AST.hpp"
+#include "../Optimizer/Inliner.hpp"
+#include "IR.hpp"
+
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Lowers the body of a function from the AST into the IR, building SSA form directly while doing so (using the
+// algorithm from "Simple and Efficient Construction of Static Single Assignment Form" by Braun et al.). Only functions
+// whose parameters, locals and return value are all ints, floats or bools can be lowered for now, and they can only
+// use the statements and operators that work on those. Everything else is still compiled straight from the AST.
+class IRLowering {
+    struct Loop {
+        BasicBlock *break_target{};
+        BasicBlock *continue_target{};
+    };
+
+    std::unique_ptr<IRFunction> function{};
+    BasicBlock *current{nullptr};
+    std::vector<BasicBlock *> layout{}; // The blocks in the order in which they should be laid out
+    bool failed{false};
+
+    // The value of each local variable (identified by its stack slot) at the end of each block
+    std::unordered_map<BasicBlock *, std::unordered_map<std::size_t, IRInstruction *>> definitions{};
+    std::unordered_map<BasicBlock *, std::vector<std::pair<std::size_t, IRInstruction *>>> incomplete_phis{};
+    std::unordered_set<BasicBlock *> sealed{};
+    std::unordered_set<IRInstruction *> pending_phis{}; // PHIs whose operands have not all been added yet
+    std::unordered_map<IRInstruction *, IRInstruction *> replaced_phis{};
+    std::size_t next_slot{};
+
+    std::vector<Loop> loops{};
+    const std::vector<IRInstruction *> *inlined_args{nullptr}; // The arguments of the call whose body is being lowered
+
+    Inliner *inliner{nullptr};
+    std::string_view module_name{};
+
+    [[nodiscard]] static bool is_value_type(const BaseType *type) noexcept;
+    [[nodiscard]] static bool can_lower(Stmt *stmt);
+    [[nodiscard]] static bool can_lower(Expr *expr);
+    [[nodiscard]] static bool can_call(FunctionStmt *function);
+
+    void start_block(BasicBlock *block);
+    void seal_block(BasicBlock *block);
+    void start_unreachable_block();
+
+    void write_variable(std::size_t slot, BasicBlock *block, IRInstruction *value);
+    [[nodiscard]] IRInstruction *read_variable(std::size_t slot, BasicBlock *block, Type type, std::size_t line);
+    [[nodiscard]] IRInstruction *read_variable_recursive(
+        std::size_t slot, BasicBlock *block, Type type, std::size_t line);
+    IRInstruction *add_phi_operands(std::size_t slot, IRInstruction *phi);
+    IRInstruction *remove_trivial_phi(IRInstruction *phi);
+    [[nodiscard]] IRInstruction *resolve(IRInstruction *value) const;
+    [[nodiscard]] IRInstruction *zero(Type type, std::size_t line);
+
+    [[nodiscard]] IRInstruction *emit(IROpcode opcode, Type type, std::vector<IRInstruction *> operands,
+        std::size_t line);
+    [[nodiscard]] IRInstruction *convert(IRInstruction *value, NumericConversionType conversion, std::size_t line);
+    [[nodiscard]] IRInstruction *join(
+        BasicBlock *block, const std::vector<std::pair<BasicBlock *, IRInstruction *>> &incoming, Type type,
+        std::size_t line);
+    void branch(IRInstruction *condition, BasicBlock *if_true, BasicBlock *if_false, std::size_t line);
+
+    void lower(Stmt *stmt);
+    [[nodiscard]] IRInstruction *lower(Expr *expr);
+    void lower_condition(Expr *condition, BasicBlock *if_true, BasicBlock *if_false);
+    [[nodiscard]] IRInstruction *lower_call(CallExpr &expr);
+
+  public:
+    IRLowering(Inliner *inliner, std::string_view module_name);
+
+    // Whether the function only uses what can be lowered into the IR
+    [[nodiscard]] static bool can_lower(FunctionStmt &function);
+    // Returns nullptr if the function could not be lowered after all
+    [[nodiscard]] std::unique_ptr<IRFunction> lower(FunctionStmt &stmt);
+};
+
+#endif
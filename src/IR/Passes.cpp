@@ -0,0 +1,530 @@
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+#include "Passes.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_set>
+
+namespace {
+constexpr long long int_min = std::numeric_limits<std::int32_t>::min();
+constexpr long long int_max = std::numeric_limits<std::int32_t>::max();
+
+bool fits_in_int(long long value) noexcept {
+    return value >= int_min && value <= int_max;
+}
+
+void make_constant(IRInstruction &instruction, LiteralValue value, Type type) {
+    instruction.opcode = IROpcode::CONSTANT;
+    instruction.operands.clear();
+    instruction.constant = std::move(value);
+    instruction.type = type;
+}
+
+// Whether `value` is a numeric constant equal to `expected`. A constant of -0.0 is not considered to be equal to 0
+bool is_constant_equal(const IRInstruction *value, double expected) noexcept {
+    return value->is_constant() && value->constant.is_numeric() && value->constant.to_numeric() == expected &&
+           (expected != 0 || not std::signbit(value->constant.to_numeric()));
+}
+
+// The exponent of `value` if it is an integral constant that is a power of two larger than one, or 0 otherwise
+int power_of_two(const IRInstruction *value) noexcept {
+    if (not value->is_constant() || not value->constant.is_int()) {
+        return 0;
+    }
+    int constant = std::get<LiteralValue::tag::INT>(value->constant.value);
+    if (constant <= 1 || (constant & (constant - 1)) != 0) {
+        return 0;
+    }
+    int exponent = 0;
+    while ((constant >>= 1) != 0) {
+        exponent++;
+    }
+    return exponent;
+}
+
+void remove_instructions(BasicBlock &block, const std::unordered_set<IRInstruction *> &removed) {
+    auto &instructions = block.instructions;
+    instructions.erase(std::remove_if(instructions.begin(), instructions.end(),
+                           [&removed](const auto &instruction) { return removed.count(instruction.get()); }),
+        instructions.end());
+}
+} // namespace
+
+void PassManager::add(std::unique_ptr<IRPass> pass) {
+    passes.push_back(std::move(pass));
+}
+
+void PassManager::run(IRFunction &function) {
+    for (std::size_t round = 0; round < max_rounds; round++) {
+        bool changed = false;
+        for (auto &pass : passes) {
+            changed = pass->run(function) || changed;
+        }
+        if (not changed) {
+            break;
+        }
+    }
+}
+
+std::string_view UnreachableBlocks::name() const noexcept {
+    return "unreachable-blocks";
+}
+
+bool UnreachableBlocks::run(IRFunction &function) {
+    std::unordered_set<BasicBlock *> reachable{};
+    std::vector<BasicBlock *> worklist{function.blocks.front().get()};
+    while (not worklist.empty()) {
+        BasicBlock *block = worklist.back();
+        worklist.pop_back();
+        if (not reachable.insert(block).second) {
+            continue;
+        }
+        for (std::size_t i = 0; i < block->successor_count(); i++) {
+            worklist.push_back(block->successors[i]);
+        }
+    }
+
+    if (reachable.size() == function.blocks.size()) {
+        return false;
+    }
+    for (auto &block : function.blocks) {
+        if (not reachable.count(block.get())) {
+            for (std::size_t i = 0; i < block->successor_count(); i++) {
+                function.remove_edge(block.get(), block->successors[i]);
+            }
+        }
+    }
+    function.blocks.erase(std::remove_if(function.blocks.begin(), function.blocks.end(),
+                              [&reachable](const auto &block) { return not reachable.count(block.get()); }),
+        function.blocks.end());
+    return true;
+}
+
+std::string_view MergeBlocks::name() const noexcept {
+    return "merge-blocks";
+}
+
+bool MergeBlocks::run(IRFunction &function) {
+    bool changed = false;
+    for (std::size_t i = 0; i < function.blocks.size(); i++) {
+        BasicBlock *block = function.blocks[i].get();
+        BasicBlock *next = block->successors[0];
+        if (block->terminator != IRTerminator::JUMP || next == block || next == function.blocks.front().get() ||
+            next->predecessors.size() != 1) {
+            continue;
+        }
+
+        for (auto &instruction : next->instructions) {
+            if (instruction->opcode == IROpcode::PHI) {
+                function.replace_uses(instruction.get(), instruction->operands[0]);
+            } else {
+                instruction->block = block;
+                block->instructions.push_back(std::move(instruction));
+            }
+        }
+        block->terminator = next->terminator;
+        block->value = next->value;
+        block->successors = next->successors;
+        block->line = next->line;
+        for (std::size_t j = 0; j < block->successor_count(); j++) {
+            auto &predecessors = block->successors[j]->predecessors;
+            std::replace(predecessors.begin(), predecessors.end(), next, block);
+        }
+
+        function.blocks.erase(std::find_if(function.blocks.begin(), function.blocks.end(),
+            [next](const auto &other) { return other.get() == next; }));
+        changed = true;
+        i = static_cast<std::size_t>(-1); // Indices after the erased block have shifted, so start again
+    }
+    return changed;
+}
+
+std::string_view ConstantPropagation::name() const noexcept {
+    return "constant-propagation";
+}
+
+bool ConstantPropagation::run(IRFunction &function) {
+    bool changed = false;
+    for (auto &block : function.blocks) {
+        std::unordered_set<IRInstruction *> removed{};
+        for (auto &instruction : block->instructions) {
+            if (instruction->opcode != IROpcode::PHI) {
+                changed = fold(*instruction) || changed;
+                continue;
+            }
+
+            IRInstruction *same = nullptr;
+            bool is_trivial = true;
+            for (IRInstruction *operand : instruction->operands) {
+                if (operand != instruction.get() && operand != same) {
+                    is_trivial = same == nullptr;
+                    same = operand;
+                }
+            }
+            if (is_trivial && same != nullptr) {
+                function.replace_uses(instruction.get(), same);
+                removed.insert(instruction.get());
+                changed = true;
+            }
+        }
+        remove_instructions(*block, removed);
+
+        if (block->terminator == IRTerminator::BRANCH && block->value->is_constant() &&
+            block->successors[0] != block->successors[1]) {
+            const LiteralValue &condition = block->value->constant;
+            bool taken = condition.is_bool() ? std::get<LiteralValue::tag::BOOL>(condition.value)
+                                             : condition.to_numeric() != 0;
+            BasicBlock *target = block->successors[taken ? 0 : 1];
+            function.remove_edge(block.get(), block->successors[taken ? 1 : 0]);
+            block->terminator = IRTerminator::JUMP;
+            block->value = nullptr;
+            block->successors = {target, nullptr};
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+bool ConstantPropagation::fold(IRInstruction &instruction) {
+    if (instruction.operands.empty() ||
+        not std::all_of(instruction.operands.begin(), instruction.operands.end(),
+            [](IRInstruction *operand) { return operand->is_constant(); })) {
+        return false;
+    }
+
+    const LiteralValue &value = instruction.operands[0]->constant;
+    switch (instruction.opcode) {
+        case IROpcode::NEG:
+            if (value.is_int() && fits_in_int(-static_cast<long long>(std::get<LiteralValue::tag::INT>(value.value)))) {
+                make_constant(instruction, LiteralValue{-std::get<LiteralValue::tag::INT>(value.value)}, Type::INT);
+                return true;
+            } else if (value.is_double()) {
+                make_constant(
+                    instruction, LiteralValue{-std::get<LiteralValue::tag::DOUBLE>(value.value)}, Type::FLOAT);
+                return true;
+            }
+            return false;
+        case IROpcode::NOT:
+            if (value.is_bool()) {
+                make_constant(
+                    instruction, LiteralValue{not std::get<LiteralValue::tag::BOOL>(value.value)}, Type::BOOL);
+                return true;
+            }
+            return false;
+        case IROpcode::BIT_NOT:
+            if (value.is_int()) {
+                make_constant(instruction, LiteralValue{~std::get<LiteralValue::tag::INT>(value.value)}, Type::INT);
+                return true;
+            }
+            return false;
+        case IROpcode::INT_TO_FLOAT:
+            if (value.is_int()) {
+                make_constant(instruction,
+                    LiteralValue{static_cast<double>(std::get<LiteralValue::tag::INT>(value.value))}, Type::FLOAT);
+                return true;
+            }
+            return false;
+        case IROpcode::FLOAT_TO_INT:
+            // Converting a value that does not fit in an int is undefined
+            if (double converted = value.is_double() ? std::get<LiteralValue::tag::DOUBLE>(value.value) : NAN;
+                converted > static_cast<double>(int_min) - 1.0 && converted < static_cast<double>(int_max) + 1.0) {
+                make_constant(instruction, LiteralValue{static_cast<int>(converted)}, Type::INT);
+                return true;
+            }
+            return false;
+        case IROpcode::CALL:
+        case IROpcode::CALL_NATIVE: return false;
+        default: break;
+    }
+
+    if (instruction.operands.size() != 2) {
+        return false;
+    }
+    const LiteralValue &other = instruction.operands[1]->constant;
+    if (value.is_int() && other.is_int()) {
+        return fold_integral(
+            instruction, std::get<LiteralValue::tag::INT>(value.value), std::get<LiteralValue::tag::INT>(other.value));
+    } else if (value.is_double() && other.is_double()) {
+        return fold_floating(instruction, std::get<LiteralValue::tag::DOUBLE>(value.value),
+            std::get<LiteralValue::tag::DOUBLE>(other.value));
+    } else if (value.is_bool() && other.is_bool() &&
+               (instruction.opcode == IROpcode::EQUAL || instruction.opcode == IROpcode::NOT_EQUAL)) {
+        bool equal = std::get<LiteralValue::tag::BOOL>(value.value) == std::get<LiteralValue::tag::BOOL>(other.value);
+        make_constant(instruction, LiteralValue{instruction.opcode == IROpcode::EQUAL ? equal : not equal}, Type::BOOL);
+        return true;
+    }
+    return false;
+}
+
+bool ConstantPropagation::fold_integral(IRInstruction &instruction, long long left, long long right) {
+    long long result{};
+    switch (instruction.opcode) {
+        case IROpcode::ADD: result = left + right; break;
+        case IROpcode::SUB: result = left - right; break;
+        case IROpcode::MUL: result = left * right; break;
+        case IROpcode::DIV:
+        case IROpcode::MOD:
+            if (right == 0 || (left == int_min && right == -1)) {
+                return false;
+            }
+            result = instruction.opcode == IROpcode::DIV ? left / right : left % right;
+            break;
+        case IROpcode::SHIFT_LEFT:
+            if (left < 0 || right < 0 || right >= 32) {
+                return false;
+            }
+            result = left << right;
+            break;
+        case IROpcode::SHIFT_RIGHT:
+            if (right < 0 || right >= 32) {
+                return false;
+            }
+            result = static_cast<std::int32_t>(left) >> right;
+            break;
+        case IROpcode::BIT_AND: result = left & right; break;
+        case IROpcode::BIT_OR: result = left | right; break;
+        case IROpcode::BIT_XOR: result = left ^ right; break;
+
+        case IROpcode::EQUAL: make_constant(instruction, LiteralValue{left == right}, Type::BOOL); return true;
+        case IROpcode::NOT_EQUAL: make_constant(instruction, LiteralValue{left != right}, Type::BOOL); return true;
+        case IROpcode::LESS: make_constant(instruction, LiteralValue{left < right}, Type::BOOL); return true;
+        case IROpcode::LESS_EQUAL: make_constant(instruction, LiteralValue{left <= right}, Type::BOOL); return true;
+        case IROpcode::GREATER: make_constant(instruction, LiteralValue{left > right}, Type::BOOL); return true;
+        case IROpcode::GREATER_EQUAL: make_constant(instruction, LiteralValue{left >= right}, Type::BOOL); return true;
+
+        default: return false;
+    }
+
+    if (not fits_in_int(result)) {
+        return false;
+    }
+    make_constant(instruction, LiteralValue{static_cast<int>(result)}, Type::INT);
+    return true;
+}
+
+bool ConstantPropagation::fold_floating(IRInstruction &instruction, double left, double right) {
+    switch (instruction.opcode) {
+        case IROpcode::ADD: make_constant(instruction, LiteralValue{left + right}, Type::FLOAT); return true;
+        case IROpcode::SUB: make_constant(instruction, LiteralValue{left - right}, Type::FLOAT); return true;
+        case IROpcode::MUL: make_constant(instruction, LiteralValue{left * right}, Type::FLOAT); return true;
+        case IROpcode::DIV:
+            if (right == 0.0) {
+                return false;
+            }
+            make_constant(instruction, LiteralValue{left / right}, Type::FLOAT);
+            return true;
+        case IROpcode::MOD:
+            if (right == 0.0) {
+                return false;
+            }
+            make_constant(instruction, LiteralValue{std::fmod(left, right)}, Type::FLOAT);
+            return true;
+
+        case IROpcode::EQUAL: make_constant(instruction, LiteralValue{left == right}, Type::BOOL); return true;
+        case IROpcode::NOT_EQUAL: make_constant(instruction, LiteralValue{not(left == right)}, Type::BOOL); return true;
+        case IROpcode::LESS: make_constant(instruction, LiteralValue{left < right}, Type::BOOL); return true;
+        case IROpcode::LESS_EQUAL: make_constant(instruction, LiteralValue{not(left > right)}, Type::BOOL); return true;
+        case IROpcode::GREATER: make_constant(instruction, LiteralValue{left > right}, Type::BOOL); return true;
+        case IROpcode::GREATER_EQUAL:
+            make_constant(instruction, LiteralValue{not(left < right)}, Type::BOOL);
+            return true;
+
+        default: return false;
+    }
+}
+
+std::string_view AlgebraicSimplification::name() const noexcept {
+    return "algebraic-simplification";
+}
+
+bool AlgebraicSimplification::run(IRFunction &function) {
+    find_non_negative(function);
+
+    bool changed = false;
+    for (auto &block : function.blocks) {
+        std::unordered_set<IRInstruction *> removed{};
+        // Rewriting an instruction can add constants to the end of the block
+        for (std::size_t i = 0; i < block->instructions.size(); i++) {
+            IRInstruction *instruction = block->instructions[i].get();
+            if (instruction->opcode != IROpcode::PHI && not instruction->is_constant()) {
+                changed = simplify(function, *instruction, removed) || changed;
+            }
+        }
+        remove_instructions(*block, removed);
+    }
+    return changed;
+}
+
+void AlgebraicSimplification::find_non_negative(const IRFunction &function) {
+    auto follows = [this](const IRInstruction &instruction) {
+        const auto &operands = instruction.operands;
+        switch (instruction.opcode) {
+            case IROpcode::CONSTANT:
+                return instruction.constant.is_int() &&
+                       std::get<LiteralValue::tag::INT>(instruction.constant.value) >= 0;
+            case IROpcode::PHI:
+                return std::all_of(operands.begin(), operands.end(),
+                    [this](const IRInstruction *operand) { return is_non_negative(operand); });
+            case IROpcode::BIT_AND: return is_non_negative(operands[0]) || is_non_negative(operands[1]);
+            case IROpcode::BIT_OR:
+            case IROpcode::BIT_XOR:
+            case IROpcode::DIV: return is_non_negative(operands[0]) && is_non_negative(operands[1]);
+            case IROpcode::MOD: // The result of modulo has the sign of the dividend
+            case IROpcode::SHIFT_RIGHT: return is_non_negative(operands[0]);
+            default: return false; // Anything else can be negative or overflow into a negative value
+        }
+    };
+
+    non_negative.clear();
+    for (auto &block : function.blocks) {
+        for (auto &instruction : block->instructions) {
+            if (instruction->type == Type::INT) {
+                non_negative.insert(instruction.get());
+            }
+        }
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto &block : function.blocks) {
+            for (auto &instruction : block->instructions) {
+                if (non_negative.count(instruction.get()) && not follows(*instruction)) {
+                    non_negative.erase(instruction.get());
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+bool AlgebraicSimplification::is_non_negative(const IRInstruction *value) const noexcept {
+    return non_negative.count(value);
+}
+
+bool AlgebraicSimplification::simplify(
+    IRFunction &function, IRInstruction &instruction, std::unordered_set<IRInstruction *> &removed) {
+    auto replace_with = [&function, &instruction, &removed](IRInstruction *value) {
+        function.replace_uses(&instruction, value);
+        removed.insert(&instruction);
+        return true;
+    };
+    auto rewrite = [&function, &instruction](IROpcode opcode, IRInstruction *value, int constant) {
+        instruction.opcode = opcode;
+        instruction.operands = {
+            value, function.constant(instruction.block, LiteralValue{constant}, Type::INT, instruction.line)};
+        return true;
+    };
+
+    if (instruction.opcode == IROpcode::NOT) {
+        // `not` can be applied to any primitive and always gives a bool, so only `not not` on a bool is the same value
+        IRInstruction *inner = instruction.operands[0];
+        if (inner->opcode == IROpcode::NOT && inner->operands[0]->type == Type::BOOL) {
+            return replace_with(inner->operands[0]);
+        }
+        return false;
+    } else if (instruction.operands.size() != 2) {
+        return false;
+    }
+
+    IRInstruction *left = instruction.operands[0];
+    IRInstruction *right = instruction.operands[1];
+    bool is_integral = instruction.type == Type::INT;
+    switch (instruction.opcode) {
+        case IROpcode::ADD:
+            // Only for ints, since -0.0 + 0.0 is 0.0
+            if (is_integral && is_constant_equal(right, 0)) {
+                return replace_with(left);
+            } else if (is_integral && is_constant_equal(left, 0)) {
+                return replace_with(right);
+            }
+            return false;
+        case IROpcode::SUB:
+        case IROpcode::SHIFT_LEFT:
+        case IROpcode::SHIFT_RIGHT: return is_constant_equal(right, 0) && replace_with(left);
+        case IROpcode::MUL:
+            if (is_constant_equal(right, 1)) {
+                return replace_with(left);
+            } else if (is_constant_equal(left, 1)) {
+                return replace_with(right);
+            } else if (int exponent = power_of_two(right); is_integral && exponent != 0 && is_non_negative(left)) {
+                return rewrite(IROpcode::SHIFT_LEFT, left, exponent);
+            } else if (int exponent = power_of_two(left); is_integral && exponent != 0 && is_non_negative(right)) {
+                return rewrite(IROpcode::SHIFT_LEFT, right, exponent);
+            }
+            return false;
+        case IROpcode::DIV:
+            if (is_constant_equal(right, 1)) {
+                return replace_with(left);
+            } else if (int exponent = power_of_two(right); is_integral && exponent != 0 && is_non_negative(left)) {
+                return rewrite(IROpcode::SHIFT_RIGHT, left, exponent);
+            }
+            return false;
+        case IROpcode::MOD:
+            if (is_integral && is_constant_equal(right, 1)) {
+                make_constant(instruction, LiteralValue{0}, Type::INT);
+                return true;
+            } else if (int exponent = power_of_two(right); is_integral && exponent != 0 && is_non_negative(left)) {
+                return rewrite(IROpcode::BIT_AND, left, (1 << exponent) - 1);
+            }
+            return false;
+        case IROpcode::BIT_AND:
+            if (is_constant_equal(right, -1)) {
+                return replace_with(left);
+            } else if (is_constant_equal(left, -1)) {
+                return replace_with(right);
+            }
+            return false;
+        case IROpcode::BIT_OR:
+        case IROpcode::BIT_XOR:
+            if (is_constant_equal(right, 0)) {
+                return replace_with(left);
+            } else if (is_constant_equal(left, 0)) {
+                return replace_with(right);
+            }
+            return false;
+        default: return false;
+    }
+}
+
+std::string_view DeadValues::name() const noexcept {
+    return "dead-values";
+}
+
+bool DeadValues::run(IRFunction &function) {
+    std::unordered_set<IRInstruction *> live{};
+    std::vector<IRInstruction *> worklist{};
+    for (auto &block : function.blocks) {
+        for (auto &instruction : block->instructions) {
+            if (instruction->has_side_effects()) {
+                worklist.push_back(instruction.get());
+            }
+        }
+        if (block->value != nullptr) {
+            worklist.push_back(block->value);
+        }
+    }
+    while (not worklist.empty()) {
+        IRInstruction *instruction = worklist.back();
+        worklist.pop_back();
+        if (live.insert(instruction).second) {
+            worklist.insert(worklist.end(), instruction->operands.begin(), instruction->operands.end());
+        }
+    }
+
+    bool changed = false;
+    for (auto &block : function.blocks) {
+        std::unordered_set<IRInstruction *> removed{};
+        for (auto &instruction : block->instructions) {
+            if (not live.count(instruction.get())) {
+                removed.insert(instruction.get());
+            }
+        }
+        changed = changed || not removed.empty();
+        remove_instructions(*block, removed);
+    }
+    return changed;
+}
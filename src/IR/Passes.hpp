@@ -0,0 +1,93 @@
+#pragma once
+
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+
+#ifndef PASSES_HPP
+#define PASSES_HPP
+
+#include "IR.hpp"
+
+#include <memory>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+class IRPass {
+  public:
+    virtual ~IRPass() = default;
+
+    [[nodiscard]] virtual std::string_view name() const noexcept = 0;
+    // Returns true if the function was changed
+    virtual bool run(IRFunction &function) = 0;
+};
+
+// Runs a list of passes over functions. Since one pass can create more work for another (folding a branch makes a
+// block unreachable, removing that block can leave a PHI with only one value, and so on), the whole list is run again
+// for as long as any pass changes something, up to a fixed limit
+class PassManager {
+    static constexpr std::size_t max_rounds = 8;
+
+    std::vector<std::unique_ptr<IRPass>> passes{};
+
+  public:
+    void add(std::unique_ptr<IRPass> pass);
+    void run(IRFunction &function);
+};
+
+// Removes the blocks that cannot be reached from the entry block, along with the PHI operands for the edges coming
+// from them
+class UnreachableBlocks final : public IRPass {
+  public:
+    [[nodiscard]] std::string_view name() const noexcept override final;
+    bool run(IRFunction &function) override final;
+};
+
+// Merges a block into the block jumping to it when that is its only predecessor, so that the block boundaries left
+// behind by the lowering of loops and ifs (and by the other passes) do not get in the way of the backend
+class MergeBlocks final : public IRPass {
+  public:
+    [[nodiscard]] std::string_view name() const noexcept override final;
+    bool run(IRFunction &function) override final;
+};
+
+// Replaces instructions whose operands are all constants with their result, PHIs which only merge one value with that
+// value, and branches on constants with jumps. Anything that would raise an error or be undefined at runtime is left
+// as it is, exactly like in the ConstantFolder
+class ConstantPropagation final : public IRPass {
+    [[nodiscard]] static bool fold(IRInstruction &instruction);
+    [[nodiscard]] static bool fold_integral(IRInstruction &instruction, long long left, long long right);
+    [[nodiscard]] static bool fold_floating(IRInstruction &instruction, double left, double right);
+
+  public:
+    [[nodiscard]] std::string_view name() const noexcept override final;
+    bool run(IRFunction &function) override final;
+};
+
+// Removes operations that leave their operand as it is (`x + 0`, `x * 1`, `not not x`, ...) and replaces integral
+// multiplication, division and modulo by powers of two with shifts and masks. Since the VM wraps around on overflow and
+// division rounds towards zero, the latter is only done for values that are known to never be negative, which are
+// found by assuming every value is non-negative and then dropping the ones that do not follow from the others
+class AlgebraicSimplification final : public IRPass {
+    std::unordered_set<const IRInstruction *> non_negative{};
+
+    void find_non_negative(const IRFunction &function);
+    [[nodiscard]] bool is_non_negative(const IRInstruction *value) const noexcept;
+    // Replaced instructions are added to `removed`
+    [[nodiscard]] bool simplify(
+        IRFunction &function, IRInstruction &instruction, std::unordered_set<IRInstruction *> &removed);
+
+  public:
+    [[nodiscard]] std::string_view name() const noexcept override final;
+    bool run(IRFunction &function) override final;
+};
+
+// Removes instructions whose values are never used and which have no side effects, including cycles of PHIs that only
+// use each other
+class DeadValues final : public IRPass {
+  public:
+    [[nodiscard]] std::string_view name() const noexcept override final;
+    bool run(IRFunction &function) override final;
+};
+
+#endif
@@ -0,0 +1,288 @@
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+#include "ModuleCache.hpp"
+
+#include "VirtualMachine/Bytecode.hpp"
+#include "VirtualMachine/MappedFile.hpp"
+#include "VirtualMachine/Value.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <random>
+#include <sstream>
+
+#ifndef WIS_VERSION
+#define WIS_VERSION "unknown"
+#endif
+
+namespace {
+constexpr std::string_view entry_magic = "WISC";
+constexpr std::uint32_t entry_format = 5;
+
+// Everything is written in little endian, whatever the machine is
+class Writer {
+    std::string buffer{};
+
+  public:
+    void u8(std::uint8_t value) { buffer.push_back(static_cast<char>(value)); }
+    void u32(std::uint32_t value) {
+        for (std::size_t i{0}; i < 4; i++) {
+            u8(static_cast<std::uint8_t>(value >> (8 * i)));
+        }
+    }
+    void u64(std::uint64_t value) {
+        for (std::size_t i{0}; i < 8; i++) {
+            u8(static_cast<std::uint8_t>(value >> (8 * i)));
+        }
+    }
+    void raw(std::string_view value) { buffer.append(value); }
+    // Pads the entry with zeroes, so that what comes next starts at a multiple of `alignment` bytes
+    void align(std::size_t alignment) { buffer.resize((buffer.size() + alignment - 1) / alignment * alignment, '\0'); }
+    void string(std::string_view value) {
+        u64(value.size());
+        raw(value);
+    }
+
+    [[nodiscard]] const std::string &contents() const noexcept { return buffer; }
+};
+
+// Reading past the end of the data does not throw, it just makes every read after it fail
+class Reader {
+    std::string_view data{};
+    std::size_t position{};
+    bool failed{false};
+
+    [[nodiscard]] bool available(std::uint64_t size) {
+        failed = failed || size > data.size() - position;
+        return not failed;
+    }
+
+  public:
+    explicit Reader(std::string_view data) : data{data} {}
+
+    [[nodiscard]] bool ok() const noexcept { return not failed; }
+    [[nodiscard]] bool at_end() const noexcept { return not failed && position == data.size(); }
+
+    std::uint8_t u8() { return available(1) ? static_cast<std::uint8_t>(data[position++]) : 0; }
+    std::uint32_t u32() {
+        std::uint32_t value{};
+        for (std::size_t i{0}; i < 4; i++) {
+            value |= static_cast<std::uint32_t>(u8()) << (8 * i);
+        }
+        return value;
+    }
+    std::uint64_t u64() {
+        std::uint64_t value{};
+        for (std::size_t i{0}; i < 8; i++) {
+            value |= static_cast<std::uint64_t>(u8()) << (8 * i);
+        }
+        return value;
+    }
+    std::string_view raw(std::uint64_t size) {
+        if (not available(size)) {
+            return {};
+        }
+        std::string_view value = data.substr(position, size);
+        position += size;
+        return value;
+    }
+    std::string string() { return std::string{raw(u64())}; }
+    void align(std::size_t alignment) { raw((alignment - position % alignment) % alignment); }
+    // The number of elements that follows, when every element takes up at least `element_size` bytes
+    std::uint64_t count(std::uint64_t element_size) {
+        std::uint64_t value = u64();
+        failed = failed || value > (data.size() - position) / element_size;
+        return failed ? 0 : value;
+    }
+};
+
+std::optional<std::string> read_file(const std::filesystem::path &path) {
+    std::ifstream file{path, std::ios::in | std::ios::binary};
+    if (not file.is_open()) {
+        return std::nullopt;
+    }
+    return std::string{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+}
+} // namespace
+
+ModuleCache::ModuleCache(std::filesystem::path directory, std::uint64_t options, const std::filesystem::path &compiler)
+    : directory{std::move(directory)}, options{options} {
+    if (not enabled()) {
+        return;
+    }
+
+    std::error_code error{};
+    std::uintmax_t size = std::filesystem::file_size(compiler, error);
+    std::filesystem::file_time_type modified = std::filesystem::last_write_time(compiler, error);
+    if (error) {
+        this->directory.clear();
+        return;
+    }
+    // The version numbers of the bytecode and the instruction set are included too, though a change to either of them
+    // should also change the executable
+    std::ostringstream id{};
+    id << WIS_VERSION << ' ' << bytecode::version << ' ' << instruction_count << ' ' << size << ' '
+       << modified.time_since_epoch().count();
+    build = hash(id.str());
+}
+
+std::filesystem::path ModuleCache::default_directory() {
+    if (const char *cache_home = std::getenv("XDG_CACHE_HOME"); cache_home != nullptr && *cache_home != '\0') {
+        return std::filesystem::path{cache_home} / "wis";
+    } else if (const char *home = std::getenv("HOME"); home != nullptr && *home != '\0') {
+        return std::filesystem::path{home} / ".cache" / "wis";
+    } else if (const char *app_data = std::getenv("LOCALAPPDATA"); app_data != nullptr && *app_data != '\0') {
+        return std::filesystem::path{app_data} / "wis";
+    }
+    return {};
+}
+
+std::filesystem::path ModuleCache::running_compiler(const char *argv0) {
+    std::error_code error{};
+    if (std::filesystem::path self = std::filesystem::read_symlink("/proc/self/exe", error); not error) {
+        return self;
+    }
+    return std::filesystem::path{argv0};
+}
+
+// 64 bit FNV-1a, which unlike std::hash gives the same result with every standard library
+std::uint64_t ModuleCache::hash(std::string_view text) noexcept {
+    std::uint64_t result = 14695981039346656037ull;
+    for (char ch : text) {
+        result ^= static_cast<unsigned char>(ch);
+        result *= 1099511628211ull;
+    }
+    return result;
+}
+
+ModuleCache::Source ModuleCache::source_of(const Module &module, bool main) {
+    std::error_code error{};
+    std::filesystem::path path = std::filesystem::weakly_canonical(module.path, error);
+    if (error) {
+        path = std::filesystem::absolute(module.path, error);
+    }
+    return {path.string(), hash(module.text.front()), main};
+}
+
+std::vector<ModuleCache::Source> ModuleCache::imported_sources(
+    const Module &module, const std::vector<std::pair<Module, std::size_t>> &modules) {
+    std::vector<bool> seen(modules.size(), false);
+    std::vector<Source> sources{};
+    auto visit = [&modules, &seen, &sources](auto &self, const Module &importer) -> void {
+        for (std::size_t index : importer.imported) {
+            if (not seen[index]) {
+                seen[index] = true;
+                sources.push_back(source_of(modules[index].first));
+                self(self, modules[index].first);
+            }
+        }
+    };
+    visit(visit, module);
+    return sources;
+}
+
+std::filesystem::path ModuleCache::entry_path(const Source &module) const {
+    std::ostringstream name{};
+    name << std::filesystem::path{module.path}.filename().string() << (module.main ? "-main-" : "-") << std::hex
+         << std::setw(16) << std::setfill('0') << hash(module.path) << ".wisc";
+    return directory / name.str();
+}
+
+std::optional<ModuleCache::Entry> ModuleCache::load(const Source &module) const {
+    if (not enabled()) {
+        return std::nullopt;
+    }
+
+    MappedFile file{entry_path(module).string()};
+    if (not file.is_open()) {
+        return std::nullopt;
+    }
+
+    Reader in{file.contents()};
+    if (in.raw(entry_magic.size()) != entry_magic || in.u32() != entry_format || in.u64() != build ||
+        in.u64() != options || in.string() != module.path || in.u64() != module.hash || in.u8() != module.main) {
+        return std::nullopt;
+    }
+
+    std::uint64_t imports = in.count(16);
+    for (std::uint64_t i{0}; i < imports && in.ok(); i++) {
+        std::string path = in.string();
+        std::uint64_t expected_hash = in.u64();
+        if (std::optional<std::string> source = read_file(path); not source || hash(*source) != expected_hash) {
+            return std::nullopt;
+        }
+    }
+
+    std::string messages = in.string();
+    std::string output = in.string();
+    std::uint64_t compiled_size = in.u64();
+    in.align(8);
+    std::string_view compiled = in.raw(compiled_size);
+    if (not in.at_end()) {
+        return std::nullopt;
+    }
+    std::optional<RuntimeModule> loaded = bytecode::read(compiled);
+    if (not loaded.has_value()) {
+        return std::nullopt;
+    }
+    loaded->file = std::move(file);
+    return Entry{std::move(*loaded), std::move(messages), std::move(output)};
+}
+
+void ModuleCache::store(const Source &module, const std::vector<Source> &imports, const RuntimeModule &compiled,
+    std::string_view messages, std::string_view output) const {
+    if (not enabled()) {
+        return;
+    }
+
+    Writer out{};
+    out.raw(entry_magic);
+    out.u32(entry_format);
+    out.u64(build);
+    out.u64(options);
+    out.string(module.path);
+    out.u64(module.hash);
+    out.u8(module.main);
+    out.u64(imports.size());
+    for (const Source &imported : imports) {
+        out.string(imported.path);
+        out.u64(imported.hash);
+    }
+    std::optional<std::string> payload = bytecode::write(compiled);
+    if (not payload.has_value()) {
+        return;
+    }
+    out.string(messages);
+    out.string(output);
+    // The compiled code is read in place, where the bytecode needs it to be aligned like it is in a file of its own
+    out.u64(payload->size());
+    out.align(8);
+    out.raw(*payload);
+
+    std::error_code error{};
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        return;
+    }
+
+    // The entry is written to a file of its own first and then renamed over the old one, so that another compiler that
+    // is running at the same time can never read half of an entry
+    std::filesystem::path entry = entry_path(module);
+    std::filesystem::path temporary = entry;
+    temporary += ".tmp" + std::to_string(std::random_device{}());
+    {
+        std::ofstream file{temporary, std::ios::out | std::ios::binary | std::ios::trunc};
+        file.write(out.contents().data(), static_cast<std::streamsize>(out.contents().size()));
+        if (not file) {
+            file.close();
+            std::filesystem::remove(temporary, error);
+            return;
+        }
+    }
+    std::filesystem::rename(temporary, entry, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+
+#ifndef MODULE_CACHE_HPP
+#define MODULE_CACHE_HPP
+
+#include "VirtualMachine/Module.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Keeps the compiled code of modules on disk, in a .wisc file for every module, so that a module that has not changed
+// since the last time it was compiled does not have to go through the front end and the code generator again.
+//
+// An entry is only used if it was written by the same build of the compiler with the same code generation options,
+// and if neither the module nor any of the modules it imports (directly or not) have changed since. To tell, the hash
+// of the source of the module and the paths and hashes of the sources of everything it imports are kept in the entry
+class ModuleCache {
+  public:
+    struct Source {
+        std::string path{}; // Absolute, so that an entry does not depend on the directory the compiler is run from
+        std::uint64_t hash{};
+        // The entry of the module that is run keeps what was printed while compiling it, which the entry of the same
+        // module compiled as an import does not, so the two are kept apart
+        bool main{false};
+    };
+
+    struct Entry {
+        RuntimeModule compiled{}; // Run in place from the entry, which it keeps open
+        std::string messages{}; // The warnings printed while compiling it, which are printed again when it is used
+        std::string output{};   // Likewise for what was printed to stdout, such as the depths of the imported modules
+    };
+
+  private:
+    std::filesystem::path directory{};
+    std::uint64_t options{};
+    std::uint64_t build{}; // Tells apart the builds of the compiler, see the constructor
+
+    [[nodiscard]] std::filesystem::path entry_path(const Source &module) const;
+
+  public:
+    // An empty directory disables the cache. The options are anything that changes the code that is generated. The
+    // compiler is the executable that is running: as any change to the compiler can change the code it generates, an
+    // entry is only used by the executable that wrote it, as told by its size and the time it was last modified. The
+    // cache is disabled if the executable cannot be found
+    explicit ModuleCache(std::filesystem::path directory, std::uint64_t options, const std::filesystem::path &compiler);
+
+    // $XDG_CACHE_HOME/wis, ~/.cache/wis or %LOCALAPPDATA%/wis, or an empty path if none of them are set
+    [[nodiscard]] static std::filesystem::path default_directory();
+    // /proc/self/exe where there is one, and otherwise the path the compiler was run with (argv[0])
+    [[nodiscard]] static std::filesystem::path running_compiler(const char *argv0);
+    [[nodiscard]] static std::uint64_t hash(std::string_view text) noexcept;
+    [[nodiscard]] static Source source_of(const Module &module, bool main = false);
+    [[nodiscard]] static std::vector<Source> imported_sources(
+        const Module &module, const std::vector<std::pair<Module, std::size_t>> &modules);
+
+    [[nodiscard]] bool enabled() const noexcept { return not directory.empty(); }
+
+    [[nodiscard]] std::optional<Entry> load(const Source &module) const;
+    // Failing to write an entry is not an error, the module is just compiled again the next time
+    void store(const Source &module, const std::vector<Source> &imports, const RuntimeModule &compiled,
+        std::string_view messages = "", std::string_view output = "") const;
+};
+
+#endif
@@ -0,0 +1,71 @@
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+#include "NodeArena.hpp"
+
+#include "Common.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+thread_local NodeArena *NodeArena::current_arena = nullptr;
+
+NodeArena::NodeArena(NodeArena &&other) noexcept
+    : blocks{std::move(other.blocks)},
+      destructors{std::move(other.destructors)},
+      next{std::exchange(other.next, nullptr)},
+      end{std::exchange(other.end, nullptr)},
+      allocated{std::exchange(other.allocated, 0)} {
+    other.blocks.clear();
+    other.destructors.clear();
+}
+
+NodeArena &NodeArena::operator=(NodeArena &&other) noexcept {
+    if (this != &other) {
+        release();
+        blocks = std::move(other.blocks);
+        destructors = std::move(other.destructors);
+        next = std::exchange(other.next, nullptr);
+        end = std::exchange(other.end, nullptr);
+        allocated = std::exchange(other.allocated, 0);
+        other.blocks.clear();
+        other.destructors.clear();
+    }
+    return *this;
+}
+
+NodeArena::~NodeArena() noexcept {
+    release();
+}
+
+void NodeArena::release() noexcept {
+    // Nodes do not own each other, so the order they are destroyed in does not matter
+    for (auto it = destructors.rbegin(); it != destructors.rend(); it++) {
+        it->destroy(it->object);
+    }
+    destructors.clear();
+    blocks.clear();
+    next = end = nullptr;
+    allocated = 0;
+}
+
+NodeArena &NodeArena::current() noexcept {
+    assert(current_arena != nullptr && "Nodes can only be allocated while an arena is in scope");
+    return *current_arena;
+}
+
+void *NodeArena::allocate(std::size_t size, std::size_t alignment) {
+    std::size_t padding = (alignment - reinterpret_cast<std::uintptr_t>(next) % alignment) % alignment;
+    if (next == nullptr || static_cast<std::size_t>(end - next) < size + padding) {
+        // Nodes are far smaller than a block, but a block is still made large enough for whatever is asked for
+        std::size_t new_block_size = std::max(block_size, size + alignment);
+        blocks.emplace_back(new std::byte[new_block_size]);
+        next = blocks.back().get();
+        end = next + new_block_size;
+        padding = (alignment - reinterpret_cast<std::uintptr_t>(next) % alignment) % alignment;
+    }
+
+    void *memory = next + padding;
+    next += padding + size;
+    allocated += size;
+    return memory;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+
+#ifndef NODE_ARENA_HPP
+#define NODE_ARENA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// AST and type nodes are allocated from the arena of the module they belong to instead of one at a time from the heap.
+// Nothing is freed until the arena itself is destroyed, which runs the destructors of all the nodes in it and then
+// frees its memory a block at a time.
+//
+// An arena is made current for the thread using it with a NodeArena::Scope, which is what allocate_node allocates from
+class NodeArena {
+    struct Destructor {
+        void (*destroy)(void *object){};
+        void *object{};
+    };
+
+    std::vector<std::unique_ptr<std::byte[]>> blocks{};
+    std::vector<Destructor> destructors{};
+    std::byte *next{};
+    std::byte *end{};
+    std::size_t allocated{};
+
+    static thread_local NodeArena *current_arena;
+
+    void release() noexcept;
+
+  public:
+    static constexpr std::size_t block_size = 64 * 1024;
+
+    class Scope {
+        NodeArena *previous{};
+
+      public:
+        explicit Scope(NodeArena &arena) noexcept : previous{std::exchange(current_arena, &arena)} {}
+        ~Scope() noexcept { current_arena = previous; }
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+    };
+
+    NodeArena() = default;
+    NodeArena(const NodeArena &) = delete;
+    NodeArena &operator=(const NodeArena &) = delete;
+    NodeArena(NodeArena &&other) noexcept;
+    NodeArena &operator=(NodeArena &&other) noexcept;
+    ~NodeArena() noexcept;
+
+    [[nodiscard]] static NodeArena &current() noexcept;
+
+    [[nodiscard]] void *allocate(std::size_t size, std::size_t alignment);
+    // The total size of the nodes that have been allocated
+    [[nodiscard]] std::size_t size() const noexcept { return allocated; }
+
+    // Makes the arena run the destructor of an object constructed in its memory when it is destroyed
+    template <typename T>
+    T *adopt(T *object) {
+        if constexpr (not std::is_trivially_destructible_v<T>) {
+            destructors.push_back({[](void *object) { static_cast<T *>(object)->~T(); }, object});
+        }
+        return object;
+    }
+};
+
+// A non-owning pointer to a node, which has the same interface as the std::unique_ptr that was used before the nodes
+// were allocated from an arena. Moving from a handle still leaves it null, so code that relies on that keeps working
+template <typename T>
+class NodeHandle {
+    T *node{};
+
+    template <typename U>
+    friend class NodeHandle;
+
+  public:
+    NodeHandle() noexcept = default;
+    NodeHandle(std::nullptr_t) noexcept {}
+    explicit NodeHandle(T *node) noexcept : node{node} {}
+
+    NodeHandle(const NodeHandle &other) noexcept = default;
+    NodeHandle(NodeHandle &&other) noexcept : node{std::exchange(other.node, nullptr)} {}
+    template <typename U, typename = std::enable_if_t<std::is_convertible_v<U *, T *>>>
+    NodeHandle(NodeHandle<U> &&other) noexcept : node{std::exchange(other.node, nullptr)} {}
+
+    NodeHandle &operator=(const NodeHandle &other) noexcept = default;
+    NodeHandle &operator=(NodeHandle &&other) noexcept {
+        node = std::exchange(other.node, nullptr);
+        return *this;
+    }
+    NodeHandle &operator=(std::nullptr_t) noexcept {
+        node = nullptr;
+        return *this;
+    }
+
+    ~NodeHandle() noexcept = default;
+
+    [[nodiscard]] T *get() const noexcept { return node; }
+    T *operator->() const noexcept { return node; }
+    T &operator*() const noexcept { return *node; }
+    explicit operator bool() const noexcept { return node != nullptr; }
+
+    T *release() noexcept { return std::exchange(node, nullptr); }
+    void reset(T *other = nullptr) noexcept { node = other; }
+    void swap(NodeHandle &other) noexcept { std::swap(node, other.node); }
+
+    friend bool operator==(const NodeHandle &handle, std::nullptr_t) noexcept { return handle.node == nullptr; }
+    friend bool operator!=(const NodeHandle &handle, std::nullptr_t) noexcept { return handle.node != nullptr; }
+    friend bool operator==(std::nullptr_t, const NodeHandle &handle) noexcept { return handle.node == nullptr; }
+    friend bool operator!=(std::nullptr_t, const NodeHandle &handle) noexcept { return handle.node != nullptr; }
+};
+
+#endif
@@ -0,0 +1,101 @@
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+#include "BoundsChecks.hpp"
+
+#include "LoopEffects.hpp"
+
+bool BoundsChecks::enter_loop(WhileStmt &loop, VarStmt *counter) {
+    if (counter == nullptr || counter->type->primitive != Type::INT || counter->type->is_ref ||
+        counter->initializer == nullptr || counter->initializer->type_tag() != NodeType::LiteralExpr) {
+        return false;
+    }
+    if (auto *start = dynamic_cast<LiteralExpr *>(counter->initializer.get());
+        not start->value.is_int() || start->value.to_int() < 0) {
+        return false;
+    }
+
+    auto *condition = dynamic_cast<BinaryExpr *>(loop.condition.get());
+    if (condition == nullptr || condition->resolved.token.type != TokenType::LESS) {
+        return false;
+    }
+
+    // The counter is the last variable declared before the loop, so it occupies the stack slot just below the loop
+    auto *index = dynamic_cast<VariableExpr *>(condition->left.get());
+    if (index == nullptr || index->type != IdentifierType::LOCAL || index->name.lexeme != counter->name.lexeme ||
+        index->resolved.stack_slot + 1 != loop.stack_slot) {
+        return false;
+    }
+
+    auto *call = dynamic_cast<CallExpr *>(condition->right.get());
+    if (call == nullptr || not call->is_native_call || call->args.size() != 1 ||
+        call->function->type_tag() != NodeType::VariableExpr ||
+        dynamic_cast<VariableExpr *>(call->function.get())->name.lexeme != "size") {
+        return false;
+    }
+    auto *object = dynamic_cast<VariableExpr *>(std::get<ExprNode>(call->args[0]).get());
+    if (object == nullptr || (object->type != IdentifierType::LOCAL && object->type != IdentifierType::GLOBAL) ||
+        (object->resolved.info->primitive != Type::LIST && object->resolved.info->primitive != Type::STRING)) {
+        return false;
+    }
+
+    if (not increments(loop.increment.get(), index->resolved.stack_slot)) {
+        return false;
+    }
+
+    LoopEffects effects{};
+    effects.scan(loop.body.get());
+    if (effects.has_unknown_effects() || effects.has_calls() || effects.has_list_resizes() ||
+        effects.is_assigned(IdentifierType::LOCAL, index->resolved.stack_slot) ||
+        effects.is_assigned(object->type, object->resolved.stack_slot)) {
+        return false;
+    }
+
+    loops.push_back({object->type, object->resolved.stack_slot, index->resolved.stack_slot});
+    return true;
+}
+
+void BoundsChecks::leave_loop() {
+    loops.pop_back();
+}
+
+bool BoundsChecks::increments(Stmt *increment, std::size_t counter_slot) {
+    // Only ++i and i += <non-negative int> keep the counter from going below zero. The increment runs after the
+    // condition has been checked, so it cannot make the counter larger than size(x) before it is used
+    auto *stmt = dynamic_cast<ExpressionStmt *>(increment);
+    if (stmt == nullptr) {
+        return false;
+    }
+
+    if (auto *unary = dynamic_cast<UnaryExpr *>(stmt->expr.get()); unary != nullptr) {
+        auto *variable = dynamic_cast<VariableExpr *>(unary->right.get());
+        return unary->oper.type == TokenType::PLUS_PLUS && variable != nullptr &&
+               variable->type == IdentifierType::LOCAL && variable->resolved.stack_slot == counter_slot;
+    } else if (auto *assign = dynamic_cast<AssignExpr *>(stmt->expr.get()); assign != nullptr) {
+        auto *step = dynamic_cast<LiteralExpr *>(assign->value.get());
+        return assign->resolved.token.type == TokenType::PLUS_EQUAL && assign->target_type == IdentifierType::LOCAL &&
+               assign->resolved.stack_slot == counter_slot && step != nullptr && step->value.is_int() &&
+               step->value.to_int() >= 0;
+    }
+    return false;
+}
+
+bool BoundsChecks::is_in_bounds(Expr *object, Expr *index) {
+    auto *object_variable = dynamic_cast<VariableExpr *>(object);
+    auto *index_variable = dynamic_cast<VariableExpr *>(index);
+    if (object_variable == nullptr || index_variable == nullptr || index_variable->type != IdentifierType::LOCAL) {
+        return false;
+    }
+
+    for (const CountedLoop &loop : loops) {
+        if (loop.object_type == object_variable->type && loop.object_slot == object_variable->resolved.stack_slot &&
+            loop.counter_slot == index_variable->resolved.stack_slot) {
+            eliminated_count++;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::size_t BoundsChecks::eliminated() const noexcept {
+    return eliminated_count;
+}
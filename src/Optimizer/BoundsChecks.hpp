@@ -0,0 +1,42 @@
+#pragma once
+
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+
+#ifndef BOUNDS_CHECKS_HPP
+#define BOUNDS_CHECKS_HPP
+
+#include "../AST.hpp"
+
+#include <vector>
+
+// Finds indexing operations that can never go out of bounds, so that the generator can leave out the CHECK_LIST_INDEX
+// or CHECK_STRING_INDEX before them. This is only done in the body of loops of the form
+//
+// for (var i = <non-negative int>; i < size(x); ++i) { ... x[i] ... }
+//
+// where neither i nor x are assigned to in the body and no list can change size in it, so that 0 <= i < size(x) holds
+// everywhere in the body
+class BoundsChecks {
+    struct CountedLoop {
+        IdentifierType object_type{};
+        std::size_t object_slot{};
+        std::size_t counter_slot{};
+    };
+
+    std::vector<CountedLoop> loops{}; // The loops whose body is being compiled, innermost last
+    std::size_t eliminated_count{};
+
+    [[nodiscard]] static bool increments(Stmt *increment, std::size_t counter_slot);
+
+  public:
+    // Returns true if the loop has the form above, in which case leave_loop() has to be called after its body
+    [[nodiscard]] bool enter_loop(WhileStmt &loop, VarStmt *counter);
+    void leave_loop();
+
+    // Whether indexing object with index is known to be in bounds, counting it as an eliminated check if it is
+    [[nodiscard]] bool is_in_bounds(Expr *object, Expr *index);
+    [[nodiscard]] std::size_t eliminated() const noexcept;
+};
+
+#endif
@@ -0,0 +1,587 @@
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+#include "ConstantFolder.hpp"
+
+#include "../Common.hpp"
+#include "../VirtualMachine/Value.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+namespace {
+constexpr long long int_min = std::numeric_limits<std::int32_t>::min();
+constexpr long long int_max = std::numeric_limits<std::int32_t>::max();
+
+bool fits_in_int(long long value) {
+    return int_min <= value && value <= int_max;
+}
+} // namespace
+
+void ConstantFolder::fold(Module &module) {
+    NodeArena::Scope arena{module.nodes};
+    // Every module has its own set of globals
+    bindings.clear();
+    scopes.clear();
+    for (auto &stmt : module.statements) {
+        if (stmt != nullptr) {
+            fold(stmt.get());
+        }
+    }
+}
+
+std::size_t ConstantFolder::folded() const noexcept {
+    return folded_count;
+}
+
+void ConstantFolder::begin_scope() {
+    scopes.push_back(bindings.size());
+}
+
+void ConstantFolder::end_scope() {
+    bindings.resize(scopes.back());
+    scopes.pop_back();
+}
+
+void ConstantFolder::declare(const Token &name, std::optional<LiteralValue> value) {
+    // Every name is declared, even the non-constant ones, so that they shadow any constants with the same name
+    bindings.push_back({name.lexeme, std::move(value)});
+}
+
+void ConstantFolder::fold(ExprNode &expr, bool is_ref_context) {
+    // A variable that is being bound to a reference must remain a variable
+    if (expr == nullptr || (is_ref_context && expr->type_tag() == NodeType::VariableExpr)) {
+        return;
+    }
+    bool was_ref_context = std::exchange(in_ref_context, is_ref_context);
+    expr->accept(*this);
+    in_ref_context = was_ref_context;
+    if (replacement != nullptr) {
+        expr = std::move(replacement);
+        folded_count++;
+    }
+}
+
+void ConstantFolder::fold(Stmt *stmt) {
+    if (stmt != nullptr) {
+        stmt->accept(*this);
+    }
+}
+
+void ConstantFolder::fold_conversion(ExprNode &expr, NumericConversionType &conversion) {
+    LiteralExpr *literal = as_literal(expr.get());
+    if (literal == nullptr) {
+        return;
+    }
+
+    if (conversion == NumericConversionType::INT_TO_FLOAT && literal->value.is_int()) {
+        expr = make_literal(
+            LiteralValue{static_cast<double>(literal->value.to_int())}, Type::FLOAT, literal->resolved.token);
+        conversion = NumericConversionType::NONE;
+        folded_count++;
+    } else if (conversion == NumericConversionType::FLOAT_TO_INT && literal->value.is_double()) {
+        // Converting a value that does not fit in an int is undefined, so the range is checked before converting
+        double value = literal->value.to_double();
+        if (value > static_cast<double>(int_min) - 1.0 && value < static_cast<double>(int_max) + 1.0) {
+            expr = make_literal(LiteralValue{static_cast<int>(value)}, Type::INT, literal->resolved.token);
+            conversion = NumericConversionType::NONE;
+            folded_count++;
+        }
+    }
+}
+
+LiteralExpr *ConstantFolder::as_literal(Expr *expr) noexcept {
+    if (expr != nullptr && expr->type_tag() == NodeType::LiteralExpr) {
+        return dynamic_cast<LiteralExpr *>(expr);
+    }
+    return nullptr;
+}
+
+ExprNode ConstantFolder::make_literal(LiteralValue value, Type type, const TokenLocation &token) {
+    auto *literal =
+        allocate_node(LiteralExpr, std::move(value), TypeNode{allocate_node(PrimitiveType, type, true, false)});
+    literal->resolved = {literal->type.get(), token};
+    return ExprNode{literal};
+}
+
+ExprNode ConstantFolder::fold_integral(
+    TokenType oper, long long left, long long right, const TokenLocation &token) {
+    // Anything that would raise an error or be undefined at runtime is left for the VM to deal with
+    long long result{};
+    switch (oper) {
+        case TokenType::PLUS: result = left + right; break;
+        case TokenType::MINUS: result = left - right; break;
+        case TokenType::STAR: result = left * right; break;
+        case TokenType::SLASH:
+        case TokenType::MODULO:
+            if (right == 0 || (left == int_min && right == -1)) {
+                return nullptr;
+            }
+            result = oper == TokenType::SLASH ? left / right : left % right;
+            break;
+        case TokenType::LEFT_SHIFT:
+            if (left < 0 || right < 0 || right >= 32) {
+                return nullptr;
+            }
+            result = left << right;
+            break;
+        case TokenType::RIGHT_SHIFT:
+            if (right < 0 || right >= 32) {
+                return nullptr;
+            }
+            result = static_cast<std::int32_t>(left) >> right;
+            break;
+        case TokenType::BIT_AND: result = left & right; break;
+        case TokenType::BIT_OR: result = left | right; break;
+        case TokenType::BIT_XOR: result = left ^ right; break;
+
+        case TokenType::EQUAL_EQUAL: return make_literal(LiteralValue{left == right}, Type::BOOL, token);
+        case TokenType::NOT_EQUAL: return make_literal(LiteralValue{left != right}, Type::BOOL, token);
+        case TokenType::LESS: return make_literal(LiteralValue{left < right}, Type::BOOL, token);
+        case TokenType::GREATER: return make_literal(LiteralValue{left > right}, Type::BOOL, token);
+        case TokenType::LESS_EQUAL: return make_literal(LiteralValue{left <= right}, Type::BOOL, token);
+        case TokenType::GREATER_EQUAL: return make_literal(LiteralValue{left >= right}, Type::BOOL, token);
+
+        default: return nullptr;
+    }
+
+    if (not fits_in_int(result)) {
+        return nullptr;
+    }
+    return make_literal(LiteralValue{static_cast<int>(result)}, Type::INT, token);
+}
+
+ExprNode ConstantFolder::fold_floating(TokenType oper, double left, double right, const TokenLocation &token) {
+    switch (oper) {
+        case TokenType::PLUS: return make_literal(LiteralValue{left + right}, Type::FLOAT, token);
+        case TokenType::MINUS: return make_literal(LiteralValue{left - right}, Type::FLOAT, token);
+        case TokenType::STAR: return make_literal(LiteralValue{left * right}, Type::FLOAT, token);
+        case TokenType::SLASH:
+            if (right == 0.0) {
+                return nullptr;
+            }
+            return make_literal(LiteralValue{left / right}, Type::FLOAT, token);
+        case TokenType::MODULO:
+            if (right == 0.0) {
+                return nullptr;
+            }
+            return make_literal(LiteralValue{std::fmod(left, right)}, Type::FLOAT, token);
+
+        // `<=` and `>=` are compiled as the negation of `>` and `<`, which matters when either side is a NaN
+        case TokenType::EQUAL_EQUAL: return make_literal(LiteralValue{left == right}, Type::BOOL, token);
+        case TokenType::NOT_EQUAL: return make_literal(LiteralValue{not(left == right)}, Type::BOOL, token);
+        case TokenType::LESS: return make_literal(LiteralValue{left < right}, Type::BOOL, token);
+        case TokenType::GREATER: return make_literal(LiteralValue{left > right}, Type::BOOL, token);
+        case TokenType::LESS_EQUAL: return make_literal(LiteralValue{not(left > right)}, Type::BOOL, token);
+        case TokenType::GREATER_EQUAL: return make_literal(LiteralValue{not(left < right)}, Type::BOOL, token);
+
+        default: return nullptr;
+    }
+}
+
+ExprNode ConstantFolder::fold_string(
+    TokenType oper, const std::string &left, const std::string &right, const TokenLocation &token) {
+    switch (oper) {
+        case TokenType::PLUS: return make_literal(LiteralValue{left + right}, Type::STRING, token);
+        case TokenType::EQUAL_EQUAL: return make_literal(LiteralValue{left == right}, Type::BOOL, token);
+        case TokenType::NOT_EQUAL: return make_literal(LiteralValue{left != right}, Type::BOOL, token);
+        case TokenType::LESS: return make_literal(LiteralValue{left < right}, Type::BOOL, token);
+        case TokenType::GREATER: return make_literal(LiteralValue{left > right}, Type::BOOL, token);
+        case TokenType::LESS_EQUAL: return make_literal(LiteralValue{not(left > right)}, Type::BOOL, token);
+        case TokenType::GREATER_EQUAL: return make_literal(LiteralValue{not(left < right)}, Type::BOOL, token);
+        default: return nullptr;
+    }
+}
+
+ExprVisitorType ConstantFolder::visit(AssignExpr &expr) {
+    fold(expr.value);
+    fold_conversion(expr.value, expr.conversion_type);
+    return {};
+}
+
+ExprVisitorType ConstantFolder::visit(BinaryExpr &expr) {
+    fold(expr.left);
+    fold(expr.right);
+
+    LiteralExpr *left = as_literal(expr.left.get());
+    LiteralExpr *right = as_literal(expr.right.get());
+    if (left == nullptr && right == nullptr) {
+        return {};
+    } else if (left == nullptr || right == nullptr) {
+        simplify(expr);
+        return {};
+    }
+
+    TokenType oper = expr.resolved.token.type;
+    if (left->value.is_int() && right->value.is_int()) {
+        replacement = fold_integral(oper, left->value.to_int(), right->value.to_int(), expr.resolved.token);
+    } else if (left->value.is_numeric() && right->value.is_numeric()) {
+        replacement =
+            fold_floating(oper, left->value.to_numeric(), right->value.to_numeric(), expr.resolved.token);
+    } else if (left->value.is_string() && right->value.is_string()) {
+        replacement = fold_string(oper, left->value.to_string(), right->value.to_string(), expr.resolved.token);
+    } else if (left->value.is_bool() && right->value.is_bool()) {
+        if (oper == TokenType::EQUAL_EQUAL) {
+            replacement = make_literal(
+                LiteralValue{left->value.to_bool() == right->value.to_bool()}, Type::BOOL, expr.resolved.token);
+        } else if (oper == TokenType::NOT_EQUAL) {
+            replacement = make_literal(
+                LiteralValue{left->value.to_bool() != right->value.to_bool()}, Type::BOOL, expr.resolved.token);
+        }
+    }
+
+    // Only keep the result if it has the type that the type checker gave to the expression
+    if (replacement != nullptr && replacement->resolved.info->primitive != expr.resolved.info->primitive) {
+        replacement = nullptr;
+    }
+    return {};
+}
+
+void ConstantFolder::simplify(BinaryExpr &expr) {
+    if (in_ref_context) {
+        return;
+    }
+
+    auto is_literal = [](const ExprNode &operand, double value) {
+        LiteralExpr *literal = as_literal(operand.get());
+        return literal != nullptr && literal->value.is_numeric() && literal->value.to_numeric() == value &&
+               (value != 0 || not std::signbit(literal->value.to_numeric()));
+    };
+    Type type = expr.resolved.info->primitive;
+    // The right operand is checked first, so that of `0 + 0` it is the left one that is kept
+    auto keep_other = [&expr, &is_literal, type](double identity, bool is_commutative) -> ExprNode {
+        if (is_literal(expr.right, identity) && keeps_type(expr.left, type)) {
+            return std::move(expr.left);
+        } else if (is_commutative && is_literal(expr.left, identity) && keeps_type(expr.right, type)) {
+            return std::move(expr.right);
+        }
+        return nullptr;
+    };
+
+    switch (expr.resolved.token.type) {
+        // Only for ints, since -0.0 + 0.0 is 0.0 (and lists also use the shift operators)
+        case TokenType::PLUS: replacement = type == Type::INT ? keep_other(0, true) : nullptr; break;
+        case TokenType::LEFT_SHIFT:
+        case TokenType::RIGHT_SHIFT: replacement = type == Type::INT ? keep_other(0, false) : nullptr; break;
+        case TokenType::MINUS: replacement = keep_other(0, false); break;
+        case TokenType::STAR: replacement = keep_other(1, true); break;
+        case TokenType::SLASH: replacement = keep_other(1, false); break;
+        case TokenType::BIT_AND: replacement = keep_other(-1, true); break;
+        case TokenType::BIT_OR:
+        case TokenType::BIT_XOR: replacement = keep_other(0, true); break;
+        default: break;
+    }
+}
+
+bool ConstantFolder::keeps_type(const ExprNode &operand, Type type) noexcept {
+    // A reference would have been dereferenced by the operation, so it cannot take its place
+    return operand->resolved.info->primitive == type && not operand->resolved.info->is_ref;
+}
+
+ExprVisitorType ConstantFolder::visit(CallExpr &expr) {
+    fold(expr.function);
+    FunctionStmt *called = expr.is_native_call ? nullptr : expr.function->resolved.func;
+    std::size_t i = 0;
+    for (auto &arg : expr.args) {
+        bool is_ref = called != nullptr && i < called->params.size() && called->params[i].second->is_ref;
+        fold(std::get<ExprNode>(arg), is_ref);
+        fold_conversion(std::get<ExprNode>(arg), std::get<NumericConversionType>(arg));
+        i++;
+    }
+    return {};
+}
+
+ExprVisitorType ConstantFolder::visit(CommaExpr &expr) {
+    for (auto &sub_expr : expr.exprs) {
+        fold(sub_expr);
+    }
+    return {};
+}
+
+ExprVisitorType ConstantFolder::visit(GetExpr &expr) {
+    fold(expr.object);
+    return {};
+}
+
+ExprVisitorType ConstantFolder::visit(GroupingExpr &expr) {
+    fold(expr.expr);
+    if (as_literal(expr.expr.get()) != nullptr) {
+        replacement = std::move(expr.expr);
+    }
+    return {};
+}
+
+ExprVisitorType ConstantFolder::visit(IndexExpr &expr) {
+    fold(expr.object);
+    fold(expr.index);
+    return {};
+}
+
+ExprVisitorType ConstantFolder::visit(ListExpr &expr) {
+    bool is_ref = expr.type != nullptr && expr.type->contained->is_ref;
+    for (auto &element : expr.elements) {
+        fold(std::get<ExprNode>(element), is_ref);
+        fold_conversion(std::get<ExprNode>(element), std::get<NumericConversionType>(element));
+    }
+    return {};
+}
+
+ExprVisitorType ConstantFolder::visit(ListAssignExpr &expr) {
+    fold(expr.list.object, true);
+    fold(expr.list.index);
+    fold(expr.value);
+    fold_conversion(expr.value, expr.conversion_type);
+    return {};
+}
+
+ExprVisitorType ConstantFolder::visit(LiteralExpr &) {
+    return {};
+}
+
+ExprVisitorType ConstantFolder::visit(LogicalExpr &expr) {
+    fold(expr.left);
+    fold(expr.right);
+
+    LiteralExpr *left = as_literal(expr.left.get());
+    if (left == nullptr || not left->value.is_bool()) {
+        return {};
+    }
+
+    // The short circuiting operand decides the result on its own, otherwise the result is the right operand
+    bool is_or = expr.resolved.token.type == TokenType::OR;
+    if (left->value.to_bool() == is_or) {
+        replacement = std::move(expr.left);
+    } else if (expr.right->resolved.info->primitive == Type::BOOL && not expr.right->resolved.info->is_ref) {
+        replacement = std::move(expr.right);
+    }
+    return {};
+}
+
+ExprVisitorType ConstantFolder::visit(ScopeAccessExpr &) {
+    return {};
+}
+
+ExprVisitorType ConstantFolder::visit(ScopeNameExpr &) {
+    return {};
+}
+
+ExprVisitorType ConstantFolder::visit(SetExpr &expr) {
+    fold(expr.object, true);
+    fold(expr.value);
+    fold_conversion(expr.value, expr.conversion_type);
+    return {};
+}
+
+ExprVisitorType ConstantFolder::visit(SuperExpr &) {
+    return {};
+}
+
+ExprVisitorType ConstantFolder::visit(TernaryExpr &expr) {
+    fold(expr.left);
+    fold(expr.middle);
+    fold(expr.right);
+
+    if (LiteralExpr *condition = as_literal(expr.left.get()); condition != nullptr && condition->value.is_bool()) {
+        ExprNode &taken = condition->value.to_bool() ? expr.middle : expr.right;
+        if (taken->resolved.info->primitive == expr.resolved.info->primitive) {
+            replacement = std::move(taken);
+        }
+    }
+    return {};
+}
+
+ExprVisitorType ConstantFolder::visit(ThisExpr &) {
+    return {};
+}
+
+ExprVisitorType ConstantFolder::visit(TupleExpr &expr) {
+    std::size_t i = 0;
+    for (auto &element : expr.elements) {
+        bool is_ref = expr.type != nullptr && i < expr.type->types.size() && expr.type->types[i]->is_ref;
+        fold(std::get<ExprNode>(element), is_ref);
+        fold_conversion(std::get<ExprNode>(element), std::get<NumericConversionType>(element));
+        i++;
+    }
+    return {};
+}
+
+ExprVisitorType ConstantFolder::visit(UnaryExpr &expr) {
+    if (expr.oper.type == TokenType::PLUS_PLUS || expr.oper.type == TokenType::MINUS_MINUS) {
+        return {};
+    }
+
+    fold(expr.right);
+    LiteralExpr *right = as_literal(expr.right.get());
+    if (right == nullptr) {
+        // `not` gives a bool for any operand, so `not not x` can only be replaced with x when x is already a bool
+        auto *inner = dynamic_cast<UnaryExpr *>(expr.right.get());
+        if (expr.oper.type == TokenType::NOT && inner != nullptr && inner->oper.type == TokenType::NOT &&
+            not in_ref_context && keeps_type(inner->right, Type::BOOL)) {
+            replacement = std::move(inner->right);
+        }
+        return {};
+    }
+
+    switch (expr.oper.type) {
+        case TokenType::MINUS:
+            if (right->value.is_int() && right->value.to_int() != int_min) {
+                replacement = make_literal(LiteralValue{-right->value.to_int()}, Type::INT, expr.resolved.token);
+            } else if (right->value.is_double()) {
+                replacement = make_literal(LiteralValue{-right->value.to_double()}, Type::FLOAT, expr.resolved.token);
+            }
+            break;
+        case TokenType::PLUS:
+            if (right->value.is_numeric()) {
+                replacement = std::move(expr.right);
+            }
+            break;
+        case TokenType::BIT_NOT:
+            if (right->value.is_int()) {
+                replacement = make_literal(LiteralValue{~right->value.to_int()}, Type::INT, expr.resolved.token);
+            }
+            break;
+        case TokenType::NOT:
+            if (right->value.is_bool()) {
+                replacement = make_literal(LiteralValue{not right->value.to_bool()}, Type::BOOL, expr.resolved.token);
+            }
+            break;
+        default: break;
+    }
+    return {};
+}
+
+ExprVisitorType ConstantFolder::visit(VariableExpr &expr) {
+    if (expr.type != IdentifierType::LOCAL && expr.type != IdentifierType::GLOBAL) {
+        return {};
+    }
+
+    for (auto it = bindings.crbegin(); it != bindings.crend(); it++) {
+        if (it->name == expr.name.lexeme) {
+            if (it->value.has_value()) {
+                replacement = make_literal(*it->value, expr.resolved.info->primitive, expr.resolved.token);
+            }
+            break;
+        }
+    }
+    return {};
+}
+
+StmtVisitorType ConstantFolder::visit(BlockStmt &stmt) {
+    begin_scope();
+    for (auto &statement : stmt.stmts) {
+        fold(statement.get());
+    }
+    end_scope();
+}
+
+StmtVisitorType ConstantFolder::visit(BreakStmt &) {}
+
+StmtVisitorType ConstantFolder::visit(ClassStmt &) {}
+
+StmtVisitorType ConstantFolder::visit(ContinueStmt &) {}
+
+StmtVisitorType ConstantFolder::visit(ExpressionStmt &stmt) {
+    fold(stmt.expr);
+}
+
+StmtVisitorType ConstantFolder::visit(ForEachStmt &stmt) {
+    fold(stmt.iterable);
+    begin_scope();
+    declare(stmt.name, std::nullopt);
+    fold(stmt.body.get());
+    end_scope();
+}
+
+StmtVisitorType ConstantFolder::visit(FunctionStmt &stmt) {
+    begin_scope();
+    for (auto &param : stmt.params) {
+        declare(param.first, std::nullopt);
+    }
+    fold(stmt.body.get());
+    end_scope();
+}
+
+StmtVisitorType ConstantFolder::visit(IfStmt &stmt) {
+    fold(stmt.condition);
+    fold(stmt.thenBranch.get());
+    fold(stmt.elseBranch.get());
+}
+
+StmtVisitorType ConstantFolder::visit(ReturnStmt &stmt) {
+    fold(stmt.value, stmt.function != nullptr && stmt.function->return_type->is_ref);
+}
+
+StmtVisitorType ConstantFolder::visit(SwitchStmt &stmt) {
+    fold(stmt.condition);
+    for (auto &case_ : stmt.cases) {
+        fold(case_.first);
+        fold(case_.second.get());
+    }
+    fold(stmt.default_case.get());
+}
+
+StmtVisitorType ConstantFolder::visit(TypeStmt &) {}
+
+StmtVisitorType ConstantFolder::visit(VarStmt &stmt) {
+    std::optional<LiteralValue> value{};
+    if (stmt.initializer != nullptr) {
+        fold(stmt.initializer, stmt.type->is_ref);
+        fold_conversion(stmt.initializer, stmt.conversion_type);
+
+        LiteralExpr *literal = as_literal(stmt.initializer.get());
+        if (literal != nullptr && stmt.type->is_const && not stmt.type->is_ref &&
+            stmt.conversion_type == NumericConversionType::NONE) {
+            switch (stmt.type->primitive) {
+                case Type::INT:
+                    if (literal->value.is_int()) {
+                        value = literal->value;
+                    }
+                    break;
+                case Type::FLOAT:
+                    if (literal->value.is_double()) {
+                        value = literal->value;
+                    }
+                    break;
+                case Type::STRING:
+                    if (literal->value.is_string()) {
+                        value = literal->value;
+                    }
+                    break;
+                case Type::BOOL:
+                    if (literal->value.is_bool()) {
+                        value = literal->value;
+                    }
+                    break;
+                default: break;
+            }
+        }
+    }
+    declare(stmt.name, std::move(value));
+}
+
+StmtVisitorType ConstantFolder::visit(WhileStmt &stmt) {
+    fold(stmt.condition);
+    fold(stmt.body.get());
+    fold(stmt.increment.get());
+}
+
+BaseTypeVisitorType ConstantFolder::visit(PrimitiveType &type) {
+    return &type;
+}
+
+BaseTypeVisitorType ConstantFolder::visit(UserDefinedType &type) {
+    return &type;
+}
+
+BaseTypeVisitorType ConstantFolder::visit(ListType &type) {
+    return &type;
+}
+
+BaseTypeVisitorType ConstantFolder::visit(TupleType &type) {
+    return &type;
+}
+
+BaseTypeVisitorType ConstantFolder::visit(TypeofType &type) {
+    return &type;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+
+#ifndef CONSTANT_FOLDER_HPP
+#define CONSTANT_FOLDER_HPP
+
+#include "../AST.hpp"
+#include "../VirtualMachine/Module.hpp"
+
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Runs on type checked code before it is compiled. Operations whose operands are all known at compile time are
+// replaced with their result, and uses of `const` variables of primitive type that are initialized with such a value
+// are replaced with the value itself. Operations that leave their other operand as it is (`x + 0`, `x * 1`, `not not x`
+// and the like) are replaced with that operand
+class ConstantFolder final : Visitor {
+    struct Binding {
+        std::string_view name{};
+        std::optional<LiteralValue> value{}; // Empty when the name does not refer to a known constant
+    };
+
+    std::vector<Binding> bindings{};
+    std::vector<std::size_t> scopes{};
+    ExprNode replacement{}; // Set by the visit functions when the visited expression can be replaced
+    bool in_ref_context{false};
+    std::size_t folded_count{};
+
+    void begin_scope();
+    void end_scope();
+    void declare(const Token &name, std::optional<LiteralValue> value);
+
+    void fold(ExprNode &expr, bool is_ref_context = false);
+    void fold(Stmt *stmt);
+    void fold_conversion(ExprNode &expr, NumericConversionType &conversion);
+    void simplify(BinaryExpr &expr);
+
+    [[nodiscard]] static LiteralExpr *as_literal(Expr *expr) noexcept;
+    // Whether `operand` can stand in for an expression of the given type that it is an operand of
+    [[nodiscard]] static bool keeps_type(const ExprNode &operand, Type type) noexcept;
+    [[nodiscard]] static ExprNode make_literal(LiteralValue value, Type type, const TokenLocation &token);
+    [[nodiscard]] static ExprNode fold_integral(
+        TokenType oper, long long left, long long right, const TokenLocation &token);
+    [[nodiscard]] static ExprNode fold_floating(TokenType oper, double left, double right, const TokenLocation &token);
+    [[nodiscard]] static ExprNode fold_string(TokenType oper, const std::string &left, const std::string &right,
+        const TokenLocation &token);
+
+  public:
+    void fold(Module &module);
+    [[nodiscard]] std::size_t folded() const noexcept;
+
+    ExprVisitorType visit(AssignExpr &expr) override final;
+    ExprVisitorType visit(BinaryExpr &expr) override final;
+    ExprVisitorType visit(CallExpr &expr) override final;
+    ExprVisitorType visit(CommaExpr &expr) override final;
+    ExprVisitorType visit(GetExpr &expr) override final;
+    ExprVisitorType visit(GroupingExpr &expr) override final;
+    ExprVisitorType visit(IndexExpr &expr) override final;
+    ExprVisitorType visit(ListExpr &expr) override final;
+    ExprVisitorType visit(ListAssignExpr &expr) override final;
+    ExprVisitorType visit(LiteralExpr &expr) override final;
+    ExprVisitorType visit(LogicalExpr &expr) override final;
+    ExprVisitorType visit(ScopeAccessExpr &expr) override final;
+    ExprVisitorType visit(ScopeNameExpr &expr) override final;
+    ExprVisitorType visit(SetExpr &expr) override final;
+    ExprVisitorType visit(SuperExpr &expr) override final;
+    ExprVisitorType visit(TernaryExpr &expr) override final;
+    ExprVisitorType visit(ThisExpr &expr) override final;
+    ExprVisitorType visit(TupleExpr &expr) override final;
+    ExprVisitorType visit(UnaryExpr &expr) override final;
+    ExprVisitorType visit(VariableExpr &expr) override final;
+
+    StmtVisitorType visit(BlockStmt &stmt) override final;
+    StmtVisitorType visit(BreakStmt &stmt) override final;
+    StmtVisitorType visit(ClassStmt &stmt) override final;
+    StmtVisitorType visit(ContinueStmt &stmt) override final;
+    StmtVisitorType visit(ExpressionStmt &stmt) override final;
+    StmtVisitorType visit(ForEachStmt &stmt) override final;
+    StmtVisitorType visit(FunctionStmt &stmt) override final;
+    StmtVisitorType visit(IfStmt &stmt) override final;
+    StmtVisitorType visit(ReturnStmt &stmt) override final;
+    StmtVisitorType visit(SwitchStmt &stmt) override final;
+    StmtVisitorType visit(TypeStmt &stmt) override final;
+    StmtVisitorType visit(VarStmt &stmt) override final;
+    StmtVisitorType visit(WhileStmt &stmt) override final;
+
+    BaseTypeVisitorType visit(PrimitiveType &type) override final;
+    BaseTypeVisitorType visit(UserDefinedType &type) override final;
+    BaseTypeVisitorType visit(ListType &type) override final;
+    BaseTypeVisitorType visit(TupleType &type) override final;
+    BaseTypeVisitorType visit(TypeofType &type) override final;
+};
+
+#endif
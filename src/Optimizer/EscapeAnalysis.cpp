@@ -0,0 +1,211 @@
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+#include "EscapeAnalysis.hpp"
+
+void EscapeAnalysis::escape(const BaseType *type) {
+    if (auto list = lists.find(type); list != lists.end()) {
+        escaped.insert(list->second);
+    }
+}
+
+std::unordered_set<const VarStmt *> EscapeAnalysis::find(FunctionStmt &function) {
+    lists.clear();
+    escaped.clear();
+    loop_depth = 0;
+    unknown_uses = false;
+
+    scan(function.body.get());
+
+    std::unordered_set<const VarStmt *> result{};
+    if (unknown_uses) {
+        return result;
+    }
+    for (auto &[type, var] : lists) {
+        if (not escaped.count(var)) {
+            result.insert(var);
+        }
+    }
+    frame_lists += result.size();
+    return result;
+}
+
+std::size_t EscapeAnalysis::found() const noexcept {
+    return frame_lists;
+}
+
+void EscapeAnalysis::scan(Stmt *stmt) {
+    if (stmt == nullptr) {
+        return;
+    }
+
+    switch (stmt->type_tag()) {
+        case NodeType::BlockStmt:
+            for (auto &inner : dynamic_cast<BlockStmt *>(stmt)->stmts) {
+                scan(inner.get());
+            }
+            break;
+        case NodeType::BreakStmt:
+        case NodeType::ContinueStmt: break;
+        case NodeType::ExpressionStmt: scan(dynamic_cast<ExpressionStmt *>(stmt)->expr.get(), true); break;
+        case NodeType::ForEachStmt: {
+            auto *for_each = dynamic_cast<ForEachStmt *>(stmt);
+            scan(for_each->iterable.get(), true);
+            loop_depth++;
+            scan(for_each->body.get());
+            loop_depth--;
+            break;
+        }
+        case NodeType::IfStmt: {
+            auto *if_ = dynamic_cast<IfStmt *>(stmt);
+            scan(if_->condition.get(), true);
+            scan(if_->thenBranch.get());
+            scan(if_->elseBranch.get());
+            break;
+        }
+        case NodeType::ReturnStmt: scan(dynamic_cast<ReturnStmt *>(stmt)->value.get(), false); break;
+        case NodeType::SwitchStmt: {
+            auto *switch_ = dynamic_cast<SwitchStmt *>(stmt);
+            scan(switch_->condition.get(), false);
+            for (auto &case_ : switch_->cases) {
+                scan(case_.first.get(), false);
+                scan(case_.second.get());
+            }
+            scan(switch_->default_case.get());
+            break;
+        }
+        case NodeType::VarStmt: {
+            auto *var = dynamic_cast<VarStmt *>(stmt);
+            if (auto *list = dynamic_cast<ListType *>(var->type.get()); list != nullptr) {
+                scan(list->size.get(), true);
+            }
+            scan(var->initializer.get(), var->requires_copy && not var->type->is_ref);
+
+            if (loop_depth == 0 && var->type->primitive == Type::LIST && not var->type->is_ref &&
+                (var->initializer == nullptr || var->initializer->type_tag() == NodeType::ListExpr)) {
+                lists[var->type.get()] = var;
+            }
+            break;
+        }
+        case NodeType::WhileStmt: {
+            auto *loop = dynamic_cast<WhileStmt *>(stmt);
+            loop_depth++;
+            scan(loop->condition.get(), true);
+            scan(loop->body.get());
+            scan(loop->increment.get());
+            loop_depth--;
+            break;
+        }
+        default: unknown_uses = true; break;
+    }
+}
+
+void EscapeAnalysis::scan(Expr *expr, bool in_place) {
+    if (expr == nullptr) {
+        return;
+    }
+
+    switch (expr->type_tag()) {
+        case NodeType::AssignExpr: {
+            auto *assign = dynamic_cast<AssignExpr *>(expr);
+            // The value of an assignment is the variable that was assigned to
+            if (not in_place) {
+                escape(assign->resolved.info);
+            }
+            scan(assign->value.get(), assign->requires_copy);
+            break;
+        }
+        case NodeType::BinaryExpr: {
+            auto *binary = dynamic_cast<BinaryExpr *>(expr);
+            if ((binary->resolved.token.type == TokenType::LEFT_SHIFT ||
+                    binary->resolved.token.type == TokenType::RIGHT_SHIFT) &&
+                binary->left->resolved.info->primitive == Type::LIST) {
+                // Appending to or popping from a list gives back the list, and whatever is appended is stored in it
+                scan(binary->left.get(), in_place);
+                scan(binary->right.get(), binary->resolved.token.type == TokenType::RIGHT_SHIFT);
+            } else {
+                scan(binary->left.get(), true);
+                scan(binary->right.get(), true);
+            }
+            break;
+        }
+        case NodeType::CallExpr: {
+            auto *call = dynamic_cast<CallExpr *>(expr);
+            for (std::size_t i = 0; i < call->args.size(); i++) {
+                auto &[arg, conversion, requires_copy] = call->args[i];
+                if (call->is_native_call) {
+                    scan(arg.get(), true);
+                } else if (call->function->resolved.func != nullptr &&
+                           not call->function->resolved.func->params[i].second->is_ref) {
+                    scan(arg.get(), requires_copy);
+                } else {
+                    scan(arg.get(), false);
+                }
+            }
+            scan(call->function.get(), true);
+            break;
+        }
+        case NodeType::CommaExpr: {
+            auto &exprs = dynamic_cast<CommaExpr *>(expr)->exprs;
+            for (std::size_t i = 0; i < exprs.size(); i++) {
+                scan(exprs[i].get(), i + 1 < exprs.size() || in_place);
+            }
+            break;
+        }
+        case NodeType::GetExpr: scan(dynamic_cast<GetExpr *>(expr)->object.get(), false); break;
+        case NodeType::GroupingExpr: scan(dynamic_cast<GroupingExpr *>(expr)->expr.get(), in_place); break;
+        case NodeType::IndexExpr: {
+            auto *index = dynamic_cast<IndexExpr *>(expr);
+            scan(index->object.get(), true);
+            scan(index->index.get(), true);
+            break;
+        }
+        case NodeType::ListExpr:
+            for (auto &element : dynamic_cast<ListExpr *>(expr)->elements) {
+                scan(std::get<ExprNode>(element).get(), false);
+            }
+            break;
+        case NodeType::ListAssignExpr: {
+            auto *assign = dynamic_cast<ListAssignExpr *>(expr);
+            scan(assign->list.object.get(), true);
+            scan(assign->list.index.get(), true);
+            scan(assign->value.get(), assign->requires_copy);
+            break;
+        }
+        case NodeType::LiteralExpr:
+        case NodeType::ScopeAccessExpr:
+        case NodeType::ScopeNameExpr:
+        case NodeType::SuperExpr:
+        case NodeType::ThisExpr: break;
+        case NodeType::LogicalExpr: {
+            auto *logical = dynamic_cast<LogicalExpr *>(expr);
+            scan(logical->left.get(), true);
+            scan(logical->right.get(), true);
+            break;
+        }
+        case NodeType::SetExpr: {
+            auto *set = dynamic_cast<SetExpr *>(expr);
+            scan(set->object.get(), false);
+            scan(set->value.get(), false);
+            break;
+        }
+        case NodeType::TernaryExpr: {
+            auto *ternary = dynamic_cast<TernaryExpr *>(expr);
+            scan(ternary->left.get(), true);
+            scan(ternary->middle.get(), in_place);
+            scan(ternary->right.get(), in_place);
+            break;
+        }
+        case NodeType::TupleExpr:
+            for (auto &element : dynamic_cast<TupleExpr *>(expr)->elements) {
+                scan(std::get<ExprNode>(element).get(), false);
+            }
+            break;
+        case NodeType::UnaryExpr: scan(dynamic_cast<UnaryExpr *>(expr)->right.get(), true); break;
+        case NodeType::VariableExpr:
+            if (not in_place) {
+                escape(expr->resolved.info);
+            }
+            break;
+        default: unknown_uses = true; break;
+    }
+}
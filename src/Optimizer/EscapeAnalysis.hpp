@@ -0,0 +1,41 @@
+#pragma once
+
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+
+#ifndef ESCAPE_ANALYSIS_HPP
+#define ESCAPE_ANALYSIS_HPP
+
+#include "../AST.hpp"
+
+#include <unordered_map>
+#include <unordered_set>
+
+// Finds the lists declared in a function that can never outlive the call that creates them, so that the generator can
+// have them allocated from the frame arena of the VM, which is released in bulk when the function returns. Only lists
+// that are created by their own declaration (from a list expression or a size) outside of any loop are considered, so
+// that each call creates at most one of every such list.
+//
+// Such a list does not escape as long as it is only indexed, assigned to as a whole or element by element, appended
+// to or popped from, compared, iterated over, or passed to natives or to functions that take a copy of it. Anything
+// else (returning it, storing it in another list or tuple, binding a reference to it or passing it to a reference
+// parameter, ...) counts as an escape, as does anything the analysis does not understand
+class EscapeAnalysis {
+    std::unordered_map<const BaseType *, VarStmt *> lists{}; // The candidates, keyed by the type of their declaration
+    std::unordered_set<VarStmt *> escaped{};
+    std::size_t loop_depth{};
+    bool unknown_uses{false};
+    std::size_t frame_lists{};
+
+    void scan(Stmt *stmt);
+    // `in_place` is set when the value of the expression is only read or copied where it is, so that a list variable
+    // used as the expression does not escape through it
+    void scan(Expr *expr, bool in_place);
+    void escape(const BaseType *type);
+
+  public:
+    [[nodiscard]] std::unordered_set<const VarStmt *> find(FunctionStmt &function);
+    [[nodiscard]] std::size_t found() const noexcept;
+};
+
+#endif
@@ -0,0 +1,98 @@
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+#include "Inliner.hpp"
+
+const Inliner::Candidate *Inliner::candidate_for(FunctionStmt *function) {
+    if (auto found = candidates.find(function); found != candidates.end()) {
+        return found->second.body != nullptr ? &found->second : nullptr;
+    }
+
+    Candidate &candidate = candidates[function];
+    if (not is_inlinable_type(function->return_type.get())) {
+        return nullptr;
+    }
+    for (auto &param : function->params) {
+        if (not is_inlinable_type(param.second.get())) {
+            return nullptr;
+        }
+    }
+
+    auto *body = dynamic_cast<BlockStmt *>(function->body.get());
+    if (body == nullptr || body->stmts.size() != 1 || body->stmts[0]->type_tag() != NodeType::ReturnStmt) {
+        return nullptr;
+    }
+
+    // The type resolver allows returning values that are only convertible to the return type without emitting a
+    // conversion, so the types have to match exactly for the inlined expression to produce the same value
+    Expr *value = dynamic_cast<ReturnStmt *>(body->stmts[0].get())->value.get();
+    if (value == nullptr || value->resolved.info->primitive != function->return_type->primitive ||
+        value->resolved.info->is_ref) {
+        return nullptr;
+    }
+
+    std::size_t size = 0;
+    candidate.param_uses.resize(function->params.size());
+    if (not measure(value, candidate, size) || size > max_body_size) {
+        return nullptr;
+    }
+
+    candidate.body = value;
+    return &candidate;
+}
+
+void Inliner::record(std::string_view function, std::string_view module, std::size_t line) {
+    inlined.push_back({function, module, line});
+}
+
+void Inliner::print_report(std::ostream &out) const {
+    out << "Inlined " << inlined.size() << " call(s)\n";
+    for (const InlinedCall &call : inlined) {
+        out << "  " << call.function << " in module " << call.module << ", line " << call.line << '\n';
+    }
+}
+
+bool Inliner::is_inlinable_type(const BaseType *type) noexcept {
+    // Lists and tuples need to be copied or destroyed when passed or returned, and references need to be made to the
+    // argument, so only plain values are allowed
+    return not type->is_ref && (type->primitive == Type::INT || type->primitive == Type::FLOAT ||
+                                   type->primitive == Type::BOOL || type->primitive == Type::STRING);
+}
+
+bool Inliner::measure(Expr *expr, Candidate &candidate, std::size_t &size) {
+    size++;
+    switch (expr->type_tag()) {
+        case NodeType::LiteralExpr: return true;
+        case NodeType::VariableExpr: {
+            // The parameters of a function occupy the first stack slots of its frame
+            auto *variable = dynamic_cast<VariableExpr *>(expr);
+            if (variable->type != IdentifierType::LOCAL ||
+                variable->resolved.stack_slot >= candidate.param_uses.size()) {
+                return false;
+            }
+            candidate.param_uses[variable->resolved.stack_slot]++;
+            return true;
+        }
+        case NodeType::GroupingExpr: return measure(dynamic_cast<GroupingExpr *>(expr)->expr.get(), candidate, size);
+        case NodeType::UnaryExpr: {
+            auto *unary = dynamic_cast<UnaryExpr *>(expr);
+            return unary->oper.type != TokenType::PLUS_PLUS && unary->oper.type != TokenType::MINUS_MINUS &&
+                   measure(unary->right.get(), candidate, size);
+        }
+        case NodeType::BinaryExpr: {
+            auto *binary = dynamic_cast<BinaryExpr *>(expr);
+            return binary->resolved.token.type != TokenType::DOT_DOT &&
+                   binary->resolved.token.type != TokenType::DOT_DOT_EQUAL &&
+                   measure(binary->left.get(), candidate, size) && measure(binary->right.get(), candidate, size);
+        }
+        case NodeType::LogicalExpr: {
+            auto *logical = dynamic_cast<LogicalExpr *>(expr);
+            return measure(logical->left.get(), candidate, size) && measure(logical->right.get(), candidate, size);
+        }
+        case NodeType::TernaryExpr: {
+            auto *ternary = dynamic_cast<TernaryExpr *>(expr);
+            return measure(ternary->left.get(), candidate, size) && measure(ternary->middle.get(), candidate, size) &&
+                   measure(ternary->right.get(), candidate, size);
+        }
+        default: return false;
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+
+#ifndef INLINER_HPP
+#define INLINER_HPP
+
+#include "../AST.hpp"
+
+#include <ostream>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Decides which functions are small enough to have their calls replaced with the body of the function. Only functions
+// whose body is a single `return` of an expression made up of literals, parameters and operators on them are inlined,
+// so that the generator can compile the returned expression in place of the call, with every use of a parameter
+// replaced by the corresponding argument. Such functions cannot call anything, which also rules out recursion
+class Inliner {
+  public:
+    struct Candidate {
+        Expr *body{nullptr}; // The expression returned by the function
+        std::vector<std::size_t> param_uses{}; // The number of times each parameter is used in the body
+    };
+
+  private:
+    struct InlinedCall {
+        std::string_view function{};
+        std::string_view module{};
+        std::size_t line{};
+    };
+
+    static constexpr std::size_t max_body_size = 16; // The number of nodes in the expression
+
+    std::unordered_map<FunctionStmt *, Candidate> candidates{};
+    std::vector<InlinedCall> inlined{};
+
+    [[nodiscard]] static bool is_inlinable_type(const BaseType *type) noexcept;
+    [[nodiscard]] static bool measure(Expr *expr, Candidate &candidate, std::size_t &size);
+
+  public:
+    [[nodiscard]] const Candidate *candidate_for(FunctionStmt *function);
+    void record(std::string_view function, std::string_view module, std::size_t line);
+    void print_report(std::ostream &out) const;
+};
+
+#endif
@@ -0,0 +1,213 @@
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+#include "LoopEffects.hpp"
+
+void LoopEffects::mark_assigned(IdentifierType type, std::size_t stack_slot) {
+    if (type == IdentifierType::LOCAL) {
+        assigned_locals.insert(stack_slot);
+    } else if (type == IdentifierType::GLOBAL) {
+        assigned_globals.insert(stack_slot);
+    }
+}
+
+bool LoopEffects::is_assigned(IdentifierType type, std::size_t stack_slot) const {
+    if (type == IdentifierType::LOCAL) {
+        return assigned_locals.count(stack_slot) > 0;
+    }
+    // Any function called in the loop could be assigning to a global
+    return calls_functions || assigned_globals.count(stack_slot) > 0;
+}
+
+void LoopEffects::scan(Stmt *stmt) {
+    if (stmt == nullptr) {
+        return;
+    }
+
+    switch (stmt->type_tag()) {
+        case NodeType::BlockStmt:
+            for (auto &inner : dynamic_cast<BlockStmt *>(stmt)->stmts) {
+                scan(inner.get());
+            }
+            break;
+        case NodeType::BreakStmt:
+        case NodeType::ContinueStmt: break;
+        case NodeType::ExpressionStmt: scan(dynamic_cast<ExpressionStmt *>(stmt)->expr.get()); break;
+        case NodeType::ForEachStmt: {
+            auto *for_each = dynamic_cast<ForEachStmt *>(stmt);
+            scan(for_each->iterable.get());
+            scan(for_each->body.get());
+            break;
+        }
+        case NodeType::IfStmt: {
+            auto *if_ = dynamic_cast<IfStmt *>(stmt);
+            scan(if_->condition.get());
+            scan(if_->thenBranch.get());
+            scan(if_->elseBranch.get());
+            break;
+        }
+        case NodeType::ReturnStmt: scan(dynamic_cast<ReturnStmt *>(stmt)->value.get()); break;
+        case NodeType::SwitchStmt: {
+            auto *switch_ = dynamic_cast<SwitchStmt *>(stmt);
+            scan(switch_->condition.get());
+            for (auto &case_ : switch_->cases) {
+                scan(case_.first.get());
+                scan(case_.second.get());
+            }
+            scan(switch_->default_case.get());
+            break;
+        }
+        case NodeType::VarStmt: {
+            auto *var = dynamic_cast<VarStmt *>(stmt);
+            if (auto *list = dynamic_cast<ListType *>(var->type.get()); list != nullptr) {
+                scan(list->size.get());
+            }
+            scan(var->initializer.get());
+            break;
+        }
+        case NodeType::WhileStmt: {
+            auto *loop = dynamic_cast<WhileStmt *>(stmt);
+            scan(loop->condition.get());
+            scan(loop->body.get());
+            scan(loop->increment.get());
+            break;
+        }
+        default: unknown_effects = true; break;
+    }
+}
+
+void LoopEffects::scan(Expr *expr) {
+    if (expr == nullptr) {
+        return;
+    }
+
+    switch (expr->type_tag()) {
+        case NodeType::AssignExpr: {
+            auto *assign = dynamic_cast<AssignExpr *>(expr);
+            // The resolved type of an assignment is the type of its target
+            if (assign->resolved.info->is_ref) {
+                unknown_effects = true;
+            }
+            if (assign->resolved.info->primitive == Type::LIST) {
+                resizes_lists = true;
+            }
+            mark_assigned(assign->target_type, assign->resolved.stack_slot);
+            scan(assign->value.get());
+            break;
+        }
+        case NodeType::BinaryExpr: {
+            auto *binary = dynamic_cast<BinaryExpr *>(expr);
+            if ((binary->resolved.token.type == TokenType::LEFT_SHIFT ||
+                    binary->resolved.token.type == TokenType::RIGHT_SHIFT) &&
+                binary->left->resolved.info->primitive == Type::LIST) {
+                resizes_lists = true;
+            }
+            scan(binary->left.get());
+            scan(binary->right.get());
+            break;
+        }
+        case NodeType::CallExpr: {
+            auto *call = dynamic_cast<CallExpr *>(expr);
+            if (not call->is_native_call) {
+                calls_functions = true;
+                resizes_lists = true;
+            }
+            for (std::size_t i = 0; i < call->args.size(); i++) {
+                Expr *arg = std::get<ExprNode>(call->args[i]).get();
+                if (not call->is_native_call && call->function->resolved.func != nullptr &&
+                    call->function->resolved.func->params[i].second->is_ref) {
+                    // The function can assign to whatever is bound to the reference parameter
+                    if (arg->type_tag() == NodeType::VariableExpr && not arg->resolved.info->is_ref) {
+                        auto *variable = dynamic_cast<VariableExpr *>(arg);
+                        mark_assigned(variable->type, variable->resolved.stack_slot);
+                    } else {
+                        unknown_effects = true;
+                    }
+                }
+                scan(arg);
+            }
+            scan(call->function.get());
+            break;
+        }
+        case NodeType::CommaExpr:
+            for (auto &inner : dynamic_cast<CommaExpr *>(expr)->exprs) {
+                scan(inner.get());
+            }
+            break;
+        case NodeType::GetExpr: scan(dynamic_cast<GetExpr *>(expr)->object.get()); break;
+        case NodeType::GroupingExpr: scan(dynamic_cast<GroupingExpr *>(expr)->expr.get()); break;
+        case NodeType::IndexExpr: {
+            auto *index = dynamic_cast<IndexExpr *>(expr);
+            scan(index->object.get());
+            scan(index->index.get());
+            break;
+        }
+        case NodeType::ListExpr:
+            for (auto &element : dynamic_cast<ListExpr *>(expr)->elements) {
+                scan(std::get<ExprNode>(element).get());
+            }
+            break;
+        case NodeType::ListAssignExpr: {
+            auto *assign = dynamic_cast<ListAssignExpr *>(expr);
+            // Assigning to an element that is a reference writes to whatever it is bound to, and assigning a list to
+            // an element resizes any reference to that element
+            if (auto *list = dynamic_cast<ListType *>(assign->list.object->resolved.info);
+                list == nullptr || list->contained->is_ref) {
+                unknown_effects = true;
+            } else if (list->contained->primitive == Type::LIST) {
+                resizes_lists = true;
+            }
+            scan(assign->list.object.get());
+            scan(assign->list.index.get());
+            scan(assign->value.get());
+            break;
+        }
+        case NodeType::LiteralExpr:
+        case NodeType::ScopeAccessExpr:
+        case NodeType::ScopeNameExpr:
+        case NodeType::VariableExpr: break;
+        case NodeType::LogicalExpr: {
+            auto *logical = dynamic_cast<LogicalExpr *>(expr);
+            scan(logical->left.get());
+            scan(logical->right.get());
+            break;
+        }
+        case NodeType::TernaryExpr: {
+            auto *ternary = dynamic_cast<TernaryExpr *>(expr);
+            scan(ternary->left.get());
+            scan(ternary->middle.get());
+            scan(ternary->right.get());
+            break;
+        }
+        case NodeType::TupleExpr:
+            for (auto &element : dynamic_cast<TupleExpr *>(expr)->elements) {
+                scan(std::get<ExprNode>(element).get());
+            }
+            break;
+        case NodeType::UnaryExpr: {
+            auto *unary = dynamic_cast<UnaryExpr *>(expr);
+            if ((unary->oper.type == TokenType::PLUS_PLUS || unary->oper.type == TokenType::MINUS_MINUS) &&
+                unary->right->type_tag() == NodeType::VariableExpr) {
+                auto *variable = dynamic_cast<VariableExpr *>(unary->right.get());
+                if (variable->resolved.info->is_ref) {
+                    unknown_effects = true;
+                }
+                mark_assigned(variable->type, variable->resolved.stack_slot);
+            }
+            scan(unary->right.get());
+            break;
+        }
+        default: unknown_effects = true; break;
+    }
+}
+
+bool LoopEffects::has_calls() const noexcept {
+    return calls_functions;
+}
+
+bool LoopEffects::has_list_resizes() const noexcept {
+    return resizes_lists;
+}
+
+bool LoopEffects::has_unknown_effects() const noexcept {
+    return unknown_effects;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+
+#ifndef LOOP_EFFECTS_HPP
+#define LOOP_EFFECTS_HPP
+
+#include "../AST.hpp"
+
+#include <unordered_set>
+
+// Collects what the statements and expressions of a loop can change while it runs, conservatively: anything that is
+// not understood is recorded as an unknown effect, after which nothing about the loop should be assumed
+class LoopEffects {
+    std::unordered_set<std::size_t> assigned_locals{};
+    std::unordered_set<std::size_t> assigned_globals{};
+    bool calls_functions{false}; // Calls to functions that are not natives, which can modify any global
+    bool resizes_lists{false};   // Appending to, popping from or assigning lists
+    bool unknown_effects{false}; // Writes through references or statements that are not handled
+
+    void mark_assigned(IdentifierType type, std::size_t stack_slot);
+
+  public:
+    void scan(Stmt *stmt);
+    void scan(Expr *expr);
+
+    [[nodiscard]] bool is_assigned(IdentifierType type, std::size_t stack_slot) const;
+    [[nodiscard]] bool has_calls() const noexcept;
+    [[nodiscard]] bool has_list_resizes() const noexcept;
+    [[nodiscard]] bool has_unknown_effects() const noexcept;
+};
+
+#endif
@@ -0,0 +1,125 @@
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+#include "LoopInvariants.hpp"
+
+std::vector<Expr *> LoopInvariants::find(WhileStmt &loop) {
+    effects = LoopEffects{};
+    effects.scan(loop.condition.get());
+    effects.scan(loop.body.get());
+    effects.scan(loop.increment.get());
+
+    std::vector<Expr *> invariants{};
+    if (not effects.has_unknown_effects()) {
+        collect(loop.condition.get(), invariants);
+    }
+    hoisted_count += invariants.size();
+    return invariants;
+}
+
+std::size_t LoopInvariants::hoisted() const noexcept {
+    return hoisted_count;
+}
+
+bool LoopInvariants::is_invariant(Expr *expr) const {
+    switch (expr->type_tag()) {
+        case NodeType::LiteralExpr: return true;
+        case NodeType::VariableExpr: {
+            // Values of references can change through whatever they are bound to
+            auto *variable = dynamic_cast<VariableExpr *>(expr);
+            Type primitive = variable->resolved.info->primitive;
+            return not variable->resolved.info->is_ref &&
+                   (primitive == Type::INT || primitive == Type::FLOAT || primitive == Type::BOOL ||
+                       primitive == Type::STRING) &&
+                   (variable->type == IdentifierType::LOCAL || variable->type == IdentifierType::GLOBAL) &&
+                   not effects.is_assigned(variable->type, variable->resolved.stack_slot);
+        }
+        case NodeType::CallExpr: {
+            auto *call = dynamic_cast<CallExpr *>(expr);
+            if (not call->is_native_call || call->args.size() != 1 ||
+                call->function->type_tag() != NodeType::VariableExpr ||
+                dynamic_cast<VariableExpr *>(call->function.get())->name.lexeme != "size") {
+                return false;
+            }
+
+            Expr *arg = std::get<ExprNode>(call->args[0]).get();
+            if (arg->type_tag() != NodeType::VariableExpr) {
+                return false;
+            }
+            auto *variable = dynamic_cast<VariableExpr *>(arg);
+            if (variable->resolved.info->primitive == Type::LIST) {
+                return not effects.has_list_resizes() &&
+                       not effects.is_assigned(variable->type, variable->resolved.stack_slot);
+            }
+            return is_invariant(variable);
+        }
+        case NodeType::GroupingExpr: return is_invariant(dynamic_cast<GroupingExpr *>(expr)->expr.get());
+        case NodeType::UnaryExpr: {
+            auto *unary = dynamic_cast<UnaryExpr *>(expr);
+            return unary->oper.type != TokenType::PLUS_PLUS && unary->oper.type != TokenType::MINUS_MINUS &&
+                   is_invariant(unary->right.get());
+        }
+        case NodeType::BinaryExpr: {
+            // Division and shifts can raise errors, which would be raised before the loop instead of in it
+            auto *binary = dynamic_cast<BinaryExpr *>(expr);
+            switch (binary->resolved.token.type) {
+                case TokenType::SLASH:
+                case TokenType::MODULO:
+                case TokenType::LEFT_SHIFT:
+                case TokenType::RIGHT_SHIFT:
+                case TokenType::DOT_DOT:
+                case TokenType::DOT_DOT_EQUAL: return false;
+                default: return is_invariant(binary->left.get()) && is_invariant(binary->right.get());
+            }
+        }
+        case NodeType::LogicalExpr: {
+            auto *logical = dynamic_cast<LogicalExpr *>(expr);
+            return is_invariant(logical->left.get()) && is_invariant(logical->right.get());
+        }
+        case NodeType::TernaryExpr: {
+            auto *ternary = dynamic_cast<TernaryExpr *>(expr);
+            return is_invariant(ternary->left.get()) && is_invariant(ternary->middle.get()) &&
+                   is_invariant(ternary->right.get());
+        }
+        default: return false;
+    }
+}
+
+void LoopInvariants::collect(Expr *expr, std::vector<Expr *> &invariants) const {
+    Expr *inner = expr;
+    while (inner->type_tag() == NodeType::GroupingExpr) {
+        inner = dynamic_cast<GroupingExpr *>(inner)->expr.get();
+    }
+    // Hoisting a literal or a variable would only replace one access with another. The hoisted value is kept in a
+    // stack slot that is popped with POP, so only values which do not own any memory are hoisted
+    Type primitive = expr->resolved.info->primitive;
+    if (inner->type_tag() != NodeType::LiteralExpr && inner->type_tag() != NodeType::VariableExpr &&
+        not expr->resolved.info->is_ref &&
+        (primitive == Type::INT || primitive == Type::FLOAT || primitive == Type::BOOL) && is_invariant(expr)) {
+        invariants.push_back(expr);
+        return;
+    }
+
+    switch (inner->type_tag()) {
+        case NodeType::UnaryExpr: collect(dynamic_cast<UnaryExpr *>(inner)->right.get(), invariants); break;
+        case NodeType::BinaryExpr: {
+            auto *binary = dynamic_cast<BinaryExpr *>(inner);
+            collect(binary->left.get(), invariants);
+            collect(binary->right.get(), invariants);
+            break;
+        }
+        case NodeType::LogicalExpr: {
+            auto *logical = dynamic_cast<LogicalExpr *>(inner);
+            collect(logical->left.get(), invariants);
+            collect(logical->right.get(), invariants);
+            break;
+        }
+        case NodeType::TernaryExpr: {
+            auto *ternary = dynamic_cast<TernaryExpr *>(inner);
+            collect(ternary->left.get(), invariants);
+            collect(ternary->middle.get(), invariants);
+            collect(ternary->right.get(), invariants);
+            break;
+        }
+        default: break;
+    }
+}
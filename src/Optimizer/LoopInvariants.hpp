@@ -0,0 +1,31 @@
+#pragma once
+
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+
+#ifndef LOOP_INVARIANTS_HPP
+#define LOOP_INVARIANTS_HPP
+
+#include "../AST.hpp"
+#include "LoopEffects.hpp"
+
+#include <vector>
+
+// Finds the parts of the condition of a while loop that evaluate to the same value on every iteration, so that the
+// generator can compute them once before the loop instead of every time the condition is checked. Only expressions
+// without side effects or runtime errors are considered: operators on variables that the loop never writes to, and
+// calls to size() on lists that cannot change size while the loop runs
+class LoopInvariants {
+    LoopEffects effects{}; // The effects of the loop currently being looked at
+    std::size_t hoisted_count{};
+
+    [[nodiscard]] bool is_invariant(Expr *expr) const;
+    void collect(Expr *expr, std::vector<Expr *> &invariants) const;
+
+  public:
+    // Returns the largest invariant subexpressions of the condition, in the order they appear in it
+    [[nodiscard]] std::vector<Expr *> find(WhileStmt &loop);
+    [[nodiscard]] std::size_t hoisted() const noexcept;
+};
+
+#endif
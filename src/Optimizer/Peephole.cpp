@@ -0,0 +1,235 @@
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+#include "Peephole.hpp"
+
+#include "../VirtualMachine/Value.hpp"
+
+std::size_t PeepholeOptimizer::optimize(Chunk &chunk) {
+    decode(chunk);
+    std::size_t removed_before = removed_count;
+
+    bool modified = false;
+    bool changed = true;
+    while (changed) {
+        changed = thread_jumps();
+        changed = rewrite_sequences() || changed;
+        modified = modified || changed;
+    }
+
+    if (modified) {
+        encode(chunk);
+    }
+    code.clear();
+    return removed_count - removed_before;
+}
+
+std::size_t PeepholeOptimizer::removed() const noexcept {
+    return removed_count;
+}
+
+bool PeepholeOptimizer::is_forward_jump(Instruction instruction) noexcept {
+    switch (instruction) {
+        case Instruction::JUMP_FORWARD:
+        case Instruction::JUMP_IF_TRUE:
+        case Instruction::JUMP_IF_FALSE:
+        case Instruction::POP_JUMP_IF_EQUAL:
+        case Instruction::POP_JUMP_IF_FALSE:
+        case Instruction::POP_JUMP_IF_TRUE: return true;
+        default: return false;
+    }
+}
+
+bool PeepholeOptimizer::is_backward_jump(Instruction instruction) noexcept {
+    switch (instruction) {
+        case Instruction::JUMP_BACKWARD:
+        case Instruction::POP_JUMP_BACK_IF_TRUE:
+        case Instruction::FOR_ITER: return true;
+        default: return false;
+    }
+}
+
+bool PeepholeOptimizer::is_jump(Instruction instruction) noexcept {
+    return is_forward_jump(instruction) || is_backward_jump(instruction);
+}
+
+void PeepholeOptimizer::decode(const Chunk &chunk) {
+    code.clear();
+    code.reserve(chunk.bytes.size());
+    for (std::size_t i = 0; i < chunk.bytes.size(); i++) {
+        Insn insn{static_cast<Instruction>(chunk.bytes[i] >> 24), chunk.bytes[i] & 0x00ff'ffff};
+        // Forward jumps are relative to the instruction after the jump, backward jumps are the same but are also one
+        // more than the distance they jump (see Generator::visit(WhileStmt &))
+        if (is_forward_jump(insn.instruction)) {
+            insn.operand = i + 1 + insn.operand;
+        } else if (is_backward_jump(insn.instruction)) {
+            insn.operand = i + 1 - insn.operand;
+        }
+        code.push_back(insn);
+    }
+
+    std::size_t i = 0;
+    for (auto [line, count] : chunk.line_numbers) {
+        for (; count > 0 && i < code.size(); count--) {
+            code[i++].line = line;
+        }
+    }
+}
+
+void PeepholeOptimizer::encode(Chunk &chunk) {
+    // A removed instruction has the same index as the first instruction following it that is kept, so jumping to it
+    // is the same as jumping to that instruction
+    std::vector<std::size_t> new_index(code.size() + 1);
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < code.size(); i++) {
+        new_index[i] = kept;
+        if (not code[i].removed) {
+            kept++;
+        }
+    }
+    new_index[code.size()] = kept;
+
+    chunk.bytes.clear();
+    chunk.line_numbers.clear();
+    for (std::size_t i = 0; i < code.size(); i++) {
+        if (code[i].removed) {
+            continue;
+        }
+
+        std::size_t operand = code[i].operand;
+        if (is_forward_jump(code[i].instruction)) {
+            operand = new_index[operand] - new_index[i] - 1;
+        } else if (is_backward_jump(code[i].instruction)) {
+            operand = new_index[i] + 1 - new_index[operand];
+        }
+        chunk.emit_instruction(code[i].instruction, code[i].line);
+        chunk.bytes.back() |= operand & 0x00ff'ffff;
+    }
+}
+
+std::size_t PeepholeOptimizer::next_live(std::size_t index) const noexcept {
+    while (index < code.size() && code[index].removed) {
+        index++;
+    }
+    return index;
+}
+
+void PeepholeOptimizer::find_targets() {
+    is_target.assign(code.size() + 1, false);
+    for (const Insn &insn : code) {
+        if (not insn.removed && is_jump(insn.instruction)) {
+            is_target[next_live(insn.operand)] = true;
+        }
+    }
+}
+
+void PeepholeOptimizer::remove(std::size_t index) {
+    code[index].removed = true;
+    removed_count++;
+}
+
+bool PeepholeOptimizer::thread_jumps() {
+    auto is_unconditional = [this](std::size_t index) {
+        return index < code.size() && (code[index].instruction == Instruction::JUMP_FORWARD ||
+                                          code[index].instruction == Instruction::JUMP_BACKWARD);
+    };
+
+    bool changed = false;
+    for (std::size_t i = next_live(0); i < code.size(); i = next_live(i + 1)) {
+        if (not is_jump(code[i].instruction)) {
+            continue;
+        }
+
+        // Follow the chain of unconditional jumps to its end, giving up on chains that loop back on themselves
+        std::size_t target = next_live(code[i].operand);
+        std::size_t hops = 0;
+        while (is_unconditional(target) && hops <= code.size()) {
+            target = next_live(code[target].operand);
+            hops++;
+        }
+        if (hops == 0 || hops > code.size()) {
+            continue;
+        }
+
+        bool forward = target > i;
+        if ((forward ? target - i : i - target) >= Chunk::const_long_max) {
+            continue;
+        } else if (is_unconditional(i)) {
+            code[i].instruction = forward ? Instruction::JUMP_FORWARD : Instruction::JUMP_BACKWARD;
+        } else if (forward != is_forward_jump(code[i].instruction)) {
+            // Conditional jumps can only go in one direction
+            continue;
+        }
+
+        code[i].operand = target;
+        changed = true;
+    }
+    return changed;
+}
+
+bool PeepholeOptimizer::rewrite_sequences() {
+    bool changed = false;
+    find_targets();
+    // The instructions after the first one in a sequence cannot be rewritten if a jump lands on them, since that would
+    // change what happens when the jump is taken
+    for (std::size_t i = next_live(0); i < code.size(); i = next_live(i + 1)) {
+        Insn &first = code[i];
+        std::size_t second_idx = next_live(i + 1);
+
+        if ((first.instruction == Instruction::JUMP_FORWARD || first.instruction == Instruction::JUMP_BACKWARD ||
+                first.instruction == Instruction::JUMP_IF_TRUE || first.instruction == Instruction::JUMP_IF_FALSE) &&
+            next_live(first.operand) == second_idx) {
+            // JUMP_FORWARD 0 or any other jump that does not pop and only goes to the next instruction
+            remove(i);
+            find_targets();
+            changed = true;
+            continue;
+        }
+
+        if (second_idx >= code.size() || is_target[second_idx]) {
+            continue;
+        }
+
+        Insn &second = code[second_idx];
+        if ((first.instruction == Instruction::PUSH_TRUE || first.instruction == Instruction::PUSH_FALSE) &&
+            (second.instruction == Instruction::POP_JUMP_IF_FALSE ||
+                second.instruction == Instruction::POP_JUMP_IF_TRUE ||
+                second.instruction == Instruction::POP_JUMP_BACK_IF_TRUE)) {
+            // PUSH_TRUE, POP_JUMP_IF_FALSE -> (nothing)
+            // PUSH_FALSE, POP_JUMP_IF_FALSE -> JUMP_FORWARD
+            bool pushed = first.instruction == Instruction::PUSH_TRUE;
+            bool jumps_if = second.instruction != Instruction::POP_JUMP_IF_FALSE;
+            remove(i);
+            if (pushed == jumps_if) {
+                second.instruction = is_forward_jump(second.instruction) ? Instruction::JUMP_FORWARD
+                                                                         : Instruction::JUMP_BACKWARD;
+            } else {
+                remove(second_idx);
+            }
+        } else if (first.instruction == Instruction::NOT && (second.instruction == Instruction::POP_JUMP_IF_FALSE ||
+                                                                second.instruction == Instruction::POP_JUMP_IF_TRUE)) {
+            // NOT, POP_JUMP_IF_FALSE -> POP_JUMP_IF_TRUE
+            remove(i);
+            second.instruction = second.instruction == Instruction::POP_JUMP_IF_FALSE ? Instruction::POP_JUMP_IF_TRUE
+                                                                                      : Instruction::POP_JUMP_IF_FALSE;
+        } else if (((first.instruction == Instruction::ACCESS_LOCAL &&
+                        second.instruction == Instruction::ASSIGN_LOCAL) ||
+                       (first.instruction == Instruction::ACCESS_GLOBAL &&
+                           second.instruction == Instruction::ASSIGN_GLOBAL)) &&
+                   first.operand == second.operand) {
+            // ACCESS_LOCAL x, ASSIGN_LOCAL x, POP -> (nothing)
+            std::size_t third_idx = next_live(second_idx + 1);
+            if (third_idx >= code.size() || is_target[third_idx] || code[third_idx].instruction != Instruction::POP) {
+                continue;
+            }
+            remove(i);
+            remove(second_idx);
+            remove(third_idx);
+        } else {
+            continue;
+        }
+
+        find_targets();
+        changed = true;
+    }
+    return changed;
+}
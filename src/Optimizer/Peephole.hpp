@@ -0,0 +1,47 @@
+#pragma once
+
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+
+#ifndef PEEPHOLE_HPP
+#define PEEPHOLE_HPP
+
+#include "../VirtualMachine/Chunk.hpp"
+
+#include <vector>
+
+// Runs on a chunk once it has been completely generated. Short sequences of instructions that do nothing or that can
+// be done with fewer instructions are rewritten, and jumps to unconditional jumps are threaded through to their final
+// destination. Jump offsets and the line number table of the chunk are recomputed afterwards
+class PeepholeOptimizer {
+    struct Insn {
+        Instruction instruction{};
+        std::size_t operand{}; // For jumps, this is the index of the instruction being jumped to
+        std::size_t line{};
+        bool removed{false};
+    };
+
+    std::vector<Insn> code{};
+    std::vector<bool> is_target{};
+    std::size_t removed_count{};
+
+    [[nodiscard]] static bool is_forward_jump(Instruction instruction) noexcept;
+    [[nodiscard]] static bool is_backward_jump(Instruction instruction) noexcept;
+    [[nodiscard]] static bool is_jump(Instruction instruction) noexcept;
+
+    void decode(const Chunk &chunk);
+    void encode(Chunk &chunk);
+
+    [[nodiscard]] std::size_t next_live(std::size_t index) const noexcept;
+    void find_targets();
+    void remove(std::size_t index);
+
+    bool thread_jumps();
+    bool rewrite_sequences();
+
+  public:
+    std::size_t optimize(Chunk &chunk);
+    [[nodiscard]] std::size_t removed() const noexcept;
+};
+
+#endif
@@ -0,0 +1,193 @@
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+#include "ModuleLoader.hpp"
+
+#include "../ErrorLogger/ErrorLogger.hpp"
+#include "../Scanner/Scanner.hpp"
+#include "../VirtualMachine/Value.hpp"
+#include "Parser.hpp"
+#include "TypeResolver.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+namespace {
+// Points the logger of the current thread at a module for as long as it is in scope, with the messages for the module
+// being collected instead of printed
+struct ModuleLogger {
+    ErrorLogger previous{logger};
+    std::ostringstream messages{};
+
+    explicit ModuleLogger(const Module &module) {
+        logger = ErrorLogger{};
+        logger.set_source(module.text.front());
+        logger.set_module_name(module.name);
+        logger.set_output(messages);
+    }
+
+    ~ModuleLogger() { logger = previous; }
+
+    ModuleLogger(const ModuleLogger &) = delete;
+    ModuleLogger &operator=(const ModuleLogger &) = delete;
+
+    void finish(std::string &collected, bool &had_error) {
+        collected += messages.str();
+        had_error = had_error || logger.had_error;
+    }
+};
+} // namespace
+
+ModuleLoader::ModuleLoader(std::size_t threads) : pool{threads} {}
+
+void ModuleLoader::load(Module &main) {
+    std::string main_messages{};
+    bool main_had_error{false};
+    {
+        ModuleLogger main_logger{main};
+        Scanner scanner{main.text.front(), main.text};
+        Parser parser{scanner.scan(), main};
+        main.statements = parser.program();
+        main_logger.finish(main_messages, main_had_error);
+    }
+
+    add_imports(main);
+    pool.wait();
+    order_modules(main);
+    type_check();
+    print_messages();
+
+    // The main module is checked last, once everything it could refer to has been
+    *logger.output << main_messages;
+    logger.had_error = logger.had_error || main_had_error;
+    TypeResolver resolver{main, modules};
+    resolver.check(main.statements);
+}
+
+void ModuleLoader::parse(std::size_t index) {
+    Loading *entry{};
+    {
+        std::lock_guard lock{mutex};
+        entry = &loading[index];
+    }
+
+    Module &module = entry->module;
+    std::ifstream file{module.path, std::ios::in};
+    module.store(std::string{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}});
+
+    ModuleLogger module_logger{module};
+    Scanner scanner{module.text.front(), module.text};
+    Parser parser{scanner.scan(), module};
+    module.statements = parser.program();
+    module_logger.finish(entry->messages, entry->had_error);
+
+    add_imports(module);
+}
+
+void ModuleLoader::add_imports(Module &module) {
+    std::lock_guard lock{mutex};
+    for (const Module::Import &import : module.imports) {
+        // Modules are told apart by their names, so a module imported from several places is only loaded once
+        auto [it, inserted] = indexes.try_emplace(import.name, loading.size());
+        if (inserted) {
+            Loading &added = loading.emplace_back(Module{import.name, import.directory});
+            added.module.path = import.path;
+            pool.submit([this, index = it->second] { parse(index); });
+        }
+        module.imported.push_back(it->second);
+    }
+}
+
+void ModuleLoader::order_modules(Module &main) {
+    // The modules are put in the order in which they would finish loading if every import statement loaded its module
+    // right away, which keeps everything after this independent of the order the threads happened to find them in
+    std::vector<char> visiting(loading.size(), false);
+    std::vector<char> visited(loading.size(), false);
+    auto visit = [this, &visiting, &visited](auto &self, Module &module, Loading *entry) -> void {
+        for (auto it = module.imported.begin(); it != module.imported.end();) {
+            std::size_t index = *it;
+            if (visiting[index]) {
+                ModuleLogger module_logger{module};
+                compile_error({"Module '", loading[index].module.name, "' is imported in a cycle"});
+                logger.had_error = true;
+                module_logger.finish(entry->messages, entry->had_error);
+                it = module.imported.erase(it);
+                continue;
+            } else if (not visited[index]) {
+                visiting[index] = true;
+                self(self, loading[index].module, &loading[index]);
+                visiting[index] = false;
+                visited[index] = true;
+                order.push_back(index);
+            }
+            it++;
+        }
+    };
+    // The main module cannot be a part of a cycle, as it is never imported under its own name
+    visit(visit, main, nullptr);
+
+    std::vector<std::size_t> new_indexes(loading.size());
+    for (std::size_t i{0}; i < order.size(); i++) {
+        new_indexes[order[i]] = i;
+    }
+
+    auto renumber = [&new_indexes](Module &module) {
+        for (std::size_t &index : module.imported) {
+            index = new_indexes[index];
+        }
+    };
+    renumber(main);
+    modules.reserve(order.size());
+    for (std::size_t index : order) {
+        renumber(loading[index].module);
+        modules.emplace_back(std::move(loading[index].module), 0);
+    }
+
+    // A module is as deep as the longest chain of imports that leads to it from the main module. Every module comes
+    // after the ones it imports, so going backwards sees all the modules that import a module before the module itself
+    for (std::size_t index : main.imported) {
+        modules[index].second = 1;
+    }
+    for (std::size_t i{modules.size()}; i-- > 0;) {
+        for (std::size_t index : modules[i].first.imported) {
+            modules[index].second = std::max(modules[index].second, modules[i].second + 1);
+        }
+    }
+}
+
+void ModuleLoader::type_check() {
+    // The modules that import nothing are in the first level, and every other module is one level above the highest of
+    // the modules that it imports
+    std::vector<std::size_t> levels(modules.size(), 0);
+    std::size_t level_count{0};
+    for (std::size_t i{0}; i < modules.size(); i++) {
+        for (std::size_t index : modules[i].first.imported) {
+            levels[i] = std::max(levels[i], levels[index] + 1);
+        }
+        level_count = std::max(level_count, levels[i] + 1);
+    }
+
+    for (std::size_t level{0}; level < level_count; level++) {
+        for (std::size_t i{0}; i < modules.size(); i++) {
+            if (levels[i] == level) {
+                pool.submit([this, i] {
+                    Loading &entry = loading[order[i]];
+                    Module &module = modules[i].first;
+                    ModuleLogger module_logger{module};
+                    TypeResolver resolver{module, modules};
+                    resolver.check(module.statements);
+                    module_logger.finish(entry.messages, entry.had_error);
+                });
+            }
+        }
+        pool.wait();
+    }
+}
+
+void ModuleLoader::print_messages() {
+    for (std::size_t index : order) {
+        *logger.output << loading[index].messages;
+        logger.had_error = logger.had_error || loading[index].had_error;
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+
+#ifndef MODULE_LOADER_HPP
+#define MODULE_LOADER_HPP
+
+#include "../ThreadPool.hpp"
+#include "../VirtualMachine/Module.hpp"
+
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Loads the main module and everything it imports, directly or not. A module is read, scanned and parsed on the thread
+// pool as soon as the first module that imports it has been parsed, so independent modules are parsed at the same time.
+// Once all of them are known, they are type checked a level at a time: a module is only checked after everything it
+// imports has been, and the modules in a level are checked at the same time.
+//
+// Every module is given a logger of its own while it is loaded, and the messages collected for it are printed once all
+// of the imported modules are done, in the same order as when the modules were loaded one after the other
+class ModuleLoader {
+    struct Loading {
+        Module module;
+        std::string messages{};
+        bool had_error{false};
+
+        explicit Loading(Module module) : module{std::move(module)} {}
+    };
+
+    ThreadPool pool;
+    std::mutex mutex{};
+    std::deque<Loading> loading{}; // In the order the modules were found in, which depends on the threads
+    std::unordered_map<std::string, std::size_t> indexes{};
+    std::vector<std::pair<Module, std::size_t>> modules{}; // The module and its depth in the import graph
+    std::vector<std::size_t> order{}; // The index in `loading` of each of the modules
+
+    void parse(std::size_t index);
+    void add_imports(Module &module);
+    void order_modules(Module &main);
+    void type_check();
+    void print_messages();
+
+  public:
+    // Zero threads means one for every core
+    explicit ModuleLoader(std::size_t threads);
+
+    void load(Module &main);
+
+    // The imported modules, where a module always comes after the ones it imports
+    [[nodiscard]] std::vector<std::pair<Module, std::size_t>> &get_modules() noexcept { return modules; }
+};
+
+#endif
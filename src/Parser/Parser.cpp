@@ -4,9 +4,7 @@
 
 #include "../Common.hpp"
 #include "../ErrorLogger/ErrorLogger.hpp"
-#include "../Scanner/Scanner.hpp"
 #include "../VirtualMachine/Value.hpp"
-#include "TypeResolver.hpp"
 
 #include <algorithm>
 #include <array>
@@ -16,8 +14,6 @@
 #include <type_traits>
 #include <utility>
 
-std::vector<std::pair<Module, std::size_t>> Parser::parsed_modules{};
-
 struct ParseException : public std::invalid_argument {
     Token token{};
     explicit ParseException(Token token, const std::string_view error)
@@ -100,8 +96,7 @@ void Parser::synchronize() {
     }
 }
 
-Parser::Parser(const std::vector<Token> &tokens, Module &module, std::size_t current_depth)
-    : tokens{tokens}, current_module{module}, current_module_depth{current_depth} {
+Parser::Parser(const std::vector<Token> &tokens, Module &module) : tokens{tokens}, current_module{module} {
     // clang-format off
     add_rule(TokenType::COMMA,         {nullptr, &Parser::comma, ParsePrecedence::of::COMMA});
     add_rule(TokenType::EQUAL,         {nullptr, nullptr, ParsePrecedence::of::NONE});
@@ -160,6 +155,7 @@ Parser::Parser(const std::vector<Token> &tokens, Module &module, std::size_t cur
     add_rule(TokenType::FOR,           {nullptr, nullptr, ParsePrecedence::of::NONE});
     add_rule(TokenType::IF,            {nullptr, nullptr, ParsePrecedence::of::NONE});
     add_rule(TokenType::IMPORT,        {nullptr, nullptr, ParsePrecedence::of::NONE});
+    add_rule(TokenType::IN,            {nullptr, nullptr, ParsePrecedence::of::NONE});
     add_rule(TokenType::INT,           {&Parser::variable, nullptr, ParsePrecedence::of::NONE});
     add_rule(TokenType::NULL_,         {nullptr, nullptr, ParsePrecedence::of::NONE});
     add_rule(TokenType::OR,            {nullptr, &Parser::or_, ParsePrecedence::of::LOGIC_OR});
@@ -238,6 +234,7 @@ void Parser::consume(std::string_view message, const Token &where, Args... args)
 }
 
 std::vector<StmtNode> Parser::program() {
+    NodeArena::Scope arena{current_module.nodes};
     std::vector<StmtNode> statements;
 
     while (peek().type != TokenType::END_OF_FILE && peek().type != TokenType::END_OF_LINE) {
@@ -248,7 +245,9 @@ std::vector<StmtNode> Parser::program() {
         advance();
     }
 
-    consume("Expected EOF at the end of file", TokenType::END_OF_FILE);
+    try {
+        consume("Expected EOF at the end of file", TokenType::END_OF_FILE);
+    } catch (const ParseException &) {}
     return statements;
 }
 
@@ -263,7 +262,7 @@ ExprNode Parser::parse_precedence(ParsePrecedence::of precedence) {
             if (previous().type == TokenType::END_OF_LINE) {
                 return "\\n' (newline)"s;
             } else {
-                return previous().lexeme + "'";
+                return std::string{previous().lexeme} + "'";
             }
         }();
         bool had_error_before = logger.had_error;
@@ -280,7 +279,7 @@ ExprNode Parser::parse_precedence(ParsePrecedence::of precedence) {
     while (precedence <= get_rule(peek().type).precedence) {
         ExprInfixParseFn infix = get_rule(advance().type).infix;
         if (infix == nullptr) {
-            error({"'", previous().lexeme, "' cannot occur in an infix/postfix expression"}, previous());
+            error({"'", std::string{previous().lexeme}, "' cannot occur in an infix/postfix expression"}, previous());
             if (previous().type == TokenType::PLUS_PLUS) {
                 note({"Postfix increment is not supported"});
             } else if (previous().type == TokenType::MINUS_MINUS) {
@@ -357,8 +356,8 @@ ExprNode Parser::dot(bool can_assign, ExprNode left) {
     // Thus, split the floating literal into its components (`2`, `.`, `0`) and use those components while parsing
     std::vector<Token> components{};
     if (peek().type == TokenType::FLOAT_VALUE) {
-        std::string num = peek().lexeme;
-        if (num.find('.') == std::string::npos) {
+        std::string_view num = peek().lexeme;
+        if (num.find('.') == std::string_view::npos) {
             error({"Use of float literal in member access"}, peek());
             advance();
             throw_parse_error("Use of float literal in member access", previous());
@@ -459,17 +458,17 @@ ExprNode Parser::literal(bool) {
     node->resolved.token = previous();
     switch (previous().type) {
         case TokenType::INT_VALUE: {
-            node->value = LiteralValue{std::stoi(previous().lexeme)};
+            node->value = LiteralValue{std::stoi(std::string{previous().lexeme})};
             break;
         }
         case TokenType::FLOAT_VALUE: {
-            node->value = LiteralValue{std::stod(previous().lexeme)};
+            node->value = LiteralValue{std::stod(std::string{previous().lexeme})};
             node->type->primitive = Type::FLOAT;
             break;
         }
         case TokenType::STRING_VALUE: {
             node->type->primitive = Type::STRING;
-            node->value = LiteralValue{previous().lexeme};
+            node->value = LiteralValue{std::string{previous().lexeme}};
             while (match(TokenType::STRING_VALUE)) {
                 node->value.to_string() += previous().lexeme;
             }
@@ -697,7 +696,7 @@ StmtNode Parser::class_declaration() {
 
         if (match(TokenType::VAR, TokenType::CONST, TokenType::REF)) {
             try {
-                std::unique_ptr<VarStmt> member{dynamic_cast<VarStmt *>(variable_declaration().release())};
+                NodeHandle<VarStmt> member{dynamic_cast<VarStmt *>(variable_declaration().release())};
                 members.emplace_back(std::move(member), visibility);
             } catch (...) { synchronize(); }
         } else if (match(TokenType::FN)) {
@@ -708,14 +707,13 @@ StmtNode Parser::class_declaration() {
                     throw_parse_error("The name of the destructor has to be the same as the name of the class");
                 }
 
-                std::unique_ptr<FunctionStmt> method{dynamic_cast<FunctionStmt *>(function_declaration().release())};
+                NodeHandle<FunctionStmt> method{dynamic_cast<FunctionStmt *>(function_declaration().release())};
                 const Token &method_name = method->name;
 
                 if (method_name.lexeme == name.lexeme) {
                     if (found_dtor && dtor == nullptr) {
-                        using namespace std::string_literals;
                         dtor = method.get();
-                        dtor->name.lexeme = "~"s + dtor->name.lexeme; // Turning Foo into ~Foo
+                        dtor->name.lexeme = current_module.store("~" + std::string{dtor->name.lexeme}); // Foo -> ~Foo
                     } else if (ctor == nullptr) {
                         ctor = method.get();
                     } else {
@@ -797,64 +795,30 @@ StmtNode Parser::function_declaration() {
     return StmtNode{function_definition};
 }
 
-void recursively_change_module_depth(std::pair<Module, std::size_t> &module, std::size_t value) {
-    module.second = value;
-    for (std::size_t imported : module.first.imported) {
-        recursively_change_module_depth(Parser::parsed_modules[imported], value + 1);
-    }
-}
-
 StmtNode Parser::import_statement() {
-    Token keyword = previous();
     consume("Expected path to module after 'import' keyword", TokenType::STRING_VALUE);
     Token imported = previous();
     consume("Expected ';' or newline after imported file", previous(), TokenType::SEMICOLON, TokenType::END_OF_LINE);
 
-    std::string imported_dir = imported.lexeme[0] == '/' ? "" : current_module.module_directory;
+    std::string imported_dir =
+        not imported.lexeme.empty() && imported.lexeme[0] == '/' ? "" : current_module.module_directory;
+    std::string imported_path = imported_dir + std::string{imported.lexeme};
 
-    std::ifstream module{imported_dir + imported.lexeme, std::ios::in};
     std::size_t name_index = imported.lexeme.find_last_of('/');
-    std::string module_name = imported.lexeme.substr(name_index != std::string::npos ? name_index + 1 : 0);
-    if (not module.is_open()) {
+    std::string module_name{imported.lexeme.substr(name_index != std::string_view::npos ? name_index + 1 : 0)};
+    if (not std::ifstream{imported_path, std::ios::in}.is_open()) {
         error({"Unable to open module '", module_name, "'"}, imported);
         return {nullptr};
     }
 
     if (module_name == current_module.name) {
         error({"Cannot import module with the same name as the current one"}, imported);
-    }
-
-    std::string module_source{std::istreambuf_iterator<char>{module}, std::istreambuf_iterator<char>{}};
-    Module imported_module{module_name, imported_dir};
-    std::string_view logger_source{logger.source};
-    std::string_view logger_module_name{logger.module_name};
-
-    auto it = std::find_if(parsed_modules.begin(), parsed_modules.end(),
-        [&module_name](const std::pair<Module, std::size_t> &pair) { return module_name == pair.first.name; });
-
-    // Avoid parsing a module if its already imported
-    if (it != parsed_modules.end()) {
-        if (it->second < (current_module_depth + 1)) {
-            recursively_change_module_depth(*it, current_module_depth + 1);
-        }
-        current_module.imported.push_back(it - parsed_modules.begin());
         return {nullptr};
     }
 
-    try {
-        logger.set_source(module_source);
-        logger.set_module_name(module_name);
-        Scanner scanner{module_source};
-        Parser parser{scanner.scan(), imported_module, current_module_depth + 1};
-        imported_module.statements = parser.program();
-        TypeResolver resolver{imported_module};
-        resolver.check(imported_module.statements);
-    } catch (const ParseException &) {}
-
-    logger.set_source(logger_source);
-    logger.set_module_name(logger_module_name);
-    parsed_modules.emplace_back(std::move(imported_module), current_module_depth + 1);
-    current_module.imported.push_back(parsed_modules.size() - 1);
+    // The module is only read, parsed and type checked later on by the module loader, which may do so on another
+    // thread while the rest of the modules are being parsed
+    current_module.imports.push_back({std::move(imported_path), std::move(module_name), std::move(imported_dir)});
     return {nullptr};
 }
 
@@ -957,6 +921,9 @@ StmtNode Parser::expression_statement() {
 
 StmtNode Parser::for_statement() {
     Token keyword = previous();
+    if (match(TokenType::IDENTIFIER)) {
+        return for_each_statement(std::move(keyword));
+    }
     consume("Expected '(' after 'for' keyword", TokenType::LEFT_PAREN);
     ScopedIntegerManager manager{scope_depth};
 
@@ -987,7 +954,7 @@ StmtNode Parser::for_statement() {
 
     consume("Expected '{' after for-loop header", TokenType::LEFT_BRACE);
     StmtNode desugared_loop = StmtNode{
-        allocate_node(WhileStmt, std::move(keyword), std::move(condition), block_statement(), std::move(increment))};
+        allocate_node(WhileStmt, std::move(keyword), std::move(condition), block_statement(), std::move(increment), 0)};
     // The increment is only created for for-loops, so that the `continue` statement works properly.
 
     auto *loop = allocate_node(BlockStmt, {});
@@ -997,6 +964,23 @@ StmtNode Parser::for_statement() {
     return StmtNode{loop};
 }
 
+StmtNode Parser::for_each_statement(Token keyword) {
+    Token name = previous();
+    consume("Expected 'in' after loop variable of for-each loop", TokenType::IN);
+    ExprNode iterable = expression();
+
+    while (peek().type == TokenType::END_OF_LINE) {
+        advance();
+    }
+
+    ScopedBooleanManager loop_manager{in_loop};
+    consume("Expected '{' after for-each loop header", TokenType::LEFT_BRACE);
+    StmtNode body = block_statement();
+
+    return StmtNode{allocate_node(
+        ForEachStmt, std::move(keyword), std::move(name), std::move(iterable), std::move(body), nullptr)};
+}
+
 StmtNode Parser::if_statement() {
     Token keyword = previous();
     ExprNode condition = expression();
@@ -1087,5 +1071,5 @@ StmtNode Parser::while_statement() {
     consume("Expected '{' after while-loop header", TokenType::LEFT_BRACE);
     StmtNode body = block_statement();
 
-    return StmtNode{allocate_node(WhileStmt, std::move(keyword), std::move(condition), std::move(body), nullptr)};
+    return StmtNode{allocate_node(WhileStmt, std::move(keyword), std::move(condition), std::move(body), nullptr, 0)};
 }
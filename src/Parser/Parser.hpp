@@ -51,7 +51,6 @@ class Parser {
     ParseRule rules[static_cast<std::size_t>(TokenType::END_OF_FILE) + 1];
 
     Module &current_module;
-    std::size_t current_module_depth{}; // The depth in the import tree where the parser is currently at
     std::size_t scope_depth{};
 
     bool in_class{false};
@@ -86,9 +85,7 @@ class Parser {
     StmtNode single_token_statement(std::string_view token, bool condition, std::string_view error_message);
 
   public:
-    static std::vector<std::pair<Module, std::size_t>> parsed_modules;
-
-    explicit Parser(const std::vector<Token> &tokens, Module &module, std::size_t current_depth);
+    explicit Parser(const std::vector<Token> &tokens, Module &module);
 
     std::vector<StmtNode> program();
 
@@ -134,6 +131,7 @@ class Parser {
     StmtNode continue_statement();
     StmtNode expression_statement();
     StmtNode for_statement();
+    StmtNode for_each_statement(Token keyword);
     StmtNode if_statement();
     StmtNode return_statement();
     StmtNode switch_statement();
@@ -5,7 +5,6 @@
 #include "../Common.hpp"
 #include "../ErrorLogger/ErrorLogger.hpp"
 #include "../VirtualMachine/Natives.hpp"
-#include "Parser.hpp"
 
 #include <algorithm>
 #include <array>
@@ -33,13 +32,17 @@ struct ScopedScopeManager {
     ~ScopedScopeManager() { resolver.end_scope(); }
 };
 
-TypeResolver::TypeResolver(Module &module)
-    : current_module{module}, classes{module.classes}, functions{module.functions} {}
+TypeResolver::TypeResolver(Module &module, const std::vector<std::pair<Module, std::size_t>> &modules)
+    : current_module{module},
+      modules{modules},
+      classes{module.classes},
+      functions{module.functions},
+      type_scratch_space{module.types} {}
 
 ////////////////////////////////////////////////////////////////////////////////
 
 bool TypeResolver::convertible_to(
-    QualifiedTypeInfo to, QualifiedTypeInfo from, bool from_lvalue, const Token &where, bool in_initializer) {
+    QualifiedTypeInfo to, QualifiedTypeInfo from, bool from_lvalue, const TokenLocation &where, bool in_initializer) {
     bool class_condition = [&to, &from]() {
         if (to->type_tag() == NodeType::UserDefinedType && from->type_tag() == NodeType::UserDefinedType) {
             return dynamic_cast<UserDefinedType *>(to)->name.lexeme ==
@@ -110,7 +113,7 @@ bool is_builtin_type(Type type) {
     }
 }
 
-ClassStmt *TypeResolver::find_class(const std::string &class_name) {
+ClassStmt *TypeResolver::find_class(std::string_view class_name) {
     if (auto class_ = classes.find(class_name); class_ != classes.end()) {
         return class_->second;
     }
@@ -118,7 +121,7 @@ ClassStmt *TypeResolver::find_class(const std::string &class_name) {
     return nullptr;
 }
 
-FunctionStmt *TypeResolver::find_function(const std::string &function_name) {
+FunctionStmt *TypeResolver::find_function(std::string_view function_name) {
     if (auto func = functions.find(function_name); func != functions.end()) {
         return func->second;
     }
@@ -126,7 +129,31 @@ FunctionStmt *TypeResolver::find_function(const std::string &function_name) {
     return nullptr;
 }
 
+std::size_t TypeResolver::find_module(std::string_view module_name) {
+    // Only the modules that the current one imports (directly or through other modules) have been type checked by the
+    // time it is, the others may still be being checked on other threads
+    std::vector<bool> reachable(modules.size(), false);
+    std::vector<std::size_t> pending{current_module.imported};
+    while (not pending.empty()) {
+        std::size_t index = pending.back();
+        pending.pop_back();
+        if (not reachable[index]) {
+            reachable[index] = true;
+            pending.insert(pending.end(), modules[index].first.imported.begin(), modules[index].first.imported.end());
+        }
+    }
+
+    for (std::size_t i{0}; i < modules.size(); i++) {
+        const std::string &name = modules[i].first.name;
+        if (reachable[i] && name.substr(0, name.find_last_of('.')) == module_name) {
+            return i;
+        }
+    }
+    return modules.size();
+}
+
 void TypeResolver::check(std::vector<StmtNode> &program) {
+    NodeArena::Scope arena{current_module.nodes};
     for (auto &stmt : program) {
         if (stmt != nullptr) {
             try {
@@ -142,11 +169,44 @@ void TypeResolver::begin_scope() {
 
 void TypeResolver::end_scope() {
     while (not values.empty() && values.back().scope_depth == scope_depth) {
+        bindings[values.back().name].pop_back();
         values.pop_back();
     }
     scope_depth--;
 }
 
+std::size_t TypeResolver::intern(std::string_view name) {
+    auto [id, inserted] = identifier_ids.try_emplace(name, bindings.size());
+    if (inserted) {
+        bindings.emplace_back();
+    }
+    return id->second;
+}
+
+void TypeResolver::declare(
+    std::string_view name, QualifiedTypeInfo info, std::size_t depth, ClassStmt *class_, std::size_t stack_slot) {
+    std::size_t id = intern(name);
+    bindings[id].push_back(values.size());
+    values.push_back({id, info, depth, class_, stack_slot});
+}
+
+TypeResolver::Value *TypeResolver::find_value(std::string_view name) {
+    if (auto id = identifier_ids.find(name); id != identifier_ids.end() && not bindings[id->second].empty()) {
+        return &values[bindings[id->second].back()];
+    }
+    return nullptr;
+}
+
+std::size_t TypeResolver::next_stack_slot() const noexcept {
+    // The slots of a function's locals are relative to its frame, so the first local of a function without any
+    // parameters starts from zero instead of following the globals
+    if (values.empty() ||
+        (current_function != nullptr && values.back().scope_depth < current_function->scope_depth)) {
+        return 0;
+    }
+    return values.back().stack_slot + 1;
+}
+
 ExprVisitorType TypeResolver::resolve(Expr *expr) {
     return expr->accept(*this);
 }
@@ -297,22 +357,12 @@ bool one_of(T type, Args... args) {
 }
 
 ExprVisitorType TypeResolver::visit(AssignExpr &expr) {
-    auto it = values.end() - 1;
-    for (; it >= values.begin(); it--) {
-        if (it->lexeme == expr.target.lexeme) {
-            break;
-        }
-        if (it->scope_depth == 0) {
-            expr.target_type = IdentifierType::GLOBAL;
-        } else {
-            expr.target_type = IdentifierType::LOCAL;
-        }
-    }
-
-    if (it < values.begin()) {
+    Value *it = find_value(expr.target.lexeme);
+    if (it == nullptr) {
         error({"No such variable in the current scope"}, expr.target);
         throw TypeException{"No such variable in the current scope"};
     }
+    expr.target_type = it->scope_depth == 0 ? IdentifierType::GLOBAL : IdentifierType::LOCAL;
 
     ExprVisitorType value = resolve(expr.value.get());
     if (it->info->is_const) {
@@ -472,8 +522,8 @@ bool is_builtin_function(VariableExpr *expr) {
         [&expr](const NativeFn &native) { return native.name == expr->name.lexeme; });
 }
 
-ExprVisitorType TypeResolver::check_inbuilt(
-    VariableExpr *function, const Token &oper, std::vector<std::tuple<ExprNode, NumericConversionType, bool>> &args) {
+ExprVisitorType TypeResolver::check_inbuilt(VariableExpr *function, const TokenLocation &oper,
+    std::vector<std::tuple<ExprNode, NumericConversionType, bool>> &args) {
     auto it = std::find_if(native_functions.begin(), native_functions.end(),
         [&function](const NativeFn &native) { return native.name == function->name.lexeme; });
 
@@ -513,8 +563,16 @@ ExprVisitorType TypeResolver::visit(CallExpr &expr) {
 
     FunctionStmt *called = callee.func;
     if (callee.class_ != nullptr) {
+        // Calling something named after a method of the class it refers to (like its constructor) calls that method
+        std::string_view callee_name{};
+        if (expr.function->type_tag() == NodeType::VariableExpr) {
+            callee_name = dynamic_cast<VariableExpr *>(expr.function.get())->name.lexeme;
+        } else if (expr.function->type_tag() == NodeType::GetExpr) {
+            callee_name = dynamic_cast<GetExpr *>(expr.function.get())->name.lexeme;
+        }
+
         for (auto &method_decl : callee.class_->methods) {
-            if (method_decl.first->name == callee.token) {
+            if (method_decl.first->name.lexeme == callee_name) {
                 called = method_decl.first.get();
             }
         }
@@ -617,7 +675,7 @@ ExprVisitorType TypeResolver::resolve_class_access(ExprVisitorType &object, cons
 ExprVisitorType TypeResolver::visit(GetExpr &expr) {
     ExprVisitorType object = resolve(expr.object.get());
     if (expr.object->resolved.info->primitive == Type::TUPLE && expr.name.type == TokenType::INT_VALUE) {
-        int index = std::stoi(expr.name.lexeme); // Get the 0 in x.0
+        int index = std::stoi(std::string{expr.name.lexeme}); // Get the 0 in x.0
         auto *tuple = dynamic_cast<TupleType *>(expr.object->resolved.info);
         if (index >= static_cast<int>(tuple->types.size())) {
             error({"Tuple index out of range"}, expr.name);
@@ -802,7 +860,7 @@ ExprVisitorType TypeResolver::visit(ScopeAccessExpr &expr) {
             throw TypeException{"No such method exists in the class"};
 
         case ExprTypeInfo::ScopeType::MODULE: {
-            auto &module = Parser::parsed_modules[left.module_index].first;
+            auto &module = modules[left.module_index].first;
             if (auto class_ = module.classes.find(expr.name.lexeme); class_ != module.classes.end()) {
                 return expr.resolved = {
                            make_new_type<PrimitiveType>(Type::CLASS, true, false), class_->second, expr.resolved.token};
@@ -824,11 +882,8 @@ ExprVisitorType TypeResolver::visit(ScopeAccessExpr &expr) {
 }
 
 ExprVisitorType TypeResolver::visit(ScopeNameExpr &expr) {
-    for (std::size_t i{0}; i < Parser::parsed_modules.size(); i++) {
-        if (Parser::parsed_modules[i].first.name.substr(0, Parser::parsed_modules[i].first.name.find_last_of('.')) ==
-            expr.name.lexeme) {
-            return expr.resolved = {make_new_type<PrimitiveType>(Type::MODULE, true, false), i, expr.resolved.token};
-        }
+    if (std::size_t module = find_module(expr.name.lexeme); module < modules.size()) {
+        return expr.resolved = {make_new_type<PrimitiveType>(Type::MODULE, true, false), module, expr.resolved.token};
     }
 
     if (ClassStmt *class_ = find_class(expr.name.lexeme); class_ != nullptr) {
@@ -844,7 +899,7 @@ ExprVisitorType TypeResolver::visit(SetExpr &expr) {
     ExprVisitorType value_type = resolve(expr.value.get());
 
     if (object.info->primitive == Type::TUPLE && expr.name.type == TokenType::INT_VALUE) {
-        int index = std::stoi(expr.name.lexeme); // Get the 0 in x.0
+        int index = std::stoi(std::string{expr.name.lexeme}); // Get the 0 in x.0
         auto *tuple = dynamic_cast<TupleType *>(expr.object->resolved.info);
         if (index >= static_cast<int>(tuple->types.size())) {
             error({"Tuple index out of range"}, expr.name);
@@ -917,7 +972,7 @@ ExprVisitorType TypeResolver::visit(SuperExpr &expr) {
 }
 
 ExprVisitorType TypeResolver::visit(TernaryExpr &expr) {
-    ExprVisitorType left = resolve(expr.left.get());
+    resolve(expr.left.get());
     ExprVisitorType middle = resolve(expr.middle.get());
     ExprVisitorType right = resolve(expr.right.get());
 
@@ -999,17 +1054,15 @@ ExprVisitorType TypeResolver::visit(VariableExpr &expr) {
         throw TypeException{"Cannot use in-built function as an expression"};
     }
 
-    for (auto it = values.end() - 1; not values.empty() && it >= values.begin(); it--) {
-        if (it->lexeme == expr.name.lexeme) {
-            if (it->scope_depth == 0) {
-                expr.type = IdentifierType::GLOBAL;
-            } else {
-                expr.type = IdentifierType::LOCAL;
-            }
-            expr.resolved = {it->info, it->class_, expr.resolved.token, true};
-            expr.resolved.stack_slot = it->stack_slot;
-            return expr.resolved;
+    if (Value *it = find_value(expr.name.lexeme); it != nullptr) {
+        if (it->scope_depth == 0) {
+            expr.type = IdentifierType::GLOBAL;
+        } else {
+            expr.type = IdentifierType::LOCAL;
         }
+        expr.resolved = {it->info, it->class_, expr.resolved.token, true};
+        expr.resolved.stack_slot = it->stack_slot;
+        return expr.resolved;
     }
 
     if (FunctionStmt *func = find_function(expr.name.lexeme); func != nullptr) {
@@ -1022,7 +1075,7 @@ ExprVisitorType TypeResolver::visit(VariableExpr &expr) {
         return expr.resolved = {make_new_type<PrimitiveType>(Type::CLASS, true, false), class_, expr.resolved.token};
     }
 
-    error({"No such variable/function '", expr.name.lexeme, "' in the current module's scope"}, expr.name);
+    error({"No such variable/function '", std::string{expr.name.lexeme}, "' in the current module's scope"}, expr.name);
     throw TypeException{"No such variable/function in the current module's scope"};
 }
 
@@ -1059,7 +1112,7 @@ StmtVisitorType TypeResolver::visit(ClassStmt &stmt) {
         stmt.ctor = allocate_node(FunctionStmt, stmt.name,
             TypeNode{allocate_node(UserDefinedType, Type::CLASS, false, false, stmt.name)}, {},
             StmtNode{allocate_node(BlockStmt, {})}, {}, values.empty() ? 0 : values.crbegin()->scope_depth);
-        stmt.methods.emplace_back(std::unique_ptr<FunctionStmt>{stmt.ctor}, VisibilityType::PUBLIC);
+        stmt.methods.emplace_back(NodeHandle<FunctionStmt>{stmt.ctor}, VisibilityType::PUBLIC);
     }
 
     std::size_t initialized_count = std::count_if(stmt.members.begin(), stmt.members.end(),
@@ -1105,6 +1158,32 @@ StmtVisitorType TypeResolver::visit(ExpressionStmt &stmt) {
     resolve(stmt.expr.get());
 }
 
+StmtVisitorType TypeResolver::visit(ForEachStmt &stmt) {
+    ExprVisitorType iterable = resolve(stmt.iterable.get());
+    if (iterable.info->primitive == Type::LIST) {
+        stmt.type = TypeNode{copy_type(dynamic_cast<ListType *>(iterable.info)->contained.get())};
+    } else if (iterable.info->primitive == Type::STRING) {
+        stmt.type = TypeNode{allocate_node(PrimitiveType, Type::STRING, true, false)};
+    } else {
+        error({"Can only iterate over lists and strings in a for-each loop"}, stmt.keyword);
+        note({"Received type '", stringify(iterable.info), "'"});
+        throw TypeException{"Can only iterate over lists and strings in a for-each loop"};
+    }
+    stmt.type->is_const = true; // The loop variable is a view of the current element
+
+    ScopedScopeManager manager{*this};
+    ScopedBooleanManager loop_manager{in_loop};
+
+    // The iterated value and the index into it are kept in two hidden stack slots just below the loop variable. The
+    // empty names ensure that they can never be referred to by user code
+    std::size_t stack_slot = next_stack_slot();
+    declare("", iterable.info, scope_depth, nullptr, stack_slot);
+    declare("", make_new_type<PrimitiveType>(Type::INT, false, false), scope_depth, nullptr, stack_slot + 1);
+    declare(stmt.name.lexeme, stmt.type.get(), scope_depth, nullptr, stack_slot + 2);
+
+    resolve(stmt.body.get());
+}
+
 StmtVisitorType TypeResolver::visit(FunctionStmt &stmt) {
     ScopedScopeManager manager{*this};
     ScopedBooleanManager function_manager{in_function};
@@ -1147,7 +1226,7 @@ StmtVisitorType TypeResolver::visit(FunctionStmt &stmt) {
             }
         }
 
-        values.push_back({param.first.lexeme, param.second.get(), scope_depth + 1, param_class, i++});
+        declare(param.first.lexeme, param.second.get(), scope_depth + 1, param_class, i++);
     }
 
     if (auto *body = dynamic_cast<BlockStmt *>(stmt.body.get());
@@ -1221,9 +1300,9 @@ StmtVisitorType TypeResolver::visit(TypeStmt &) {
 }
 
 StmtVisitorType TypeResolver::visit(VarStmt &stmt) {
-    if (not in_class && std::any_of(values.crbegin(), values.crend(), [this, &stmt](const Value &value) {
-            return value.scope_depth == scope_depth && value.lexeme == stmt.name.lexeme;
-        })) {
+    // Variables in the current scope are the innermost ones, so only the innermost variable with the name can be in it
+    if (const Value *existing = find_value(stmt.name.lexeme);
+        not in_class && existing != nullptr && existing->scope_depth == scope_depth) {
         error({"A variable with the same name has already been created in this scope"}, stmt.name);
         throw TypeException{"A variable with the same name has already been created in this scope"};
     }
@@ -1284,8 +1363,7 @@ StmtVisitorType TypeResolver::visit(VarStmt &stmt) {
         }
 
         if (not in_class || in_function) {
-            values.push_back({stmt.name.lexeme, type, scope_depth, initializer.class_,
-                (values.empty() ? 0 : values.back().stack_slot + 1)});
+            declare(stmt.name.lexeme, type, scope_depth, initializer.class_, next_stack_slot());
         }
     } else if (stmt.type != nullptr) {
         replace_if_typeof(stmt.type);
@@ -1301,8 +1379,7 @@ StmtVisitorType TypeResolver::visit(VarStmt &stmt) {
         }
 
         if (not in_class || in_function) {
-            values.push_back(
-                {stmt.name.lexeme, type, scope_depth, stmt_class, (values.empty() ? 0 : values.back().stack_slot + 1)});
+            declare(stmt.name.lexeme, type, scope_depth, stmt_class, next_stack_slot());
         }
     } else {
         error({"Expected type for variable"}, stmt.name);
@@ -1313,6 +1390,8 @@ StmtVisitorType TypeResolver::visit(VarStmt &stmt) {
 StmtVisitorType TypeResolver::visit(WhileStmt &stmt) {
     // ScopedScopeManager manager{*this};
     ScopedBooleanManager loop_manager{in_loop};
+    // Values hoisted out of the loop by the generator are stored starting from here
+    stmt.stack_slot = next_stack_slot();
 
     ExprVisitorType condition = resolve(stmt.condition.get());
     if (one_of(condition.info->primitive, Type::CLASS, Type::LIST)) {
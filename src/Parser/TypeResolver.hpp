@@ -12,11 +12,12 @@
 #include <string_view>
 #include <tuple>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 class TypeResolver final : Visitor {
     struct Value {
-        std::string_view lexeme{};
+        std::size_t name{}; // The interned id of the name
         QualifiedTypeInfo info{};
         std::size_t scope_depth{};
         ClassStmt *class_{nullptr};
@@ -24,10 +25,16 @@ class TypeResolver final : Visitor {
     };
 
     Module &current_module;
+    const std::vector<std::pair<Module, std::size_t>> &modules; // Everything loaded by the ModuleLoader
     const std::unordered_map<std::string_view, ClassStmt *> &classes;
     const std::unordered_map<std::string_view, FunctionStmt *> &functions;
-    std::vector<TypeNode> type_scratch_space{};
+    std::vector<TypeNode> &type_scratch_space;
     std::vector<Value> values{};
+    // Every name that is declared is given an id, and the indexes in `values` of the variables with that name that are
+    // in scope are kept in bindings[id] (innermost last), so finding a variable does not need to look through the
+    // others
+    std::unordered_map<std::string_view, std::size_t> identifier_ids{};
+    std::vector<std::vector<std::size_t>> bindings{};
 
     bool in_ctor{false};
     bool in_dtor{false};
@@ -42,12 +49,13 @@ class TypeResolver final : Visitor {
     template <typename T, typename... Args>
     BaseType *make_new_type(Type type, bool is_const, bool is_ref, Args &&...args);
     ExprTypeInfo resolve_class_access(ExprVisitorType &object, const Token &name);
-    ExprVisitorType check_inbuilt(VariableExpr *function, const Token &oper,
+    ExprVisitorType check_inbuilt(VariableExpr *function, const TokenLocation &oper,
         std::vector<std::tuple<ExprNode, NumericConversionType, bool>> &args);
-    ClassStmt *find_class(const std::string &class_name);
-    FunctionStmt *find_function(const std::string &function_name);
-    bool convertible_to(
-        QualifiedTypeInfo to, QualifiedTypeInfo from, bool from_lvalue, const Token &where, bool in_initializer);
+    ClassStmt *find_class(std::string_view class_name);
+    FunctionStmt *find_function(std::string_view function_name);
+    std::size_t find_module(std::string_view module_name);
+    bool convertible_to(QualifiedTypeInfo to, QualifiedTypeInfo from, bool from_lvalue, const TokenLocation &where,
+        bool in_initializer);
 
     void replace_if_typeof(TypeNode &type);
     void infer_list_type(ListExpr *of, ListType *from);
@@ -57,6 +65,12 @@ class TypeResolver final : Visitor {
 
     void begin_scope();
     void end_scope();
+    std::size_t intern(std::string_view name);
+    void declare(std::string_view name, QualifiedTypeInfo info, std::size_t depth, ClassStmt *class_,
+        std::size_t stack_slot);
+    // The innermost variable with the given name, or nullptr if there is none in scope
+    [[nodiscard]] Value *find_value(std::string_view name);
+    [[nodiscard]] std::size_t next_stack_slot() const noexcept;
     friend class ScopedScopeManager;
 
     ExprVisitorType resolve(Expr *expr);
@@ -64,7 +78,7 @@ class TypeResolver final : Visitor {
     BaseTypeVisitorType resolve(BaseType *type);
 
   public:
-    explicit TypeResolver(Module &module);
+    explicit TypeResolver(Module &module, const std::vector<std::pair<Module, std::size_t>> &modules);
 
     void check(std::vector<StmtNode> &program);
 
@@ -94,6 +108,7 @@ class TypeResolver final : Visitor {
     StmtVisitorType visit(ClassStmt &stmt) override final;
     StmtVisitorType visit(ContinueStmt &stmt) override final;
     StmtVisitorType visit(ExpressionStmt &stmt) override final;
+    StmtVisitorType visit(ForEachStmt &stmt) override final;
     StmtVisitorType visit(FunctionStmt &stmt) override final;
     StmtVisitorType visit(IfStmt &stmt) override final;
     StmtVisitorType visit(ReturnStmt &stmt) override final;
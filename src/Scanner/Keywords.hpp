@@ -0,0 +1,75 @@
+#pragma once
+
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+
+#ifndef KEYWORDS_HPP
+#define KEYWORDS_HPP
+
+#include "../TokenTypes.hpp"
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+// Recognizes keywords with a perfect hash: every keyword hashes to a different slot of a table that is built at compile
+// time, so finding out whether an identifier is a keyword takes a few arithmetic operations and one comparison. The
+// hash only looks at the first two and the last character and the length of a word, which is enough to tell all the
+// keywords apart (checked by a static_assert below, pick new multipliers if adding a keyword breaks it)
+namespace keywords {
+struct Keyword {
+    std::string_view lexeme{};
+    TokenType type{TokenType::NONE};
+};
+
+constexpr std::size_t table_size = 64;
+
+constexpr Keyword list[]{{"and", TokenType::AND}, {"bool", TokenType::BOOL}, {"break", TokenType::BREAK},
+    {"class", TokenType::CLASS}, {"const", TokenType::CONST}, {"continue", TokenType::CONTINUE},
+    {"default", TokenType::DEFAULT}, {"else", TokenType::ELSE}, {"false", TokenType::FALSE},
+    {"float", TokenType::FLOAT}, {"fn", TokenType::FN}, {"for", TokenType::FOR}, {"if", TokenType::IF},
+    {"import", TokenType::IMPORT}, {"in", TokenType::IN}, {"int", TokenType::INT}, {"null", TokenType::NULL_},
+    {"not", TokenType::NOT}, {"or", TokenType::OR}, {"protected", TokenType::PROTECTED},
+    {"private", TokenType::PRIVATE}, {"public", TokenType::PUBLIC}, {"ref", TokenType::REF},
+    {"return", TokenType::RETURN}, {"string", TokenType::STRING}, {"super", TokenType::SUPER},
+    {"switch", TokenType::SWITCH}, {"this", TokenType::THIS}, {"true", TokenType::TRUE}, {"type", TokenType::TYPE},
+    {"typeof", TokenType::TYPEOF}, {"var", TokenType::VAR}, {"while", TokenType::WHILE}};
+
+// Only called with words that are at least two characters long
+[[nodiscard]] constexpr std::size_t hash(std::string_view word) noexcept {
+    auto at = [word](std::size_t index) { return static_cast<std::size_t>(static_cast<unsigned char>(word[index])); };
+    return (at(0) * 12 + at(1) * 11 + at(word.size() - 1) * 27 + word.size()) % table_size;
+}
+
+[[nodiscard]] constexpr std::array<Keyword, table_size> make_table() noexcept {
+    std::array<Keyword, table_size> table{};
+    for (const Keyword &keyword : list) {
+        table[hash(keyword.lexeme)] = keyword;
+    }
+    return table;
+}
+
+constexpr std::array<Keyword, table_size> table = make_table();
+
+[[nodiscard]] constexpr bool is_perfect() noexcept {
+    for (const Keyword &keyword : list) {
+        if (table[hash(keyword.lexeme)].type != keyword.type) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(is_perfect(), "Two keywords have the same hash");
+
+// Returns TokenType::NONE if the word is not a keyword
+[[nodiscard]] constexpr TokenType find(std::string_view word) noexcept {
+    if (word.size() < 2) {
+        return TokenType::NONE;
+    }
+    const Keyword &keyword = table[hash(word)];
+    return keyword.lexeme == word ? keyword.type : TokenType::NONE;
+}
+} // namespace keywords
+
+#endif
@@ -0,0 +1,110 @@
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+#include "Runs.hpp"
+
+#include <cctype>
+#include <cstring>
+
+#if !defined(WIS_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#define WIS_SSE2_RUNS
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace {
+#if defined(WIS_SSE2_RUNS)
+constexpr std::size_t width = 16;
+
+unsigned count_trailing_zeros(unsigned mask) noexcept {
+#if defined(_MSC_VER)
+    unsigned long index{};
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+__m128i equal(__m128i chunk, char ch) noexcept {
+    return _mm_cmpeq_epi8(chunk, _mm_set1_epi8(ch));
+}
+
+// The comparisons are signed, so characters above 127 are never in the range
+__m128i in_range(__m128i chunk, char low, char high) noexcept {
+    return _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8(static_cast<char>(low - 1))),
+        _mm_cmplt_epi8(chunk, _mm_set1_epi8(static_cast<char>(high + 1))));
+}
+#endif
+
+// `in_run` gives a mask with all bits of a byte set for every character in the chunk that is a part of the run, and
+// `is_part` does the same for a single character
+template <typename VectorPredicate, typename ScalarPredicate>
+std::size_t run_end(std::string_view source, std::size_t from, [[maybe_unused]] VectorPredicate in_run,
+    ScalarPredicate is_part) noexcept {
+#if defined(WIS_SSE2_RUNS)
+    for (; from + width <= source.size(); from += width) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source.data() + from));
+        if (unsigned outside = ~static_cast<unsigned>(_mm_movemask_epi8(in_run(chunk))) & 0xffffu; outside != 0) {
+            return from + count_trailing_zeros(outside);
+        }
+    }
+#endif
+    while (from < source.size() && is_part(source[from])) {
+        from++;
+    }
+    return from;
+}
+
+// A placeholder for the vector predicate when SSE2 is not available
+struct NoVectorPredicate {};
+} // namespace
+
+#if defined(WIS_SSE2_RUNS)
+#define VECTOR_PREDICATE(...) [&](__m128i chunk) { return __VA_ARGS__; }
+#else
+#define VECTOR_PREDICATE(...) NoVectorPredicate{}
+#endif
+
+namespace runs {
+std::size_t identifier_end(std::string_view source, std::size_t from) noexcept {
+    // Setting the 0x20 bit turns upper case letters into lower case ones, without making anything else a letter
+    return run_end(source, from,
+        VECTOR_PREDICATE(_mm_or_si128(_mm_or_si128(in_range(_mm_or_si128(chunk, _mm_set1_epi8(0x20)), 'a', 'z'),
+                                          in_range(chunk, '0', '9')),
+            equal(chunk, '_'))),
+        [](char ch) { return std::isalnum(static_cast<unsigned char>(ch)) || ch == '_'; });
+}
+
+std::size_t digits_end(std::string_view source, std::size_t from) noexcept {
+    return run_end(source, from, VECTOR_PREDICATE(in_range(chunk, '0', '9')),
+        [](char ch) { return std::isdigit(static_cast<unsigned char>(ch)) != 0; });
+}
+
+std::size_t whitespace_end(std::string_view source, std::size_t from) noexcept {
+    return run_end(source, from,
+        VECTOR_PREDICATE(_mm_or_si128(
+            _mm_or_si128(equal(chunk, ' '), equal(chunk, '\t')), _mm_or_si128(equal(chunk, '\r'), equal(chunk, '\b')))),
+        [](char ch) { return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\b'; });
+}
+
+std::size_t line_end(std::string_view source, std::size_t from) noexcept {
+    // memchr is already vectorized by the C library
+    if (from >= source.size()) {
+        return source.size();
+    }
+    const void *newline = std::memchr(source.data() + from, '\n', source.size() - from);
+    return newline != nullptr ? static_cast<const char *>(newline) - source.data() : source.size();
+}
+
+std::size_t string_end(std::string_view source, std::size_t from, char delimiter) noexcept {
+    return run_end(source, from,
+        VECTOR_PREDICATE(_mm_andnot_si128(
+            _mm_or_si128(_mm_or_si128(equal(chunk, delimiter), equal(chunk, '\\')), equal(chunk, '\n')),
+            _mm_set1_epi8(-1))),
+        [delimiter](char ch) { return ch != delimiter && ch != '\\' && ch != '\n'; });
+}
+} // namespace runs
+
+#undef VECTOR_PREDICATE
@@ -0,0 +1,28 @@
+#pragma once
+
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+
+#ifndef RUNS_HPP
+#define RUNS_HPP
+
+#include <cstddef>
+#include <string_view>
+
+// Finds the end of runs of characters that the scanner would otherwise go through one at a time. Each function takes
+// the index to start from and returns the index of the first character that is not a part of the run (or the size of
+// the source if the run goes on until its end). With SSE2 available, sixteen characters are checked at once, and the
+// scalar loop only handles the last few characters of the source. Defining WIS_NO_SIMD forces the scalar loop
+namespace runs {
+// Letters, digits and underscores
+[[nodiscard]] std::size_t identifier_end(std::string_view source, std::size_t from) noexcept;
+[[nodiscard]] std::size_t digits_end(std::string_view source, std::size_t from) noexcept;
+// Whitespace other than newlines, which the scanner needs to see
+[[nodiscard]] std::size_t whitespace_end(std::string_view source, std::size_t from) noexcept;
+// The first newline, for the body of a `//` comment
+[[nodiscard]] std::size_t line_end(std::string_view source, std::size_t from) noexcept;
+// The first delimiter, backslash or newline, for the body of a string
+[[nodiscard]] std::size_t string_end(std::string_view source, std::size_t from, char delimiter) noexcept;
+} // namespace runs
+
+#endif
@@ -4,33 +4,15 @@
 
 #include "../Common.hpp"
 #include "../ErrorLogger/ErrorLogger.hpp"
+#include "Runs.hpp"
 
 #include <algorithm>
 #include <cassert>
 #include <cctype>
+#include <utility>
 
-Scanner::Scanner() {
-    const char *words[]{"and", "bool", "break", "class", "const", "continue", "default", "else", "false", "float", "fn",
-        "for", "if", "import", "int", "null", "not", "or", "protected", "private", "public", "ref", "return", "string",
-        "super", "switch", "this", "true", "type", "typeof", "var", "while"};
-
-    TokenType types[]{TokenType::AND, TokenType::BOOL, TokenType::BREAK, TokenType::CLASS, TokenType::CONST,
-        TokenType::CONTINUE, TokenType::DEFAULT, TokenType::ELSE, TokenType::FALSE, TokenType::FLOAT, TokenType::FN,
-        TokenType::FOR, TokenType::IF, TokenType::IMPORT, TokenType::INT, TokenType::NULL_, TokenType::NOT,
-        TokenType::OR, TokenType::PROTECTED, TokenType::PRIVATE, TokenType::PUBLIC, TokenType::REF, TokenType::RETURN,
-        TokenType::STRING, TokenType::SUPER, TokenType::SWITCH, TokenType::THIS, TokenType::TRUE, TokenType::TYPE,
-        TokenType::TYPEOF, TokenType::VAR, TokenType::WHILE};
-
-    static_assert(std::size(words) == std::size(types), "Size of array of keywords and their types have to be same.");
-
-    for (std::size_t i{0}; i < std::size(words); i++) {
-        keywords.insert(words[i], types[i]);
-    }
-}
-
-Scanner::Scanner(const std::string_view source) : Scanner() {
-    this->source = source;
-}
+Scanner::Scanner(const std::string_view source, std::deque<std::string> &strings)
+    : source{source}, strings{&strings} {}
 
 bool Scanner::is_at_end() const noexcept {
     return current >= source.length();
@@ -72,41 +54,33 @@ bool Scanner::match(const char ch) {
 }
 
 void Scanner::add_token(const TokenType type) {
-    tokens.push_back(Token{type, std::string{source.substr(start, (current - start))}, line, start, current});
+    tokens.push_back(Token{type, source.substr(start, (current - start)), line, start, current});
 }
 
 void Scanner::number() {
     TokenType type = TokenType::INT_VALUE;
-    while (not is_at_end() && std::isdigit(peek())) {
-        advance();
-    }
+    current = runs::digits_end(source, current);
 
     if (peek() == '.' && std::isdigit(peek_next())) {
         type = TokenType::FLOAT_VALUE;
         advance();
-        while (not is_at_end() && std::isdigit(peek())) {
-            advance();
-        }
+        current = runs::digits_end(source, current);
     }
 
     if (peek() == 'e' && std::isdigit(peek_next())) {
         type = TokenType::FLOAT_VALUE;
         advance();
-        while (not is_at_end() && std::isdigit(peek())) {
-            advance();
-        }
+        current = runs::digits_end(source, current);
     }
 
     add_token(type);
 }
 
 void Scanner::identifier() {
-    while (not is_at_end() && (std::isalnum(peek()) || peek() == '_')) {
-        advance();
-    }
+    current = runs::identifier_end(source, current);
 
     std::string_view lexeme = source.substr(start, (current - start));
-    if (TokenType type{keywords.search(lexeme)}; type != TokenType::NONE) {
+    if (TokenType type{keywords::find(lexeme)}; type != TokenType::NONE) {
         add_token(type);
     } else {
         add_token(TokenType::IDENTIFIER);
@@ -114,12 +88,30 @@ void Scanner::identifier() {
 }
 
 void Scanner::string(const char delimiter) {
-    std::string lexeme{}; // I think this should be fine because of SSO leading to an allocation only after ~24 chars.
+    // The lexeme refers to the source unless the string is not in it as it is, in which case the string is copied into
+    // `lexeme` from the first difference onwards
+    std::string lexeme{};
+    bool is_copied = false;
+    auto copy = [this, &lexeme, &is_copied] {
+        if (not std::exchange(is_copied, true)) {
+            lexeme = source.substr(start + 1, current - start - 1);
+        }
+    };
+
     while (not is_at_end() && peek() != delimiter) {
-        if (peek() == '\n') {
+        if (std::size_t end = runs::string_end(source, current, delimiter); end != current) {
+            // Everything up to the next delimiter, escape sequence or newline is a part of the string as it is
+            if (is_copied) {
+                lexeme += source.substr(current, end - current);
+            }
+            current = end;
+        } else if (peek() == '\n') {
+            copy(); // Newlines are not a part of the string
             line++;
             advance();
-        } else if (match('\\')) {
+        } else if (peek() == '\\') {
+            copy();
+            advance();
             if (match('b')) {
                 lexeme += '\b';
             } else if (match('n')) {
@@ -138,19 +130,19 @@ void Scanner::string(const char delimiter) {
                 advance();
                 warning({"Unrecognized escape sequence"}, previous());
             }
-        } else {
-            lexeme += advance();
         }
     }
 
     if (is_at_end()) {
         error(
             {"Unexpected end of file while reading string, did you forget the closing '", std::string{delimiter}, "'?"},
-            Token{TokenType::STRING_VALUE, std::string{source.substr(start, (current - start))}, line, start, current});
+            Token{TokenType::STRING_VALUE, source.substr(start, (current - start)), line, start, current});
     }
 
+    std::string_view value = is_copied ? strings->emplace_back(std::move(lexeme))
+                                       : source.substr(start + 1, current - start - 1);
     advance(); // Consume the closing delimiter
-    tokens.emplace_back(TokenType::STRING_VALUE, lexeme, line, start, current);
+    tokens.emplace_back(TokenType::STRING_VALUE, value, line, start, current);
 }
 
 void Scanner::multiline_comment() {
@@ -159,9 +151,7 @@ void Scanner::multiline_comment() {
             if (match('*')) {
                 multiline_comment();
             } else if (match('/')) {
-                while (not is_at_end() && peek() != '\n') {
-                    advance();
-                }
+                current = runs::line_end(source, current);
             }
         } else {
             if (peek() == '\n') {
@@ -173,7 +163,7 @@ void Scanner::multiline_comment() {
 
     if (is_at_end()) {
         error({"Unexpected end of file while reading comment, did you forget the closing '*/'?"},
-            Token{TokenType::STRING_VALUE, std::string{source.substr(start, (current - start))}, line, start, current});
+            Token{TokenType::STRING_VALUE, source.substr(start, (current - start)), line, start, current});
     }
 
     advance(); // *
@@ -270,7 +260,7 @@ void Scanner::scan_token() {
         case ' ':
         case '\t':
         case '\r':
-        case '\b': break;
+        case '\b': current = runs::whitespace_end(source, current); break;
         case '\n': {
             auto is_allowed = [this](const Token &token) {
                 switch (token.type) {
@@ -301,9 +291,7 @@ void Scanner::scan_token() {
                 break;
             } else if (ch == '/') {
                 if (match('/')) {
-                    while (not is_at_end() && peek() != '\n') {
-                        advance();
-                    }
+                    current = runs::line_end(source, current);
                     break;
                 } else if (match('*')) {
                     multiline_comment();
@@ -314,8 +302,7 @@ void Scanner::scan_token() {
             }
 
             error({"Unrecognized character ", std::string{ch}, " in input"},
-                Token{TokenType::STRING_VALUE, std::string{source.substr(start, (current - start))}, line, start,
-                    current});
+                Token{TokenType::STRING_VALUE, source.substr(start, (current - start)), line, start, current});
         }
     }
 }
@@ -8,8 +8,10 @@
 
 #include "../Token.hpp"
 #include "../TokenTypes.hpp"
-#include "Trie.hpp"
+#include "Keywords.hpp"
 
+#include <deque>
+#include <string>
 #include <string_view>
 #include <vector>
 
@@ -20,11 +22,11 @@ class Scanner {
     std::size_t paren_count{};
     std::vector<Token> tokens{};
     std::string_view source{};
-    Trie keywords{};
+    std::deque<std::string> *strings{nullptr}; // Where the lexemes that are not in the source as they are are stored
 
   public:
-    Scanner();
-    explicit Scanner(std::string_view source);
+    // The tokens refer into `source`, which has to outlive them along with `strings`
+    Scanner(std::string_view source, std::deque<std::string> &strings);
 
     [[nodiscard]] bool is_at_end() const noexcept;
 
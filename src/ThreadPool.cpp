@@ -0,0 +1,72 @@
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <utility>
+
+ThreadPool::ThreadPool(std::size_t count) {
+    if (count == 0) {
+        count = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    threads.reserve(count);
+    for (std::size_t i{0}; i < count; i++) {
+        threads.emplace_back([this] { work(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock{mutex};
+        stopping = true;
+    }
+    task_available.notify_all();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::work() {
+    while (true) {
+        std::function<void()> task{};
+        {
+            std::unique_lock lock{mutex};
+            task_available.wait(lock, [this] { return stopping || not tasks.empty(); });
+            if (tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            running++;
+        }
+
+        std::exception_ptr thrown{};
+        try {
+            task();
+        } catch (...) { thrown = std::current_exception(); }
+
+        std::lock_guard lock{mutex};
+        if (thrown != nullptr && failure == nullptr) {
+            failure = thrown;
+        }
+        if (--running == 0 && tasks.empty()) {
+            tasks_done.notify_all();
+        }
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard lock{mutex};
+        tasks.push_back(std::move(task));
+    }
+    task_available.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock lock{mutex};
+    tasks_done.wait(lock, [this] { return running == 0 && tasks.empty(); });
+    if (failure != nullptr) {
+        std::rethrow_exception(std::exchange(failure, nullptr));
+    }
+}
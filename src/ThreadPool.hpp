@@ -0,0 +1,45 @@
+#pragma once
+
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed number of threads that run the tasks given to them in the order they were submitted. Tasks may submit more
+// tasks while they run, and wait() returns only once all of them (including the ones submitted later) are done
+class ThreadPool {
+    std::vector<std::thread> threads{};
+    std::deque<std::function<void()>> tasks{};
+    std::mutex mutex{};
+    std::condition_variable task_available{};
+    std::condition_variable tasks_done{};
+    std::size_t running{};
+    bool stopping{false};
+    std::exception_ptr failure{}; // The first exception thrown by a task, rethrown by wait()
+
+    void work();
+
+  public:
+    // Zero threads means one for every core
+    explicit ThreadPool(std::size_t count);
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ~ThreadPool();
+
+    [[nodiscard]] std::size_t size() const noexcept { return threads.size(); }
+
+    void submit(std::function<void()> task);
+    void wait();
+};
+
+#endif
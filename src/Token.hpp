@@ -8,22 +8,43 @@
 
 #include "TokenTypes.hpp"
 
-#include <string>
+#include <cstdint>
+#include <string_view>
 
+// The lexeme of a token refers to the source code of the module it is from, or to a string stored along with that
+// source when the lexeme does not appear in it as it is (like a string literal with escape sequences), see Module
 struct Token {
     TokenType type;
-    std::string lexeme;
+    std::string_view lexeme;
     std::size_t line;
     std::size_t start;
     std::size_t end;
 
     Token() = default;
 
-    Token(TokenType type, std::string lexeme, std::size_t line, std::size_t start, std::size_t end)
-        : type{type}, lexeme{std::move(lexeme)}, line{line}, start{start}, end{end} {}
+    Token(TokenType type, std::string_view lexeme, std::size_t line, std::size_t start, std::size_t end)
+        : type{type}, lexeme{lexeme}, line{line}, start{start}, end{end} {}
 
     bool operator==(const Token &other) { return lexeme == other.lexeme; }
     bool operator!=(const Token &other) { return lexeme != other.lexeme; }
 };
 
+// What is left of a token without its lexeme: where it is in the source code and what kind of token it is. This is all
+// that the type information of an expression needs to keep, as it is only used to report errors and to know which line
+// the instructions for the expression come from
+struct TokenLocation {
+    std::uint32_t line{};
+    std::uint32_t start{};
+    std::uint32_t end{};
+    TokenType type{TokenType::NONE};
+
+    TokenLocation() = default;
+
+    TokenLocation(const Token &token)
+        : line{static_cast<std::uint32_t>(token.line)},
+          start{static_cast<std::uint32_t>(token.start)},
+          end{static_cast<std::uint32_t>(token.end)},
+          type{token.type} {}
+};
+
 #endif
@@ -6,8 +6,10 @@
 #ifndef TOKEN_TYPES_HPP
 #define TOKEN_TYPES_HPP
 
+#include <cstdint>
+
 // Empty comments indicate precedence levels
-enum class TokenType {
+enum class TokenType : std::uint8_t {
     //
     COMMA,
     //
@@ -89,6 +91,7 @@ enum class TokenType {
     FOR,
     IF,
     IMPORT,
+    IN,
     INT,
     NULL_,
     /* OR, */ PROTECTED,
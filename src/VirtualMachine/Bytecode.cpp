@@ -0,0 +1,360 @@
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+#include "Bytecode.hpp"
+
+#include "Value.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace bytecode {
+static_assert(sizeof(Header) == 144 && sizeof(Constant) == 24 && sizeof(Line) == 8 && sizeof(ChunkRecord) == 48 &&
+                  sizeof(FunctionRecord) == 48,
+    "The layout of the records is a part of the file format");
+
+namespace {
+constexpr std::size_t alignment = 8;
+
+// Collects the sections of a file, sharing strings and constants between all the chunks in the module
+class Writer {
+    std::string strings{};
+    std::unordered_map<std::string, std::uint64_t> string_offsets{};
+    std::vector<Constant> constants{};
+    std::map<std::tuple<std::uint32_t, std::uint64_t, std::uint64_t>, std::uint32_t> constant_indexes{};
+    std::vector<std::uint32_t> references{};
+    std::vector<Chunk::InstructionSizeType> code{};
+    std::vector<Line> lines{};
+    std::vector<ChunkRecord> chunks{};
+    std::vector<FunctionRecord> functions{};
+
+    template <typename T>
+    static void append_section(std::string &file, Range &range, const T *records, std::size_t count) {
+        file.resize((file.size() + alignment - 1) / alignment * alignment, '\0');
+        range = {file.size(), count};
+        if (count > 0) {
+            file.append(reinterpret_cast<const char *>(records), count * sizeof(T));
+        }
+    }
+
+  public:
+    Range add_string(std::string_view string) {
+        auto [it, inserted] = string_offsets.try_emplace(std::string{string}, strings.size());
+        if (inserted) {
+            strings += string;
+        }
+        return {it->second, string.size()};
+    }
+
+    std::optional<std::uint32_t> add_constant(const Chunk &chunk, std::size_t index) {
+        const Value &value = chunk.constants[index];
+        Constant constant{static_cast<std::uint32_t>(value.tag)};
+        switch (value.tag) {
+            case Value::Tag::INT: constant.value = static_cast<std::uint32_t>(value.w_int); break;
+            case Value::Tag::FLOAT: std::memcpy(&constant.value, &value.w_float, sizeof(value.w_float)); break;
+            case Value::Tag::STRING: {
+                Range string = add_string(chunk.string_text(index));
+                constant.value = string.offset;
+                constant.length = string.count;
+                break;
+            }
+            case Value::Tag::BOOL: constant.value = value.w_bool; break;
+            case Value::Tag::NULL_: break;
+            // Only the values that can be written down in the source code are ever made into constants
+            default: return std::nullopt;
+        }
+
+        auto [it, inserted] = constant_indexes.try_emplace(
+            {constant.tag, constant.value, constant.length}, static_cast<std::uint32_t>(constants.size()));
+        if (inserted) {
+            constants.push_back(constant);
+        }
+        return it->second;
+    }
+
+    // The chunk may itself have been read from a file, in which case its code and line numbers are only in `mapped`
+    std::optional<std::uint64_t> add_chunk(const Chunk &chunk) {
+        ChunkRecord record{};
+        record.code = {code.size(), chunk.code_size()};
+        code.insert(code.end(), chunk.code(), chunk.code() + chunk.code_size());
+
+        record.references = {references.size(), chunk.constants.size()};
+        for (std::size_t i{0}; i < chunk.constants.size(); i++) {
+            std::optional<std::uint32_t> constant = add_constant(chunk, i);
+            if (not constant.has_value()) {
+                return std::nullopt;
+            }
+            references.push_back(*constant);
+        }
+
+        if (chunk.is_mapped()) {
+            record.lines = {lines.size(), chunk.mapped.line_count};
+            lines.insert(lines.end(), chunk.mapped.lines, chunk.mapped.lines + chunk.mapped.line_count);
+        } else {
+            record.lines = {lines.size(), chunk.line_numbers.size()};
+            for (auto [line, count] : chunk.line_numbers) {
+                lines.push_back({static_cast<std::uint32_t>(line), static_cast<std::uint32_t>(count)});
+            }
+        }
+
+        chunks.push_back(record);
+        return chunks.size() - 1;
+    }
+
+    bool add_function(const std::string &key, const RuntimeFunction &function) {
+        std::optional<std::uint64_t> chunk = add_chunk(function.code);
+        if (not chunk.has_value()) {
+            return false;
+        }
+        functions.push_back({add_string(key), add_string(function.name), function.arity, *chunk});
+        return true;
+    }
+
+    [[nodiscard]] std::string finish(std::uint32_t top_level_chunk, Range name) const {
+        Header header{};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.byte_order = byte_order;
+        header.top_level_chunk = top_level_chunk;
+        header.name = name;
+
+        std::string file(sizeof(Header), '\0');
+        append_section(file, header.sections[STRINGS], strings.data(), strings.size());
+        append_section(file, header.sections[CONSTANTS], constants.data(), constants.size());
+        append_section(file, header.sections[REFERENCES], references.data(), references.size());
+        append_section(file, header.sections[CODE], code.data(), code.size());
+        append_section(file, header.sections[LINES], lines.data(), lines.size());
+        append_section(file, header.sections[CHUNKS], chunks.data(), chunks.size());
+        append_section(file, header.sections[FUNCTIONS], functions.data(), functions.size());
+        std::memcpy(file.data(), &header, sizeof(Header));
+        return file;
+    }
+};
+
+// Gives out the records in the sections of a file, after checking that they are inside of it
+class Reader {
+    std::string_view file{};
+    Header header{};
+
+  public:
+    explicit Reader(std::string_view file) : file{file} {}
+
+    [[nodiscard]] bool read_header() {
+        // The code and line numbers are used where they are, so they have to be aligned in memory
+        if (file.size() < sizeof(Header) || reinterpret_cast<std::uintptr_t>(file.data()) % alignment != 0) {
+            return false;
+        }
+        std::memcpy(&header, file.data(), sizeof(Header));
+        if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version ||
+            header.byte_order != byte_order) {
+            return false;
+        }
+
+        constexpr std::size_t record_sizes[SECTION_COUNT] = {1, sizeof(Constant), sizeof(std::uint32_t),
+            sizeof(Chunk::InstructionSizeType), sizeof(Line), sizeof(ChunkRecord), sizeof(FunctionRecord)};
+        for (std::size_t i{0}; i < SECTION_COUNT; i++) {
+            const Range &section = header.sections[i];
+            if (section.offset % alignment != 0 || section.offset > file.size() ||
+                section.count > (file.size() - section.offset) / record_sizes[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    [[nodiscard]] const Header &get_header() const noexcept { return header; }
+
+    // Whether the records in `range` are all inside of the section
+    [[nodiscard]] bool contains(Section section, Range range) const noexcept {
+        return range.offset <= header.sections[section].count &&
+               range.count <= header.sections[section].count - range.offset;
+    }
+
+    template <typename T>
+    [[nodiscard]] const T *records(Section section, std::uint64_t index) const noexcept {
+        return reinterpret_cast<const T *>(file.data() + header.sections[section].offset) + index;
+    }
+
+    template <typename T>
+    [[nodiscard]] T record(Section section, std::uint64_t index) const noexcept {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T result{};
+        std::memcpy(&result, records<T>(section, index), sizeof(T));
+        return result;
+    }
+
+    [[nodiscard]] std::optional<std::string_view> string(Range range) const {
+        if (not contains(STRINGS, range)) {
+            return std::nullopt;
+        }
+        return file.substr(header.sections[STRINGS].offset + range.offset, range.count);
+    }
+
+    [[nodiscard]] bool read_chunk(std::uint64_t index, Chunk &chunk) const {
+        if (index >= header.sections[CHUNKS].count) {
+            return false;
+        }
+        auto record = this->record<ChunkRecord>(CHUNKS, index);
+        if (not contains(CODE, record.code) || not contains(REFERENCES, record.references) ||
+            not contains(LINES, record.lines)) {
+            return false;
+        }
+
+        chunk.mapped.bytes = records<Chunk::InstructionSizeType>(CODE, record.code.offset);
+        chunk.mapped.size = record.code.count;
+        chunk.mapped.lines = records<Line>(LINES, record.lines.offset);
+        chunk.mapped.line_count = record.lines.count;
+
+        chunk.constants.reserve(record.references.count);
+        for (std::uint64_t i{0}; i < record.references.count; i++) {
+            auto reference = this->record<std::uint32_t>(REFERENCES, record.references.offset + i);
+            if (reference >= header.sections[CONSTANTS].count) {
+                return false;
+            }
+            auto constant = this->record<Constant>(CONSTANTS, reference);
+            switch (static_cast<Value::Tag>(constant.tag)) {
+                case Value::Tag::INT: chunk.add_constant(Value{static_cast<Value::IntType>(constant.value)}); break;
+                case Value::Tag::FLOAT: {
+                    Value::FloatType value{};
+                    std::memcpy(&value, &constant.value, sizeof(value));
+                    chunk.add_constant(Value{value});
+                    break;
+                }
+                case Value::Tag::STRING: {
+                    std::optional<std::string_view> string = this->string({constant.value, constant.length});
+                    if (not string.has_value()) {
+                        return false;
+                    }
+                    chunk.mapped.strings.resize(record.references.count);
+                    chunk.mapped.strings[i] = *string;
+                    chunk.add_constant(Value{static_cast<Value::StringType>(nullptr)});
+                    break;
+                }
+                case Value::Tag::BOOL: chunk.add_constant(Value{constant.value != 0}); break;
+                case Value::Tag::NULL_: chunk.add_constant(Value{nullptr}); break;
+                default: return false;
+            }
+        }
+        return check_code(chunk);
+    }
+
+    // The VM runs instructions without checking them, so code that could make it read a constant or jump outside of
+    // its chunk, or run off the end of it, is rejected. What the instructions do to the stack is not checked
+    [[nodiscard]] static bool check_code(const Chunk &chunk) {
+        const Chunk::InstructionSizeType *code = chunk.code();
+        std::size_t size = chunk.code_size();
+        if (size == 0) {
+            return false;
+        }
+        // A function whose body is an endless loop ends in the jump back to the start of the loop instead of a RETURN
+        switch (static_cast<Instruction>(code[size - 1] >> 24)) {
+            case Instruction::HALT:
+            case Instruction::RETURN:
+            case Instruction::TRAP_RETURN:
+            case Instruction::JUMP_BACKWARD: break;
+            default: return false;
+        }
+
+        for (std::size_t i{0}; i < size; i++) {
+            Chunk::InstructionSizeType opcode = code[i] >> 24;
+            Chunk::InstructionSizeType operand = code[i] & 0x00ff'ffff;
+            if (opcode >= instruction_count) {
+                return false;
+            }
+            // Jumps are relative to the instruction after the jump
+            switch (static_cast<Instruction>(opcode)) {
+                case Instruction::CONSTANT:
+                    if (operand >= chunk.constants.size()) {
+                        return false;
+                    }
+                    break;
+                case Instruction::CONSTANT_STRING:
+                    if (operand >= chunk.constants.size() || chunk.constants[operand].tag != Value::Tag::STRING) {
+                        return false;
+                    }
+                    break;
+                case Instruction::JUMP_FORWARD:
+                case Instruction::JUMP_IF_TRUE:
+                case Instruction::JUMP_IF_FALSE:
+                case Instruction::POP_JUMP_IF_EQUAL:
+                case Instruction::POP_JUMP_IF_FALSE:
+                case Instruction::POP_JUMP_IF_TRUE:
+                    if (operand >= size - i - 1) {
+                        return false;
+                    }
+                    break;
+                case Instruction::JUMP_BACKWARD:
+                case Instruction::POP_JUMP_BACK_IF_TRUE:
+                case Instruction::FOR_ITER:
+                    if (operand > i + 1) {
+                        return false;
+                    }
+                    break;
+                default: break;
+            }
+        }
+        return true;
+    }
+};
+} // namespace
+
+std::optional<std::string> write(const RuntimeModule &module) {
+    Writer writer{};
+    std::optional<std::uint64_t> top_level_chunk = writer.add_chunk(module.top_level_code);
+    if (not top_level_chunk.has_value()) {
+        return std::nullopt;
+    }
+
+    // The functions are written in order of their names, so that compiling the same code always gives the same file
+    std::vector<const std::pair<const std::string, RuntimeFunction> *> functions{};
+    for (const auto &function : module.functions) {
+        functions.push_back(&function);
+    }
+    std::sort(functions.begin(), functions.end(), [](auto *x1, auto *x2) { return x1->first < x2->first; });
+    for (auto *function : functions) {
+        if (not writer.add_function(function->first, function->second)) {
+            return std::nullopt;
+        }
+    }
+
+    Range name = writer.add_string(module.name);
+    return writer.finish(static_cast<std::uint32_t>(*top_level_chunk), name);
+}
+
+std::optional<RuntimeModule> read(std::string_view file) {
+    Reader reader{file};
+    if (not reader.read_header()) {
+        return std::nullopt;
+    }
+
+    const Header &header = reader.get_header();
+    RuntimeModule module{};
+    std::optional<std::string_view> name = reader.string(header.name);
+    if (not name.has_value() || not reader.read_chunk(header.top_level_chunk, module.top_level_code)) {
+        return std::nullopt;
+    }
+    module.name = *name;
+
+    for (std::uint64_t i{0}; i < header.sections[FUNCTIONS].count; i++) {
+        auto record = reader.record<FunctionRecord>(FUNCTIONS, i);
+        std::optional<std::string_view> key = reader.string(record.key);
+        std::optional<std::string_view> function_name = reader.string(record.name);
+        if (not key.has_value() || not function_name.has_value()) {
+            return std::nullopt;
+        }
+
+        RuntimeFunction &function = module.functions[std::string{*key}];
+        function.name = *function_name;
+        function.arity = record.arity;
+        if (not reader.read_chunk(record.chunk, function.code)) {
+            return std::nullopt;
+        }
+    }
+    return std::optional<RuntimeModule>{std::move(module)};
+}
+} // namespace bytecode
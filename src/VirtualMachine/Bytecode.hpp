@@ -0,0 +1,83 @@
+#pragma once
+
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+
+#ifndef BYTECODE_HPP
+#define BYTECODE_HPP
+
+#include "Module.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// The file format for compiled modules, which `wis --emit-bytecode` writes and wisVM runs. A file is a header followed
+// by sections of fixed size records, each of which starts at a multiple of eight bytes from the start of the file:
+//
+//   strings    | The characters of every string in the module, one after the other
+//   constants  | The constant pool, where every distinct constant in the module is kept once
+//   references | For every chunk, the index in the constant pool of each of the constants of the chunk
+//   code       | The instructions of every chunk
+//   lines      | The line numbers of the instructions of every chunk, run length encoded like in Chunk
+//   chunks     | Where the code, constant references and line numbers of every chunk are
+//   functions  | The name, arity and chunk of every function
+//
+// The records are laid out the way the machine writing them lays them out, and the header records the byte order so
+// that a file is never read on a machine with a different one. Any change to the layout has to bump the version
+namespace bytecode {
+constexpr char magic[4] = {'W', 'I', 'S', 'B'};
+constexpr std::uint32_t version = 1;
+constexpr std::uint32_t byte_order = 0x01020304;
+
+struct Range {
+    std::uint64_t offset{}; // In records of the section (in bytes for the file and the strings section)
+    std::uint64_t count{};
+};
+
+enum Section : std::size_t { STRINGS, CONSTANTS, REFERENCES, CODE, LINES, CHUNKS, FUNCTIONS, SECTION_COUNT };
+
+struct Header {
+    char magic[4]{};
+    std::uint32_t version{};
+    std::uint32_t byte_order{};
+    std::uint32_t top_level_chunk{};
+    Range name{}; // In the strings section
+    Range sections[SECTION_COUNT]{};
+};
+
+struct Constant {
+    std::uint32_t tag{}; // A Value::Tag
+    std::uint32_t padding{};
+    std::uint64_t value{};  // The bits of the value, or the offset of a string in the strings section
+    std::uint64_t length{}; // The length of a string
+};
+
+using Line = Chunk::LineRun; // Chunks read from a file use the line numbers in place
+
+struct ChunkRecord {
+    Range code{};
+    Range references{};
+    Range lines{};
+};
+
+struct FunctionRecord {
+    Range key{}; // The name the function is looked up with, in the strings section
+    Range name{};
+    std::uint64_t arity{};
+    std::uint64_t chunk{};
+};
+
+// Empty if the module has a constant that cannot be written to a file
+[[nodiscard]] std::optional<std::string> write(const RuntimeModule &module);
+// Empty if the file is not a valid bytecode file of this version, or if the code of any of its chunks could read a
+// constant or jump outside of the chunk, run off its end or run an unknown instruction. The code, line numbers and
+// strings of the module are used in place, so the file has to be kept alive (and unchanged) for as long as the module
+// is, and has to start at a multiple of eight bytes in memory, like a mapped file does. Moving the MappedFile into the
+// `file` of the module does both
+[[nodiscard]] std::optional<RuntimeModule> read(std::string_view file);
+} // namespace bytecode
+
+#endif
@@ -20,25 +20,16 @@ std::size_t Chunk::add_string(std::string value) {
     return constants.size() - 1;
 }
 
+// The operand bytes are part of the instruction that was last emitted, so they do not count towards the line numbers
 std::size_t Chunk::emit_byte(Chunk::InstructionSizeType value) {
-    bytes.back() |= value;
-    if (line_numbers.empty()) {
-        line_numbers.emplace_back(1, 1);
-    } else {
-        line_numbers.back().second += 1;
-    }
+    bytes.back() |= value & 0xff;
     return bytes.size() - 1;
 }
 
 std::size_t Chunk::emit_bytes(Chunk::InstructionSizeType value_1, Chunk::InstructionSizeType value_2) {
-    bytes.back() |= value_1 << 8;
-    bytes.back() |= value_2 << 16;
-    if (line_numbers.empty()) {
-        line_numbers.emplace_back(1, 2);
-    } else {
-        line_numbers.back().second += 2;
-    }
-    return bytes.size() - 2;
+    bytes.back() |= (value_1 & 0xff) << 16;
+    bytes.back() |= (value_2 & 0xff) << 8;
+    return bytes.size() - 1;
 }
 
 std::size_t Chunk::emit_constant(Value value, std::size_t line_number) {
@@ -47,7 +38,7 @@ std::size_t Chunk::emit_constant(Value value, std::size_t line_number) {
         emit_instruction(Instruction::CONSTANT, line_number);
         emit_bytes((constant >> 16) & 0xff, (constant >> 8) & 0xff);
         emit_byte(constant & 0xff);
-        return bytes.size() - 4;
+        return bytes.size() - 1;
     } else {
         compile_error({"Too many constants in chunk"});
         return 0;
@@ -60,7 +51,7 @@ std::size_t Chunk::emit_string(std::string value, std::size_t line_number) {
         emit_instruction(Instruction::CONSTANT_STRING, line_number);
         emit_bytes((constant >> 16) & 0xff, (constant >> 8) & 0xff);
         emit_byte(constant & 0xff);
-        return bytes.size() - 4;
+        return bytes.size() - 1;
     } else {
         compile_error({"Too many constants in chunk"});
         return 0;
@@ -78,12 +69,33 @@ std::size_t Chunk::emit_instruction(Instruction instruction, std::size_t line_nu
     return bytes.size() - 1;
 }
 
-std::size_t Chunk::get_line_number(std::size_t insn_ptr) {
-    std::size_t i = 0;
-    long long signed_insn_number = insn_ptr;
-    while (signed_insn_number >= 0 && i < line_numbers.size()) {
-        signed_insn_number -= static_cast<long long>(line_numbers[i].second);
-        i++;
+// The string constants of a mapped chunk are only copied out of the file the first time that they are used
+const HashedString &Chunk::string_constant(std::size_t index) {
+    Value &constant = constants[index];
+    if (constant.w_str == nullptr) {
+        constant.w_str = &strings.emplace_back(std::string{mapped.strings[index]});
+    }
+    return *constant.w_str;
+}
+
+std::string_view Chunk::string_text(std::size_t index) const {
+    return constants[index].w_str != nullptr ? std::string_view{constants[index].w_str->str} : mapped.strings[index];
+}
+
+std::size_t Chunk::get_line_number(std::size_t insn_ptr) const {
+    auto find_line = [insn_ptr](const auto *runs, std::size_t run_count) -> std::size_t {
+        std::size_t i = 0;
+        long long signed_insn_number = insn_ptr;
+        while (signed_insn_number >= 0 && i < run_count) {
+            auto [line, count] = runs[i];
+            signed_insn_number -= static_cast<long long>(count);
+            i++;
+        }
+        auto [line, count] = runs[i - 1];
+        return line;
+    };
+    if (is_mapped()) {
+        return find_line(mapped.lines, mapped.line_count);
     }
-    return line_numbers[i - 1].first;
+    return find_line(line_numbers.data(), line_numbers.size());
 }
\ No newline at end of file
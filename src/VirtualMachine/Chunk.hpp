@@ -9,8 +9,10 @@
 #include "Instructions.hpp"
 #include "StringCacher.hpp"
 
+#include <cstdint>
 #include <deque>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -22,12 +24,31 @@ struct Chunk {
 
     using InstructionSizeType = std::uint32_t;
 
+    // A line and the number of instructions on it, the way bytecode files keep the line numbers of a chunk
+    struct LineRun {
+        std::uint32_t line{};
+        std::uint32_t count{};
+    };
+
+    // A chunk read from a bytecode file runs its code and finds its line numbers straight from the file, which has to
+    // outlive the chunk, so that only the pages with code that is actually run are ever read from the disk
+    struct Mapped {
+        const InstructionSizeType *bytes{nullptr};
+        std::size_t size{0};
+        const LineRun *lines{nullptr};
+        std::size_t line_count{0};
+        // The text of the string constants in the file, by the index of the constant. The constant itself stays null
+        // until it is first used
+        std::vector<std::string_view> strings{};
+    };
+
     std::vector<InstructionSizeType> bytes{};
     std::vector<Value> constants{};
     std::deque<HashedString> strings{};
     std::vector<std::pair<std::size_t, std::size_t>> line_numbers{};
     // Store line numbers of instructions using Run Length Encoding, first line number then instruction count for that
     // line
+    Mapped mapped{}; // Used instead of `bytes`, `line_numbers` and the string constants if `mapped.bytes` is set
 
     explicit Chunk() = default;
     std::size_t add_constant(Value value);
@@ -38,7 +59,13 @@ struct Chunk {
     std::size_t emit_string(std::string value, std::size_t line_number);
     std::size_t emit_instruction(Instruction instruction, std::size_t line_number);
 
-    std::size_t get_line_number(std::size_t insn_ptr);
+    [[nodiscard]] bool is_mapped() const noexcept { return mapped.bytes != nullptr; }
+    [[nodiscard]] const InstructionSizeType *code() const noexcept { return is_mapped() ? mapped.bytes : bytes.data(); }
+    [[nodiscard]] std::size_t code_size() const noexcept { return is_mapped() ? mapped.size : bytes.size(); }
+    const HashedString &string_constant(std::size_t index);
+    [[nodiscard]] std::string_view string_text(std::size_t index) const;
+
+    std::size_t get_line_number(std::size_t insn_ptr) const;
 };
 
 #endif
\ No newline at end of file
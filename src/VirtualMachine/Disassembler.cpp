@@ -24,8 +24,8 @@ void disassemble(Chunk &chunk, std::string_view name) {
     print_tab(1, 4) << "--------";
     print_tab(1, 4) << "----------- ------------------------------------------------------\n";
     std::size_t i = 0;
-    while (i < chunk.bytes.size()) {
-        disassemble_instruction(chunk, static_cast<Instruction>(chunk.bytes[i] >> 24), i);
+    while (i < chunk.code_size()) {
+        disassemble_instruction(chunk, static_cast<Instruction>(chunk.code()[i] >> 24), i);
         i++;
     }
 }
@@ -46,13 +46,13 @@ std::ostream &print_preamble(Chunk &chunk, std::string_view name, std::size_t by
 }
 
 void instruction(Chunk &chunk, std::string_view name, std::size_t where) {
-    print_preamble(chunk, name, where * 4, where + 1);
-    std::size_t next_bytes = chunk.bytes[where] & 0x00ff'ffff;
+    print_preamble(chunk, name, where * 4, where);
+    std::size_t next_bytes = chunk.code()[where] & 0x00ff'ffff;
 
     auto print_trailing_bytes = [&chunk, &where] {
         for (int i = 1; i < 4; i++) {
-            std::size_t offset_bit = chunk.bytes[where] & (0xff << (8 * (3 - i)));
-            print_preamble(chunk, "", where * 4 + i, where + 1) << "| " << std::hex << std::setw(8) << offset_bit;
+            std::size_t offset_bit = chunk.code()[where] & (0xff << (8 * (3 - i)));
+            print_preamble(chunk, "", where * 4 + i, where) << "| " << std::hex << std::setw(8) << offset_bit;
             print_tab(1, 2) << std::resetiosflags(std::ios_base::hex) << std::setw(8) << offset_bit << '\n';
         }
     };
@@ -60,15 +60,17 @@ void instruction(Chunk &chunk, std::string_view name, std::size_t where) {
     // To avoid polluting the output with unnecessary zeroes, the instruction operand is only printed for specific
     // instructions
     if (name == "CONSTANT" || name == "CONSTANT_STRING") {
+        Value constant =
+            name == "CONSTANT_STRING" ? Value{&chunk.string_constant(next_bytes)} : chunk.constants[next_bytes];
         std::cout << "\t\t";
-        print_tab(1) << "-> " << next_bytes << " | value = " << chunk.constants[next_bytes].repr() << '\n';
+        print_tab(1) << "-> " << next_bytes << " | value = " << constant.repr() << '\n';
         print_trailing_bytes();
-    } else if (name == "JUMP_FORWARD" || name == "POP_JUMP_IF_FALSE" || name == "JUMP_IF_FALSE" ||
-               name == "JUMP_IF_TRUE" || name == "POP_JUMP_IF_EQUAL") {
+    } else if (name == "JUMP_FORWARD" || name == "POP_JUMP_IF_FALSE" || name == "POP_JUMP_IF_TRUE" ||
+               name == "JUMP_IF_FALSE" || name == "JUMP_IF_TRUE" || name == "POP_JUMP_IF_EQUAL") {
         std::cout << "\t\t| offset = +" << (next_bytes + 1) * 4 << " bytes, jump to = " << 4 * (where + next_bytes + 1)
                   << '\n';
         print_trailing_bytes();
-    } else if (name == "JUMP_BACKWARD" || name == "POP_JUMP_BACK_IF_TRUE") {
+    } else if (name == "JUMP_BACKWARD" || name == "POP_JUMP_BACK_IF_TRUE" || name == "FOR_ITER") {
         std::cout << "\t\t| offset = -" << (next_bytes - 1) * 4 << " bytes, jump to = " << 4 * (where + 1 - next_bytes)
                   << '\n';
         print_trailing_bytes();
@@ -96,6 +98,18 @@ void instruction(Chunk &chunk, std::string_view name, std::size_t where) {
     } else if (name == "ASSIGN_FROM_TOP") {
         std::cout << "\t\t| assign " << next_bytes << " from top\n";
         print_trailing_bytes();
+    } else if (name == "MAKE_TUPLE") {
+        std::cout << "\t\t| " << next_bytes << " element(s)\n";
+        print_trailing_bytes();
+    } else if (name == "INDEX_TUPLE" || name == "ASSIGN_TUPLE") {
+        std::cout << "\t\t| element " << next_bytes << '\n';
+        print_trailing_bytes();
+    } else if (name == "MAKE_LIST") {
+        std::cout << "\t\t| " << (next_bytes == 0 ? "heap" : "frame") << '\n';
+        print_trailing_bytes();
+    } else if (name == "MAKE_RANGE") {
+        std::cout << "\t\t| " << (next_bytes == 0 ? "exclusive" : "inclusive") << '\n';
+        print_trailing_bytes();
     } else if (name == "RETURN") {
         std::cout << "\t\t| pop " << next_bytes << " local(s)\n";
         print_trailing_bytes();
@@ -115,6 +129,8 @@ void disassemble_instruction(Chunk &chunk, Instruction insn, std::size_t where)
         case Instruction::IDIV: instruction(chunk, "IDIV", where); return;
         case Instruction::IMOD: instruction(chunk, "IMOD", where); return;
         case Instruction::INEG: instruction(chunk, "INEG", where); return;
+        case Instruction::IDIV_NONZERO: instruction(chunk, "IDIV_NONZERO", where); return;
+        case Instruction::IMOD_NONZERO: instruction(chunk, "IMOD_NONZERO", where); return;
         case Instruction::FADD: instruction(chunk, "FADD", where); return;
         case Instruction::FSUB: instruction(chunk, "FSUB", where); return;
         case Instruction::FMUL: instruction(chunk, "FMUL", where); return;
@@ -133,6 +149,13 @@ void disassemble_instruction(Chunk &chunk, Instruction insn, std::size_t where)
         case Instruction::EQUAL: instruction(chunk, "EQUAL", where); return;
         case Instruction::GREATER: instruction(chunk, "GREATER", where); return;
         case Instruction::LESSER: instruction(chunk, "LESSER", where); return;
+        case Instruction::IEQ: instruction(chunk, "IEQ", where); return;
+        case Instruction::ILT: instruction(chunk, "ILT", where); return;
+        case Instruction::IGT: instruction(chunk, "IGT", where); return;
+        case Instruction::FEQ: instruction(chunk, "FEQ", where); return;
+        case Instruction::FLT: instruction(chunk, "FLT", where); return;
+        case Instruction::FGT: instruction(chunk, "FGT", where); return;
+        case Instruction::SEQ: instruction(chunk, "SEQ", where); return;
         case Instruction::PUSH_TRUE: instruction(chunk, "PUSH_TRUE", where); return;
         case Instruction::PUSH_FALSE: instruction(chunk, "PUSH_FALSE", where); return;
         case Instruction::PUSH_NULL: instruction(chunk, "PUSH_NULL", where); return;
@@ -142,7 +165,9 @@ void disassemble_instruction(Chunk &chunk, Instruction insn, std::size_t where)
         case Instruction::JUMP_IF_FALSE: instruction(chunk, "JUMP_IF_FALSE", where); return;
         case Instruction::POP_JUMP_IF_EQUAL: instruction(chunk, "POP_JUMP_IF_EQUAL", where); return;
         case Instruction::POP_JUMP_IF_FALSE: instruction(chunk, "POP_JUMP_IF_FALSE", where); return;
+        case Instruction::POP_JUMP_IF_TRUE: instruction(chunk, "POP_JUMP_IF_TRUE", where); return;
         case Instruction::POP_JUMP_BACK_IF_TRUE: instruction(chunk, "POP_JUMP_BACK_IF_TRUE", where); return;
+        case Instruction::FOR_ITER: instruction(chunk, "FOR_ITER", where); return;
         case Instruction::ASSIGN_LOCAL: instruction(chunk, "ASSIGN_LOCAL", where); return;
         case Instruction::ACCESS_LOCAL: instruction(chunk, "ACCESS_LOCAL", where); return;
         case Instruction::MAKE_REF_TO_LOCAL: instruction(chunk, "MAKE_REF_TO_LOCAL", where); return;
@@ -173,6 +198,11 @@ void disassemble_instruction(Chunk &chunk, Instruction insn, std::size_t where)
         case Instruction::ASSIGN_LOCAL_LIST: instruction(chunk, "ASSIGN_LOCAL_LIST", where); return;
         case Instruction::ASSIGN_GLOBAL_LIST: instruction(chunk, "ASSIGN_GLOBAL_LIST", where); return;
         case Instruction::POP_LIST: instruction(chunk, "POP_LIST", where); return;
+        case Instruction::MAKE_TUPLE: instruction(chunk, "MAKE_TUPLE", where); return;
+        case Instruction::INDEX_TUPLE: instruction(chunk, "INDEX_TUPLE", where); return;
+        case Instruction::ASSIGN_TUPLE: instruction(chunk, "ASSIGN_TUPLE", where); return;
+        case Instruction::MAKE_RANGE: instruction(chunk, "MAKE_RANGE", where); return;
+        case Instruction::RANGE_TO_LIST: instruction(chunk, "RANGE_TO_LIST", where); return;
         case Instruction::ACCESS_FROM_TOP: instruction(chunk, "ACCESS_FROM_TOP", where); return;
         case Instruction::ASSIGN_FROM_TOP: instruction(chunk, "ASSIGN_FROM_TOP", where); return;
         case Instruction::EQUAL_SL: instruction(chunk, "EQUAL_SL", where); return;
@@ -18,6 +18,8 @@ enum class Instruction {
     IDIV,
     IMOD,
     INEG, // (unary -)
+    IDIV_NONZERO, // Division and modulo by a constant that is not zero, which need no check
+    IMOD_NONZERO,
     /* Floating point operations */
     FADD,
     FSUB,
@@ -40,6 +42,14 @@ enum class Instruction {
     EQUAL,
     GREATER,
     LESSER,
+    /* Comparisons for operands whose type is known at compile time */
+    IEQ,
+    ILT,
+    IGT,
+    FEQ,
+    FLT,
+    FGT,
+    SEQ,
     /* Constant operations */
     PUSH_TRUE,
     PUSH_FALSE,
@@ -51,7 +61,9 @@ enum class Instruction {
     JUMP_IF_FALSE,
     POP_JUMP_IF_EQUAL,
     POP_JUMP_IF_FALSE,
+    POP_JUMP_IF_TRUE,
     POP_JUMP_BACK_IF_TRUE,
+    FOR_ITER,
     /* Local variable operations */
     ASSIGN_LOCAL,
     ACCESS_LOCAL,
@@ -87,10 +99,20 @@ enum class Instruction {
     ASSIGN_LOCAL_LIST,
     ASSIGN_GLOBAL_LIST,
     POP_LIST,
+    /* Tuple instructions */
+    MAKE_TUPLE,
+    INDEX_TUPLE,
+    ASSIGN_TUPLE,
+    /* Range instructions */
+    MAKE_RANGE,
+    RANGE_TO_LIST,
     /* Miscellaneous */
     ACCESS_FROM_TOP,
     ASSIGN_FROM_TOP,
     EQUAL_SL, // Equality operation for lists and strings
 };
 
+// Has to be kept one past the last instruction above
+constexpr unsigned instruction_count = static_cast<unsigned>(Instruction::EQUAL_SL) + 1;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,148 @@
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+#include "ListPool.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+std::size_t ListPool::size_class_of(std::size_t bytes) noexcept {
+    // Maps the number of 16 byte units needed (rounded up) to the smallest size class that fits them
+    constexpr static auto table = [] {
+        std::array<std::uint8_t, max_block_size / min_block_size + 1> result{};
+        std::size_t size_class = 0;
+        for (std::size_t units = 0; units < result.size(); units++) {
+            while ((min_block_size << size_class) < units * min_block_size) {
+                size_class++;
+            }
+            result[units] = static_cast<std::uint8_t>(size_class);
+        }
+        return result;
+    }();
+    return table[(bytes + min_block_size - 1) / min_block_size];
+}
+
+void ListPool::refill(SizeClass &size_class, std::size_t block_size) {
+    slabs.emplace_back(new std::byte[slab_size]);
+    statistics.slabs++;
+    size_class.bump = slabs.back().get();
+    size_class.bump_end = size_class.bump + (slab_size / block_size) * block_size;
+}
+
+void *ListPool::allocate(std::size_t bytes) {
+    statistics.allocations++;
+    statistics.live_bytes += bytes;
+    statistics.peak_bytes = std::max(statistics.peak_bytes, statistics.live_bytes);
+
+    if (bytes > max_block_size) {
+        statistics.oversized++;
+        return ::operator new(bytes);
+    }
+
+    std::size_t index = size_class_of(bytes);
+    std::size_t block_size = min_block_size << index;
+    SizeClass &size_class = classes[index];
+    statistics.class_allocations[index]++;
+
+    if (size_class.free_list != nullptr) {
+        FreeBlock *block = size_class.free_list;
+        size_class.free_list = block->next;
+        statistics.reused++;
+        return block;
+    }
+
+    if (size_class.bump == size_class.bump_end) {
+        refill(size_class, block_size);
+    }
+    void *block = size_class.bump;
+    size_class.bump += block_size;
+    return block;
+}
+
+void ListPool::deallocate(void *pointer, std::size_t bytes) noexcept {
+    statistics.deallocations++;
+    statistics.live_bytes -= bytes;
+
+    if (bytes > max_block_size) {
+        ::operator delete(pointer);
+        return;
+    }
+
+    SizeClass &size_class = classes[size_class_of(bytes)];
+    auto *block = static_cast<FreeBlock *>(pointer);
+    block->next = size_class.free_list;
+    size_class.free_list = block;
+}
+
+const ListPool::Stats &ListPool::stats() const noexcept {
+    return statistics;
+}
+
+void ListPool::print_stats(std::ostream &out) const {
+    out << "List pool statistics:\n";
+    out << "  allocations:   " << statistics.allocations << '\n';
+    out << "  deallocations: " << statistics.deallocations << '\n';
+    out << "  reused:        " << statistics.reused << '\n';
+    out << "  oversized:     " << statistics.oversized << '\n';
+    out << "  slabs:         " << statistics.slabs << " (" << statistics.slabs * slab_size << " bytes)\n";
+    out << "  live bytes:    " << statistics.live_bytes << '\n';
+    out << "  peak bytes:    " << statistics.peak_bytes << '\n';
+    for (std::size_t i = 0; i < size_class_count; i++) {
+        out << "  " << (min_block_size << i) << " byte blocks: " << statistics.class_allocations[i] << '\n';
+    }
+}
+
+std::size_t ListArena::bytes_before(Mark mark) const noexcept {
+    // The unused space at the end of the blocks that were skipped over counts as used, since it cannot be handed out
+    std::size_t bytes = mark.offset;
+    for (std::size_t i = 0; i < mark.block; i++) {
+        bytes += blocks[i].size;
+    }
+    return bytes;
+}
+
+void *ListArena::allocate(std::size_t bytes) {
+    statistics.allocations++;
+    bytes = (bytes + alignment - 1) & ~(alignment - 1);
+
+    if (blocks.empty() || top.offset + bytes > blocks[top.block].size) {
+        if (not blocks.empty()) {
+            top = {top.block + 1, 0};
+        }
+        if (top.block == blocks.size()) {
+            blocks.push_back({});
+        }
+        // Blocks past the top are unused, so a block that is too small can simply be replaced
+        if (Block &block = blocks[top.block]; block.size < bytes) {
+            block.size = std::max(block_size, bytes);
+            block.memory.reset(new std::byte[block.size]);
+            statistics.blocks++;
+        }
+    }
+
+    void *memory = blocks[top.block].memory.get() + top.offset;
+    top.offset += bytes;
+    statistics.live_bytes = bytes_before(top);
+    statistics.peak_bytes = std::max(statistics.peak_bytes, statistics.live_bytes);
+    return memory;
+}
+
+ListArena::Mark ListArena::mark() const noexcept {
+    return top;
+}
+
+void ListArena::release(Mark mark) noexcept {
+    top = mark;
+    statistics.live_bytes = bytes_before(top);
+}
+
+const ListArena::Stats &ListArena::stats() const noexcept {
+    return statistics;
+}
+
+void ListArena::print_stats(std::ostream &out) const {
+    out << "Frame list arena statistics:\n";
+    out << "  allocations:   " << statistics.allocations << '\n';
+    out << "  blocks:        " << statistics.blocks << '\n';
+    out << "  live bytes:    " << statistics.live_bytes << '\n';
+    out << "  peak bytes:    " << statistics.peak_bytes << '\n';
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+
+#ifndef LIST_POOL_HPP
+#define LIST_POOL_HPP
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <ostream>
+#include <vector>
+
+// A size-class slab allocator for list headers and small element buffers. Blocks of each size class are carved out
+// of large slabs and recycled through a free list, so creating and destroying short-lived lists (and tuples, which
+// are lists at runtime) does not go through malloc/free every time. Requests larger than the biggest size class are
+// forwarded to the global allocator
+class ListPool {
+  public:
+    constexpr static std::size_t min_block_size = 16;
+    constexpr static std::size_t size_class_count = 7; // 16, 32, 64, ..., 1024 bytes
+    constexpr static std::size_t max_block_size = min_block_size << (size_class_count - 1);
+    constexpr static std::size_t slab_size = 64 * 1024;
+
+    struct Stats {
+        std::size_t allocations{};   // Total number of allocations requested
+        std::size_t deallocations{}; // Total number of deallocations requested
+        std::size_t reused{};        // Allocations served from a free list
+        std::size_t oversized{};     // Allocations too large for any size class
+        std::size_t slabs{};         // Number of slabs allocated
+        std::size_t live_bytes{};    // Bytes currently handed out, including oversized allocations
+        std::size_t peak_bytes{};    // Maximum value reached by live_bytes
+        std::array<std::size_t, size_class_count> class_allocations{};
+    };
+
+  private:
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    struct SizeClass {
+        FreeBlock *free_list{};
+        std::byte *bump{};     // The next unused block in the current slab
+        std::byte *bump_end{}; // The end of the current slab
+    };
+
+    std::array<SizeClass, size_class_count> classes{};
+    std::vector<std::unique_ptr<std::byte[]>> slabs{};
+    Stats statistics{};
+
+    [[nodiscard]] static std::size_t size_class_of(std::size_t bytes) noexcept;
+    void refill(SizeClass &size_class, std::size_t block_size);
+
+  public:
+    ListPool() noexcept = default;
+    ~ListPool() = default;
+
+    ListPool(const ListPool &) = delete;
+    ListPool &operator=(const ListPool &) = delete;
+
+    [[nodiscard]] void *allocate(std::size_t bytes);
+    void deallocate(void *pointer, std::size_t bytes) noexcept;
+
+    [[nodiscard]] const Stats &stats() const noexcept;
+    void print_stats(std::ostream &out) const;
+};
+
+// A bump allocator for the lists that the generator has found can never outlive the call that creates them (see
+// EscapeAnalysis). Nothing is freed individually: the VM takes a mark when a function is called and releases
+// everything allocated after it in one go when the function returns. Blocks are kept around once allocated, so calls
+// after the first one that needs them do not allocate at all
+class ListArena {
+  public:
+    constexpr static std::size_t block_size = 64 * 1024;
+    constexpr static std::size_t alignment = alignof(std::max_align_t);
+
+    struct Mark {
+        std::size_t block{};
+        std::size_t offset{};
+    };
+
+    struct Stats {
+        std::size_t allocations{}; // Total number of allocations requested
+        std::size_t blocks{};      // Number of blocks allocated
+        std::size_t live_bytes{};  // Bytes currently handed out, including the padding for alignment
+        std::size_t peak_bytes{};  // Maximum value reached by live_bytes
+    };
+
+  private:
+    struct Block {
+        std::unique_ptr<std::byte[]> memory{};
+        std::size_t size{};
+    };
+
+    std::vector<Block> blocks{};
+    Mark top{};
+    Stats statistics{};
+
+    [[nodiscard]] std::size_t bytes_before(Mark mark) const noexcept;
+
+  public:
+    ListArena() noexcept = default;
+    ~ListArena() = default;
+
+    ListArena(const ListArena &) = delete;
+    ListArena &operator=(const ListArena &) = delete;
+
+    [[nodiscard]] void *allocate(std::size_t bytes);
+    [[nodiscard]] Mark mark() const noexcept;
+    void release(Mark mark) noexcept;
+
+    [[nodiscard]] const Stats &stats() const noexcept;
+    void print_stats(std::ostream &out) const;
+};
+
+// An allocator that draws from a ListPool or a ListArena. A default constructed allocator has neither and uses the
+// global allocator, so that lists created outside the VM keep working. Deallocating memory from an arena does nothing,
+// it is reclaimed when the arena is released
+template <typename T>
+class PoolAllocator {
+    template <typename U>
+    friend class PoolAllocator;
+
+    ListPool *pool{};
+    ListArena *arena{};
+
+  public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    PoolAllocator() noexcept = default;
+    explicit PoolAllocator(ListPool *pool) noexcept : pool{pool} {}
+    explicit PoolAllocator(ListArena *arena) noexcept : arena{arena} {}
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &other) noexcept : pool{other.pool}, arena{other.arena} {}
+
+    [[nodiscard]] bool uses_arena() const noexcept { return arena != nullptr; }
+
+    [[nodiscard]] T *allocate(std::size_t n) {
+        if (arena != nullptr) {
+            return static_cast<T *>(arena->allocate(n * sizeof(T)));
+        } else if (pool == nullptr) {
+            return static_cast<T *>(::operator new(n * sizeof(T)));
+        }
+        return static_cast<T *>(pool->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T *pointer, std::size_t n) noexcept {
+        if (arena != nullptr) {
+            return;
+        } else if (pool == nullptr) {
+            ::operator delete(pointer);
+        } else {
+            pool->deallocate(pointer, n * sizeof(T));
+        }
+    }
+
+    template <typename U>
+    [[nodiscard]] bool operator==(const PoolAllocator<U> &other) const noexcept {
+        return pool == other.pool && arena == other.arena;
+    }
+    template <typename U>
+    [[nodiscard]] bool operator!=(const PoolAllocator<U> &other) const noexcept {
+        return pool != other.pool || arena != other.arena;
+    }
+};
+
+#endif
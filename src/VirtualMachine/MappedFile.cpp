@@ -0,0 +1,82 @@
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+#include "MappedFile.hpp"
+
+#include <fstream>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define WIS_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string &path) {
+#if defined(WIS_HAS_MMAP)
+    if (int fd = open(path.c_str(), O_RDONLY); fd != -1) {
+        struct stat status {};
+        if (fstat(fd, &status) == 0 && status.st_size > 0) {
+            void *mapping = mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+                data = static_cast<const char *>(mapping);
+                size = static_cast<std::size_t>(status.st_size);
+                mapped = true;
+            }
+        }
+        // The mapping stays valid after the file is closed
+        close(fd);
+        if (mapped) {
+            return;
+        }
+    }
+#endif
+
+    std::ifstream file{path, std::ios::in | std::ios::binary | std::ios::ate};
+    if (std::streamoff end = file.is_open() ? static_cast<std::streamoff>(file.tellg()) : -1; end >= 0) {
+        auto file_size = static_cast<std::size_t>(end);
+        file.seekg(0);
+        // Even an empty file gets a buffer, so that it counts as open
+        contents_read = std::make_unique<char[]>(file_size + 1);
+        if (file.read(contents_read.get(), static_cast<std::streamsize>(file_size))) {
+            data = contents_read.get();
+            size = file_size;
+        } else {
+            contents_read.reset();
+        }
+    }
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : data{std::exchange(other.data, nullptr)},
+      size{std::exchange(other.size, 0)},
+      mapped{std::exchange(other.mapped, false)},
+      contents_read{std::move(other.contents_read)} {}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+        release();
+        data = std::exchange(other.data, nullptr);
+        size = std::exchange(other.size, 0);
+        mapped = std::exchange(other.mapped, false);
+        contents_read = std::move(other.contents_read);
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile() noexcept {
+    release();
+}
+
+void MappedFile::release() noexcept {
+#if defined(WIS_HAS_MMAP)
+    if (mapped) {
+        munmap(const_cast<char *>(data), size);
+    }
+#endif
+    data = nullptr;
+    size = 0;
+    mapped = false;
+    contents_read.reset();
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// A file mapped read-only into memory, which is only read from the disk as the pages of it are touched. Where mmap is
+// not available, the file is read into memory as a whole instead. Either way the contents start at a multiple of eight
+// bytes, and stay where they are when the MappedFile is moved
+class MappedFile {
+    const char *data{nullptr};
+    std::size_t size{0};
+    bool mapped{false};
+    std::unique_ptr<char[]> contents_read{}; // Only used when the file could not be mapped
+
+    void release() noexcept;
+
+  public:
+    MappedFile() noexcept = default;
+    explicit MappedFile(const std::string &path);
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+    ~MappedFile() noexcept;
+
+    [[nodiscard]] bool is_open() const noexcept { return data != nullptr; }
+    [[nodiscard]] std::string_view contents() const noexcept { return {data, size}; }
+};
+
+#endif
@@ -8,24 +8,43 @@
 
 #include "../AST.hpp"
 #include "Chunk.hpp"
+#include "MappedFile.hpp"
 
+#include <deque>
 #include <string>
 #include <string_view>
 #include <unordered_map>
 #include <vector>
 
 struct Module {
+    // A module named by an import statement, which the module loader loads once the importing module has been parsed
+    struct Import {
+        std::string path{};
+        std::string name{};
+        std::string directory{};
+    };
+
     std::string name{};
     std::string module_directory{};
+    std::string path{}; // The file the module was read from
+    // The source code of the module followed by the strings that had to be built while scanning and parsing it, which
+    // the lexemes of the tokens in its AST refer into. A deque never moves its elements, not even when it is moved
+    std::deque<std::string> text{};
+    NodeArena nodes{}; // Everything in the AST of the module, and the types made for it
     std::unordered_map<std::string_view, ClassStmt *> classes{};
     std::unordered_map<std::string_view, FunctionStmt *> functions{};
     std::vector<StmtNode> statements{};
-    std::vector<std::size_t> imported{}; // Indexes into Parser::parsed_modules (better than pointers)
+    std::vector<TypeNode> types{}; // Types made by the type resolver, so that it can reuse them
+    std::vector<Import> imports{};
+    std::vector<std::size_t> imported{}; // Indexes into ModuleLoader::get_modules() (better than pointers)
 
     explicit Module(std::string_view name, std::string_view dir) : name{name}, module_directory{dir} {}
 
-    Module(const Module &) = default;
-    Module &operator=(const Module &) = default;
+    // Keeps a string alive for as long as the module is
+    std::string_view store(std::string string) { return text.emplace_back(std::move(string)); }
+
+    Module(const Module &) = delete;
+    Module &operator=(const Module &) = delete;
     Module(Module &&) noexcept = default;
     Module &operator=(Module &&) noexcept = default;
     ~Module() = default;
@@ -38,6 +57,9 @@ struct RuntimeFunction {
 };
 
 struct RuntimeModule {
+    // The file the code was read from when it is run in place (see bytecode::read), which the chunks point into. It is
+    // declared first so that it is unmapped only after everything that points into it is gone
+    MappedFile file{};
     Chunk top_level_code{};
     std::unordered_map<std::string, RuntimeFunction> functions{};
     std::string name{};
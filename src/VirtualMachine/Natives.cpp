@@ -45,6 +45,8 @@ Value native_print(VirtualMachine &vm, Value *args) {
             native_print(vm, &*begin);
             std::cout << "]";
         }
+    } else if (arg.tag == Value::Tag::RANGE) {
+        std::cout << arg.repr();
     } else if (arg.tag == Value::Tag::INVALID) {
         std::cout << "<invalid!>";
     }
@@ -97,7 +99,7 @@ Value native_string(VirtualMachine &vm, Value *args) {
         return Value{&vm.store_string(arg.w_bool ? "true" : "false")};
     } else if (arg.tag == Value::Tag::REF) {
         return native_string(vm, arg.w_ref);
-    } else if (arg.tag == Value::Tag::LIST || arg.tag == Value::Tag::LIST_REF) {
+    } else if (arg.tag == Value::Tag::LIST || arg.tag == Value::Tag::LIST_REF || arg.tag == Value::Tag::RANGE) {
         return Value{&vm.store_string(arg.repr())};
     } else if (arg.tag == Value::Tag::INVALID) {
         return Value{&vm.store_string("invalid")};
@@ -124,6 +126,8 @@ Value native_size(VirtualMachine &vm, Value *args) {
         return Value{static_cast<Value::IntType>(arg.w_str->str.length())};
     } else if (arg.tag == Value::Tag::LIST || arg.tag == Value::Tag::LIST_REF) {
         return Value{static_cast<Value::IntType>(arg.w_list->size())};
+    } else if (arg.tag == Value::Tag::RANGE) {
+        return Value{arg.range_size()};
     } else if (arg.tag == Value::Tag::REF) {
         return native_string(vm, arg.w_ref);
     }
@@ -1,5 +1,56 @@
+/* Copyright (C) 2021  Dhruv Chawla */
+/* See LICENSE at project root for license details */
+#include "../ErrorLogger/ErrorLogger.hpp"
+#include "Bytecode.hpp"
+#include "MappedFile.hpp"
 #include "VirtualMachine.hpp"
 
 #include <cxxopts.hpp>
+#include <iostream>
 
-int main() {}
\ No newline at end of file
+int main(int argc, char *argv[]) {
+    cxxopts::Options options{"wisVM", "Runs the bytecode files written by `wis --emit-bytecode`"};
+
+    // clang-format off
+    options.add_options()
+        ("file", "The bytecode file to run", cxxopts::value<std::string>())
+        ("trace-exec-stack", "Print the contents of the stack as the VM executes code", cxxopts::value<bool>()->default_value("false"))
+        ("trace-exec-insn", "Print the instructions as they are executed by the VM", cxxopts::value<bool>()->default_value("false"))
+        ("list-pool-stats", "Print the statistics of the list allocator after execution", cxxopts::value<bool>()->default_value("false"))
+        ("free-budget", "Release dead lists incrementally, this many elements per list allocation or destruction (0 releases them immediately)", cxxopts::value<std::size_t>()->default_value("0"))
+        ("h,help", "Print usage");
+    // clang-format on
+
+    try {
+        cxxopts::ParseResult result = options.parse(argc, argv);
+        if (result.arguments().empty() || result.count("help") || not result.count("file")) {
+            std::cout << options.help() << '\n';
+            return 0;
+        }
+
+        std::string path = result["file"].as<std::string>();
+        MappedFile file{path};
+        if (not file.is_open()) {
+            std::cerr << "Unable to open '" << path << "'\n";
+            return 1;
+        }
+
+        std::optional<RuntimeModule> module = bytecode::read(file.contents());
+        if (not module.has_value()) {
+            std::cerr << "'" << path << "' is not a bytecode file that this version of wisVM can run\n";
+            return 1;
+        }
+        module->file = std::move(file);
+
+        logger.set_module_name(module->name);
+        VirtualMachine vm{!!result.count("trace-exec-stack"), !!result.count("trace-exec-insn")};
+        vm.set_free_budget(result["free-budget"].as<std::size_t>());
+        vm.run(*module);
+        if (result.count("list-pool-stats")) {
+            vm.get_list_pool().print_stats(std::cout);
+            vm.get_list_arena().print_stats(std::cout);
+        }
+        return logger.had_runtime_error ? 1 : 0;
+    } catch (cxxopts::OptionException &ex) { std::cout << ex.what() << '\n'; }
+    return 0;
+}
@@ -16,6 +16,11 @@ Value::Value(NullType value) noexcept : w_null{value}, tag{Tag::NULL_} {}
 Value::Value(ReferenceType value) noexcept : w_ref{value}, tag{Tag::REF} {}
 Value::Value(FunctionType value) noexcept : w_fun{value}, tag{Tag::FUNCTION} {}
 Value::Value(ListType *value) noexcept : w_list{value}, tag{Tag::LIST} {}
+Value::Value(RangeType value) noexcept : w_range{value}, tag{Tag::RANGE} {}
+
+Value::IntType Value::range_size() const noexcept {
+    return w_range.start < w_range.end ? w_range.end - w_range.start : 0;
+}
 
 std::string Value::repr() const noexcept {
     if (tag == Tag::INT) {
@@ -82,6 +87,16 @@ std::string Value::repr() const noexcept {
         }
         result += begin->repr() + "]";
         return result;
+    } else if (tag == Tag::RANGE) {
+        if (range_size() == 0) {
+            return "[]";
+        }
+        std::string result = "[";
+        for (IntType i = w_range.start; i < w_range.end - 1; i++) {
+            result += std::to_string(i) + ", ";
+        }
+        result += std::to_string(w_range.end - 1) + "]";
+        return result;
     } else if (tag == Tag::INVALID) {
         return {"<invalid!>"};
     }
@@ -106,6 +121,8 @@ Value::operator bool() const noexcept {
         return true;
     } else if (tag == Tag::LIST || tag == Tag::LIST_REF) {
         return not w_list->empty();
+    } else if (tag == Tag::RANGE) {
+        return range_size() != 0;
     } else if (tag == Tag::INVALID) {
         return false;
     }
@@ -145,6 +162,8 @@ bool Value::operator==(const Value &other) const noexcept {
             }
         }
         return true;
+    } else if (tag == Tag::RANGE) {
+        return range_size() == other.range_size() && (range_size() == 0 || w_range.start == other.w_range.start);
     } else if (tag == Tag::INVALID) {
         return true;
     }
@@ -6,11 +6,13 @@
 #ifndef VALUE_HPP
 #define VALUE_HPP
 
+#include "ListPool.hpp"
 #include "Module.hpp"
 #include "StringCacher.hpp"
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 struct Value {
     struct PlaceHolder {};
@@ -22,7 +24,13 @@ struct Value {
     using NullType = std::nullptr_t;
     using ReferenceType = Value *;
     using FunctionType = RuntimeFunction *;
-    using ListType = std::vector<Value>;
+    using ListType = std::vector<Value, PoolAllocator<Value>>;
+    // A lazily evaluated `a..b` / `a..=b`, stored as the half-open interval [start, end). It is only turned into a
+    // real list when it is stored somewhere or mutated
+    struct RangeType {
+        IntType start;
+        IntType end;
+    };
 
     union {
         PlaceHolder w_invalid;
@@ -35,9 +43,10 @@ struct Value {
         ReferenceType w_ref;
         FunctionType w_fun;
         ListType *w_list;
+        RangeType w_range;
     };
 
-    enum class Tag { INVALID, INT, FLOAT, STRING, BOOL, NULL_, REF, FUNCTION, LIST, LIST_REF } tag;
+    enum class Tag { INVALID, INT, FLOAT, STRING, BOOL, NULL_, REF, FUNCTION, LIST, LIST_REF, RANGE } tag;
 
     Value() noexcept;
     explicit Value(IntType value) noexcept;
@@ -48,6 +57,9 @@ struct Value {
     explicit Value(ReferenceType value) noexcept;
     explicit Value(FunctionType value) noexcept;
     explicit Value(ListType *value) noexcept;
+    explicit Value(RangeType value) noexcept;
+
+    [[nodiscard]] IntType range_size() const noexcept;
 
     [[nodiscard]] std::string repr() const noexcept;
     [[nodiscard]] explicit operator bool() const noexcept;
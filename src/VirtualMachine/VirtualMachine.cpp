@@ -9,6 +9,8 @@
 
 #include <cmath>
 #include <iostream>
+#include <limits>
+#include <memory>
 
 #define is (Chunk::InstructionSizeType)
 
@@ -36,22 +38,73 @@ void VirtualMachine::pop() noexcept {
 }
 
 std::size_t VirtualMachine::get_current_line() const noexcept {
-    return current_chunk->get_line_number(ip - &current_chunk->bytes[0] - 1);
+    return current_chunk->get_line_number(ip - current_chunk->code() - 1);
 }
 
 void VirtualMachine::destroy_list(Value::ListType *list) {
-    for (auto &elem : *list) {
+    if (list->get_allocator().uses_arena()) {
+        destroy_frame_list(list);
+        return;
+    }
+    // With a free budget, dead lists are released a bit at a time instead of all at once, so that dropping a large
+    // structure does not stall the function return or pop that dropped it
+    dead_lists.emplace_back(list, 0);
+    sweep_dead_lists(free_budget);
+}
+
+void VirtualMachine::sweep_dead_lists(std::size_t budget) {
+    // Nested lists are pushed onto the work list instead of being recursed into, so arbitrarily deep lists cannot
+    // overflow the native stack
+    if (budget == 0) {
+        budget = std::numeric_limits<std::size_t>::max();
+    }
+    while (not dead_lists.empty() && budget > 0) {
+        auto [list, index] = dead_lists.back();
+        dead_lists.pop_back();
+        for (; index < list->size() && budget > 0; index++, budget--) {
+            Value &elem = (*list)[index];
+            if (elem.tag == Value::Tag::STRING) {
+                cache.remove(*elem.w_str);
+            } else if (elem.tag == Value::Tag::LIST) {
+                dead_lists.emplace_back(elem.w_list, 0);
+            }
+        }
+        if (index < list->size()) {
+            dead_lists.emplace_back(list, index);
+        } else {
+            std::destroy_at(list);
+            list_pool.deallocate(list, sizeof(Value::ListType));
+            budget -= (budget > 0);
+        }
+    }
+}
+
+void VirtualMachine::destroy_frame_list(Value::ListType *list) {
+    // The memory of the list is released with the rest of its frame, which can happen before a sweep gets to it, so
+    // its elements are released right away. Only the lists nested in it (which are never in the arena) are left to
+    // be swept
+    for (Value &elem : *list) {
         if (elem.tag == Value::Tag::STRING) {
             cache.remove(*elem.w_str);
         } else if (elem.tag == Value::Tag::LIST) {
-            destroy_list(elem.w_list);
+            dead_lists.emplace_back(elem.w_list, 0);
         }
     }
-    delete list;
+    std::destroy_at(list);
+    sweep_dead_lists(free_budget);
+}
+
+Value::ListType *VirtualMachine::make_frame_list() {
+    void *memory = list_arena.allocate(sizeof(Value::ListType));
+    return new (memory) Value::ListType{PoolAllocator<Value>{&list_arena}};
 }
 
 Value::ListType *VirtualMachine::make_new_list() {
-    return new Value::ListType;
+    if (not dead_lists.empty()) {
+        sweep_dead_lists(free_budget);
+    }
+    void *memory = list_pool.allocate(sizeof(Value::ListType));
+    return new (memory) Value::ListType{PoolAllocator<Value>{&list_pool}};
 }
 
 Value VirtualMachine::copy(Value &value) {
@@ -80,9 +133,10 @@ void VirtualMachine::copy_into(Value::ListType *list, Value::ListType *what) {
 void VirtualMachine::run(RuntimeModule &module) {
     current_module = &module;
     current_chunk = &module.top_level_code;
-    ip = &current_chunk->bytes[0];
+    ip = current_chunk->code();
     while (step() != ExecutionState::FINISHED)
         ;
+    sweep_dead_lists(0);
 }
 
 #define arith_binary_op(op, type, member)                                                                              \
@@ -102,6 +156,15 @@ void VirtualMachine::run(RuntimeModule &module) {
     }                                                                                                                  \
     break
 
+#define typed_comp_binary_op(op, type, member)                                                                         \
+    {                                                                                                                  \
+        Value::type val2 = stack[--stack_top].member;                                                                  \
+        Value::type val1 = stack[stack_top - 1].member;                                                                \
+        stack[stack_top - 1].w_bool = (val1 op val2);                                                                  \
+        stack[stack_top - 1].tag = Value::Tag::BOOL;                                                                   \
+    }                                                                                                                  \
+    break
+
 ExecutionState VirtualMachine::step() {
     if (trace_stack) {
         for (Value *begin{&stack[0]}; begin < &stack[stack_top]; begin++) {
@@ -110,7 +173,7 @@ ExecutionState VirtualMachine::step() {
         std::cout << '\n';
     }
     if (trace_insn) {
-        disassemble_instruction(*current_chunk, static_cast<Instruction>(*ip >> 24), (ip - &current_chunk->bytes[0]));
+        disassemble_instruction(*current_chunk, static_cast<Instruction>(*ip >> 24), (ip - current_chunk->code()));
     }
     Chunk::InstructionSizeType next = read_next();
     Chunk::InstructionSizeType instruction = next & 0xff00'0000;
@@ -148,6 +211,8 @@ ExecutionState VirtualMachine::step() {
             stack[stack_top - 1].w_int = -stack[stack_top - 1].w_int;
             break;
         }
+        case is Instruction::IDIV_NONZERO: arith_binary_op(/, IntType, w_int);
+        case is Instruction::IMOD_NONZERO: arith_binary_op(%, IntType, w_int);
         /* Floating point operations */
         case is Instruction::FADD: arith_binary_op(+, FloatType, w_float);
         case is Instruction::FSUB: arith_binary_op(-, FloatType, w_float);
@@ -210,6 +275,20 @@ ExecutionState VirtualMachine::step() {
         case is Instruction::EQUAL: comp_binary_op(==);
         case is Instruction::GREATER: comp_binary_op(>);
         case is Instruction::LESSER: comp_binary_op(<);
+        case is Instruction::IEQ: typed_comp_binary_op(==, IntType, w_int);
+        case is Instruction::ILT: typed_comp_binary_op(<, IntType, w_int);
+        case is Instruction::IGT: typed_comp_binary_op(>, IntType, w_int);
+        case is Instruction::FEQ: typed_comp_binary_op(==, FloatType, w_float);
+        case is Instruction::FLT: typed_comp_binary_op(<, FloatType, w_float);
+        case is Instruction::FGT: typed_comp_binary_op(>, FloatType, w_float);
+        case is Instruction::SEQ: {
+            Value::StringType val2 = stack[--stack_top].w_str;
+            Value::StringType val1 = stack[stack_top - 1].w_str;
+            stack[stack_top - 1] = Value{val1 == val2 || *val1 == *val2};
+            cache.remove(*val2);
+            cache.remove(*val1);
+            break;
+        }
         /* Constant operations */
         case is Instruction::PUSH_TRUE: {
             stack[stack_top].w_bool = true;
@@ -261,12 +340,58 @@ ExecutionState VirtualMachine::step() {
             }
             break;
         }
+        case is Instruction::POP_JUMP_IF_TRUE: {
+            if (stack[--stack_top]) {
+                ip += operand;
+            }
+            break;
+        }
         case is Instruction::POP_JUMP_BACK_IF_TRUE: {
             if (stack[--stack_top]) {
                 ip -= operand;
             }
             break;
         }
+        case is Instruction::FOR_ITER: {
+            // The stack contains the iterated value, the index of the next element and the loop variable, in order.
+            // The length is re-read every iteration so that modifying a list inside the loop cannot index past its end
+            Value *iterable = &stack[stack_top - 3];
+            Value &index = stack[stack_top - 2];
+            Value &element = stack[stack_top - 1];
+            if (iterable->tag == Value::Tag::REF) {
+                iterable = iterable->w_ref;
+            }
+
+            Value::IntType length = 0;
+            if (iterable->tag == Value::Tag::RANGE) {
+                length = iterable->range_size();
+            } else if (iterable->tag == Value::Tag::STRING) {
+                length = static_cast<Value::IntType>(iterable->w_str->str.size());
+            } else {
+                length = static_cast<Value::IntType>(iterable->w_list->size());
+            }
+
+            if (index.w_int < length) {
+                if (element.tag == Value::Tag::STRING) {
+                    cache.remove(*element.w_str);
+                }
+                if (iterable->tag == Value::Tag::RANGE) {
+                    element = Value{iterable->w_range.start + index.w_int};
+                } else if (iterable->tag == Value::Tag::STRING) {
+                    element = Value{&cache.insert({iterable->w_str->str[index.w_int]})};
+                } else {
+                    element = (*iterable->w_list)[index.w_int];
+                    if (element.tag == Value::Tag::STRING) {
+                        (void)cache.insert(*element.w_str);
+                    } else if (element.tag == Value::Tag::LIST) {
+                        element.tag = Value::Tag::LIST_REF;
+                    }
+                }
+                index.w_int++;
+                ip -= operand;
+            }
+            break;
+        }
         /* Local variable operations */
         case is Instruction::ASSIGN_LOCAL: {
             Value *assigned = &frames[frame_top].stack[operand];
@@ -299,7 +424,10 @@ ExecutionState VirtualMachine::step() {
             break;
         }
         case is Instruction::DEREF: {
-            stack[stack_top - 1] = *stack[stack_top - 1].w_ref;
+            // A reference to a list is the list itself tagged as LIST_REF, there is no pointer to follow for it
+            if (stack[stack_top - 1].tag == Value::Tag::REF) {
+                stack[stack_top - 1] = *stack[stack_top - 1].w_ref;
+            }
             break;
         }
         /* Global variable operations */
@@ -342,9 +470,9 @@ ExecutionState VirtualMachine::step() {
         }
         case is Instruction::CALL_FUNCTION: {
             RuntimeFunction *called = stack[--stack_top].w_fun;
-            frames[++frame_top] = CallFrame{&stack[stack_top - called->arity], current_chunk, ip};
+            frames[++frame_top] = CallFrame{&stack[stack_top - called->arity], current_chunk, ip, list_arena.mark()};
             current_chunk = &called->code;
-            ip = &called->code.bytes[0];
+            ip = called->code.code();
             break;
         }
         case is Instruction::CALL_NATIVE: {
@@ -366,6 +494,7 @@ ExecutionState VirtualMachine::step() {
                     destroy_list(stack[stack_top].w_list);
                 }
             }
+            list_arena.release(frames[frame_top].arena_mark);
             ip = frames[frame_top].return_ip;
             current_chunk = frames[frame_top--].return_chunk;
             break;
@@ -376,8 +505,7 @@ ExecutionState VirtualMachine::step() {
         }
         /* String instructions */
         case is Instruction::CONSTANT_STRING: {
-            Value::StringType string = current_chunk->constants[operand].w_str;
-            push(Value{&cache.insert(*string)});
+            push(Value{&cache.insert(current_chunk->string_constant(operand))});
             break;
         }
         case is Instruction::INDEX_STRING: {
@@ -419,8 +547,9 @@ ExecutionState VirtualMachine::step() {
         }
         /* List instructions */
         case is Instruction::MAKE_LIST: {
+            // A non-zero operand means the list never outlives the current call, see EscapeAnalysis
             std::size_t size = stack[--stack_top].w_int;
-            push(Value{make_new_list()});
+            push(Value{operand != 0 ? make_frame_list() : make_new_list()});
             if (size != 0) {
                 stack[stack_top - 1].w_list->resize(size);
             }
@@ -478,6 +607,10 @@ ExecutionState VirtualMachine::step() {
         case is Instruction::INDEX_LIST: {
             Value &index = stack[--stack_top];
             Value &list = stack[stack_top - 1];
+            if (list.tag == Value::Tag::RANGE) {
+                stack[stack_top - 1] = Value{list.w_range.start + index.w_int};
+                break;
+            }
             stack[stack_top - 1] = (*list.w_list)[index.w_int];
             if (stack[stack_top - 1].tag == Value::Tag::STRING) {
                 (void)cache.insert(*stack[stack_top - 1].w_str);
@@ -500,6 +633,13 @@ ExecutionState VirtualMachine::step() {
         case is Instruction::CHECK_LIST_INDEX: {
             Value &index = stack[stack_top - 1];
             Value &list = stack[stack_top - 2];
+            if (list.tag == Value::Tag::RANGE) {
+                if (index.w_int < 0 || index.w_int >= list.range_size()) {
+                    runtime_error("List index out of range", get_current_line());
+                    return ExecutionState::FINISHED;
+                }
+                break;
+            }
             if (index.w_int > static_cast<int>(list.w_list->size())) {
                 runtime_error("List index out of range", get_current_line());
                 return ExecutionState::FINISHED;
@@ -545,11 +685,75 @@ ExecutionState VirtualMachine::step() {
         case is Instruction::POP_LIST: {
             if (stack[stack_top - 1].tag == Value::Tag::LIST) {
                 destroy_list(stack[--stack_top].w_list);
-            } else if (stack[stack_top - 1].tag == Value::Tag::LIST_REF) {
+            } else if (stack[stack_top - 1].tag == Value::Tag::LIST_REF ||
+                       stack[stack_top - 1].tag == Value::Tag::RANGE ||
+                       stack[stack_top - 1].tag == Value::Tag::NULL_) {
+                // NULL is left in the loop variable of a for-each over a list of lists or tuples that had no elements
                 stack_top--;
             }
             break;
         }
+        /* Tuple instructions */
+        case is Instruction::MAKE_TUPLE: {
+            // The elements are already on the stack in order, so they are moved into a list of exactly the right size,
+            // with the list taking over the ownership of any strings or lists
+            Value::ListType *tuple = make_new_list();
+            tuple->assign(&stack[stack_top - operand], &stack[stack_top]);
+            stack_top -= operand;
+            push(Value{tuple});
+            break;
+        }
+        case is Instruction::INDEX_TUPLE: {
+            stack[stack_top - 1] = (*stack[stack_top - 1].w_list)[operand];
+            if (stack[stack_top - 1].tag == Value::Tag::STRING) {
+                (void)cache.insert(*stack[stack_top - 1].w_str);
+            } else if (stack[stack_top - 1].tag == Value::Tag::LIST) {
+                stack[stack_top - 1].tag = Value::Tag::LIST_REF;
+            }
+            break;
+        }
+        case is Instruction::ASSIGN_TUPLE: {
+            Value &assigned = stack[--stack_top];
+            Value &element = (*stack[stack_top - 1].w_list)[operand];
+            Value::Tag tag = element.tag;
+            if (tag == Value::Tag::LIST) {
+                destroy_list(element.w_list);
+            } else if (tag == Value::Tag::STRING) {
+                cache.remove(*element.w_str);
+                (void)cache.insert(*assigned.w_str);
+            }
+            element = assigned;
+            stack[stack_top - 1] = element;
+            if (tag == Value::Tag::LIST) {
+                stack[stack_top - 1].tag = Value::Tag::LIST_REF;
+            }
+            break;
+        }
+        /* Range instructions */
+        case is Instruction::MAKE_RANGE: {
+            Value::IntType end = stack[--stack_top].w_int;
+            Value::IntType start = stack[stack_top - 1].w_int;
+            if (operand != 0) {
+                if (end == std::numeric_limits<Value::IntType>::max()) {
+                    runtime_error("Range end is too large", get_current_line());
+                    return ExecutionState::FINISHED;
+                }
+                end++;
+            }
+            stack[stack_top - 1] = Value{Value::RangeType{start, end}};
+            break;
+        }
+        case is Instruction::RANGE_TO_LIST: {
+            // Only ranges that end up being stored or modified are materialized, see Generator::visit(BinaryExpr &)
+            Value::RangeType range = stack[stack_top - 1].w_range;
+            Value::ListType *list = make_new_list();
+            list->reserve(stack[stack_top - 1].range_size());
+            for (Value::IntType i = range.start; i < range.end; i++) {
+                list->emplace_back(i);
+            }
+            stack[stack_top - 1] = Value{list};
+            break;
+        }
         /* Miscellaneous */
         case is Instruction::ACCESS_FROM_TOP: {
             push(stack[stack_top - operand]);
@@ -593,5 +797,18 @@ const HashedString &VirtualMachine::store_string(std::string str) {
     return cache.insert(std::move(str));
 }
 
+const ListPool &VirtualMachine::get_list_pool() const noexcept {
+    return list_pool;
+}
+
+const ListArena &VirtualMachine::get_list_arena() const noexcept {
+    return list_arena;
+}
+
+void VirtualMachine::set_free_budget(std::size_t budget) noexcept {
+    free_budget = budget;
+}
+
 #undef arith_binary_op
-#undef comp_binary_op
\ No newline at end of file
+#undef comp_binary_op
+#undef typed_comp_binary_op
\ No newline at end of file
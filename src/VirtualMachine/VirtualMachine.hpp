@@ -6,17 +6,21 @@
 #ifndef VIRTUAL_MACHINE_HPP
 #define VIRTUAL_MACHINE_HPP
 
+#include "ListPool.hpp"
 #include "Module.hpp"
 #include "Natives.hpp"
 #include "Value.hpp"
 
 #include <memory>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 struct CallFrame {
     Value *stack{};
     Chunk *return_chunk{};
-    Chunk::InstructionSizeType *return_ip{};
+    const Chunk::InstructionSizeType *return_ip{};
+    ListArena::Mark arena_mark{}; // Everything allocated from the list arena after this is released on return
 };
 
 enum class ExecutionState { RUNNING = 0, FINISHED = 1 };
@@ -25,7 +29,7 @@ class VirtualMachine {
     constexpr static std::size_t stack_size = 32768;
     constexpr static std::size_t frame_size = 1024;
 
-    Chunk::InstructionSizeType *ip{};
+    const Chunk::InstructionSizeType *ip{};
 
     std::unique_ptr<Value[]> stack{};
     std::size_t stack_top{};
@@ -34,6 +38,11 @@ class VirtualMachine {
     std::size_t frame_top{};
 
     StringCacher cache{};
+    ListPool list_pool{};
+    ListArena list_arena{};
+    // Lists that are waiting to be freed, along with the index of the next element of each that is yet to be released
+    std::vector<std::pair<Value::ListType *, std::size_t>> dead_lists{};
+    std::size_t free_budget{}; // The number of elements to release per sweep, zero meaning all of them
     std::unordered_map<std::string_view, NativeFn> natives{};
 
     Chunk *current_chunk{};
@@ -49,7 +58,10 @@ class VirtualMachine {
 
     std::size_t get_current_line() const noexcept;
     Value::ListType *make_new_list();
+    Value::ListType *make_frame_list();
     void destroy_list(Value::ListType *list);
+    void destroy_frame_list(Value::ListType *list);
+    void sweep_dead_lists(std::size_t budget);
     Value copy(Value &value);
     void copy_into(Value::ListType *list, Value::ListType *what);
 
@@ -63,6 +75,9 @@ class VirtualMachine {
     void run(RuntimeModule &module);
     ExecutionState step();
     [[nodiscard]] const HashedString &store_string(std::string str);
+    [[nodiscard]] const ListPool &get_list_pool() const noexcept;
+    [[nodiscard]] const ListArena &get_list_arena() const noexcept;
+    void set_free_budget(std::size_t budget) noexcept;
 };
 
 #endif
\ No newline at end of file
@@ -10,22 +10,23 @@ LiteralValue::LiteralValue(std::nullptr_t) : value{nullptr} {}
 LiteralValue::LiteralValue(const std::string &value) : value{value} {}
 LiteralValue::LiteralValue(std::string &&value) : value{std::move(value)} {}
 
-ExprTypeInfo::ExprTypeInfo(QualifiedTypeInfo info, Token token, bool is_lvalue)
-    : info{info}, token{std::move(token)}, is_lvalue{is_lvalue}, scope_type{ScopeType::NONE} {}
-ExprTypeInfo::ExprTypeInfo(QualifiedTypeInfo info, FunctionStmt *func, Token token, bool is_lvalue)
-    : info{info}, func{func}, token{std::move(token)}, is_lvalue{is_lvalue}, scope_type{ScopeType::NONE} {}
-ExprTypeInfo::ExprTypeInfo(QualifiedTypeInfo info, ClassStmt *class_, Token token, bool is_lvalue)
-    : info{info}, class_{class_}, token{std::move(token)}, is_lvalue{is_lvalue}, scope_type{ScopeType::CLASS} {}
-ExprTypeInfo::ExprTypeInfo(QualifiedTypeInfo info, std::size_t module_index, Token token)
+ExprTypeInfo::ExprTypeInfo(QualifiedTypeInfo info, TokenLocation token, bool is_lvalue)
+    : info{info}, token{token}, is_lvalue{is_lvalue}, scope_type{ScopeType::NONE} {}
+ExprTypeInfo::ExprTypeInfo(QualifiedTypeInfo info, FunctionStmt *func, TokenLocation token, bool is_lvalue)
+    : info{info}, func{func}, token{token}, is_lvalue{is_lvalue}, scope_type{ScopeType::NONE} {}
+ExprTypeInfo::ExprTypeInfo(QualifiedTypeInfo info, ClassStmt *class_, TokenLocation token, bool is_lvalue)
+    : info{info}, class_{class_}, token{token}, is_lvalue{is_lvalue}, scope_type{ScopeType::CLASS} {}
+ExprTypeInfo::ExprTypeInfo(QualifiedTypeInfo info, std::size_t module_index, TokenLocation token)
     : info{info},
       module_index{module_index},
-      token{std::move(token)},
+      token{token},
       is_lvalue{false},
       scope_type{ScopeType::MODULE} {}
-ExprTypeInfo::ExprTypeInfo(QualifiedTypeInfo info, FunctionStmt *func, ClassStmt *class_, Token token, bool is_lvalue)
+ExprTypeInfo::ExprTypeInfo(
+    QualifiedTypeInfo info, FunctionStmt *func, ClassStmt *class_, TokenLocation token, bool is_lvalue)
     : info{info},
       func{func},
       class_{class_},
-      token{std::move(token)},
+      token{token},
       is_lvalue{is_lvalue},
       scope_type{ScopeType::NONE} {}
\ No newline at end of file
@@ -31,17 +31,18 @@ struct ExprTypeInfo {
         std::size_t module_index;
         std::size_t stack_slot;
     };
-    Token token{};
+    TokenLocation token{};
     bool is_lvalue;
     enum class ScopeType { CLASS, MODULE, NONE } scope_type{};
 
     ExprTypeInfo() = default;
     ExprTypeInfo(const ExprTypeInfo &) = default;
-    ExprTypeInfo(QualifiedTypeInfo info, Token token, bool is_lvalue = false);
-    ExprTypeInfo(QualifiedTypeInfo info, FunctionStmt *func, Token token, bool is_lvalue = false);
-    ExprTypeInfo(QualifiedTypeInfo info, ClassStmt *class_, Token token, bool is_lvalue = false);
-    ExprTypeInfo(QualifiedTypeInfo info, std::size_t module_index, Token token);
-    ExprTypeInfo(QualifiedTypeInfo info, FunctionStmt *func, ClassStmt *class_, Token token, bool is_lvalue = false);
+    ExprTypeInfo(QualifiedTypeInfo info, TokenLocation token, bool is_lvalue = false);
+    ExprTypeInfo(QualifiedTypeInfo info, FunctionStmt *func, TokenLocation token, bool is_lvalue = false);
+    ExprTypeInfo(QualifiedTypeInfo info, ClassStmt *class_, TokenLocation token, bool is_lvalue = false);
+    ExprTypeInfo(QualifiedTypeInfo info, std::size_t module_index, TokenLocation token);
+    ExprTypeInfo(
+        QualifiedTypeInfo info, FunctionStmt *func, ClassStmt *class_, TokenLocation token, bool is_lvalue = false);
 };
 
 struct LiteralValue {
@@ -155,19 +155,19 @@ def declare_stmt_type(name: str, ctor_args: str, members: str, typedefs: List[st
 if __name__ == '__main__':
     with open('AST.hpp', 'wt') as file:
         make_header(file, 'AST_HPP')
+        file.write('#include "NodeArena.hpp"\n')
         file.write('#include "Token.hpp"\n')
         file.write('#include "VisitorTypes.hpp"\n\n')
 
-        file.write('#include <memory>\n')
         file.write('#include <string>\n')
         file.write('#include <string_view>\n')
         file.write('#include <tuple>\n')
         file.write('#include <vector>\n\n')
         forward_declare(file, ['Expr', 'Stmt', 'BaseType'])
         file.write('\n')
-        declare_alias(file, 'ExprNode', 'std::unique_ptr<Expr>')
-        declare_alias(file, 'StmtNode', 'std::unique_ptr<Stmt>')
-        declare_alias(file, 'TypeNode', 'std::unique_ptr<BaseType>')
+        declare_alias(file, 'ExprNode', 'NodeHandle<Expr>')
+        declare_alias(file, 'StmtNode', 'NodeHandle<Stmt>')
+        declare_alias(file, 'TypeNode', 'NodeHandle<BaseType>')
         file.write('\n')
         declare_alias(file, 'RequiresCopy', 'bool')
         # Base class and alias declarations complete
@@ -175,7 +175,7 @@ if __name__ == '__main__':
         Exprs: List[str] = ['Assign', 'Binary', 'Call', 'Comma', 'Get', 'Grouping', 'Index', 'List', 'ListAssign',
                             'Literal', 'Logical', 'ScopeAccess', 'ScopeName', 'Set', 'Super', 'Ternary', 'This',
                             'Tuple', 'Unary', 'Variable']
-        Stmts: List[str] = ['Block', 'Break', 'Class', 'Continue', 'Expression', 'Function',
+        Stmts: List[str] = ['Block', 'Break', 'Class', 'Continue', 'Expression', 'ForEach', 'Function',
                             'If', 'Return', 'Switch', 'Type', 'Var', 'While']
         Types: List[str] = ['Primitive', 'UserDefined', 'List', 'Tuple', 'Typeof']
 
@@ -285,7 +285,7 @@ if __name__ == '__main__':
 
         declare_expr_type('List',
                           'bracket{std::move(bracket)}, elements{std::move(elements)}, type{std::move(type)}',
-                          'Token bracket, std::vector<ElementType> elements, std::unique_ptr<ListType> type',
+                          'Token bracket, std::vector<ElementType> elements, NodeHandle<ListType> type',
                           ['using ElementType = std::tuple<ExprNode, NumericConversionType, RequiresCopy>'])
 
         declare_expr_type('ListAssign',
@@ -330,7 +330,7 @@ if __name__ == '__main__':
 
         declare_expr_type('Tuple',
                           'brace{std::move(brace)}, elements{std::move(elements)}, type{std::move(type)}',
-                          'Token brace, std::vector<ElementType> elements, std::unique_ptr<TupleType> type',
+                          'Token brace, std::vector<ElementType> elements, NodeHandle<TupleType> type',
                           ['using ElementType = std::tuple<ExprNode, NumericConversionType, RequiresCopy>'])
 
         declare_expr_type('Unary',
@@ -363,8 +363,8 @@ if __name__ == '__main__':
                           'std::move(methods)}',
                           'Token name, FunctionStmt *ctor, FunctionStmt *dtor, std::vector<MemberType> members, '
                           'std::vector<MethodType> methods',
-                          ['using MemberType = std::pair<std::unique_ptr<VarStmt>,VisibilityType>',
-                           'using MethodType = std::pair<std::unique_ptr<FunctionStmt>,VisibilityType>'])
+                          ['using MemberType = std::pair<NodeHandle<VarStmt>,VisibilityType>',
+                           'using MethodType = std::pair<NodeHandle<FunctionStmt>,VisibilityType>'])
 
         declare_stmt_type('Continue',
                           'keyword{std::move(keyword)}',
@@ -374,6 +374,11 @@ if __name__ == '__main__':
                           'expr{std::move(expr)}',
                           'ExprNode expr')
 
+        declare_stmt_type('ForEach',
+                          'keyword{std::move(keyword)}, name{std::move(name)}, iterable{std::move(iterable)}, '
+                          'body{std::move(body)}, type{std::move(type)}',
+                          'Token keyword, Token name, ExprNode iterable, StmtNode body, TypeNode type')
+
         declare_stmt_type('Function',
                           'name{std::move(name)}, return_type{std::move(return_type)}, params{std::move(params)}, '
                           'body{std::move(body)}, return_stmts{std::move(return_stmts)}, scope_depth{scope_depth}',
@@ -407,8 +412,9 @@ if __name__ == '__main__':
 
         declare_stmt_type('While',
                           'keyword{std::move(keyword)}, condition{std::move(condition)}, body{std::move(body)}, '
-                          'increment{std::move(increment)}',
-                          'Token keyword, ExprNode condition, StmtNode body, StmtNode increment')
+                          'increment{std::move(increment)}, stack_slot{stack_slot}',
+                          'Token keyword, ExprNode condition, StmtNode body, StmtNode increment, '
+                          'std::size_t stack_slot')
 
         file.write('// End of statement node definitions\n\n')
 
@@ -3,9 +3,10 @@
 #include "ASTPrinter.hpp"
 #include "CodeGen/CodeGen.hpp"
 #include "ErrorLogger/ErrorLogger.hpp"
-#include "Parser/Parser.hpp"
-#include "Parser/TypeResolver.hpp"
-#include "Scanner/Scanner.hpp"
+#include "ModuleCache.hpp"
+#include "Optimizer/ConstantFolder.hpp"
+#include "Parser/ModuleLoader.hpp"
+#include "VirtualMachine/Bytecode.hpp"
 #include "VirtualMachine/Disassembler.hpp"
 #include "VirtualMachine/VirtualMachine.hpp"
 
@@ -13,44 +14,141 @@
 #include <cxxopts.hpp>
 #include <fstream>
 #include <iostream>
+#include <sstream>
+#include <unordered_map>
 
-void run_module(const char *const main_module, cxxopts::ParseResult &result) {
+// Either runs the compiled main module or writes it to a file for wisVM to run
+void execute(RuntimeModule &module, cxxopts::ParseResult &result) {
+    if (result.count("emit-bytecode")) {
+        std::string path = result["emit-bytecode"].as<std::string>();
+        std::optional<std::string> file = bytecode::write(module);
+        std::ofstream output{path, std::ios::out | std::ios::binary | std::ios::trunc};
+        if (file.has_value()) {
+            output.write(file->data(), static_cast<std::streamsize>(file->size()));
+        }
+        if (not file.has_value() || not output) {
+            compile_error({"Unable to write the bytecode to '", path, "'"});
+        }
+        return;
+    }
+
+    VirtualMachine vm{!!result.count("trace-exec-stack"), !!result.count("trace-exec-insn")};
+    vm.set_free_budget(result["free-budget"].as<std::size_t>());
+    vm.run(module);
+    if (result.count("list-pool-stats")) {
+        vm.get_list_pool().print_stats(std::cout);
+        vm.get_list_arena().print_stats(std::cout);
+    }
+}
+
+void run_module(const char *const main_module, const char *const argv0, cxxopts::ParseResult &result) {
     std::string main_path{main_module};
     std::ifstream file(main_path, std::ios::in);
-    std::string source{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
 
     std::size_t path_index = main_path.find_last_of('/');
     std::string main_dir = main_path.substr(0, path_index);
     std::string main_name = main_path.substr(path_index + 1);
 
+    Module main{main_name, main_dir + "/"};
+    main.path = main_path;
+    std::string_view source =
+        main.store(std::string{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}});
+
     logger.set_module_name(main_name);
     logger.set_source(source);
-    Scanner scanner{source};
 
-    Module main{main_name, main_dir + "/"};
+    // Only the options that change the code that is generated are a part of the key of a cache entry
+    std::uint64_t codegen_options = (result.count("no-inline") ? 1 : 0) | (result.count("no-ir") ? 2 : 0);
+    std::filesystem::path cache_directory{};
+    if (not result.count("no-cache")) {
+        cache_directory = result.count("cache-dir") ? std::filesystem::path{result["cache-dir"].as<std::string>()}
+                                                    : ModuleCache::default_directory();
+    }
+    ModuleCache cache{cache_directory, codegen_options, ModuleCache::running_compiler(argv0)};
+    ModuleCache::Source main_source = ModuleCache::source_of(main, true);
+
+    // Whatever looks at the AST or at the code generator needs the front end to run
+    bool needs_front_end = result.count("check") || result.count("dump-ast") || result.count("dump-ir") ||
+                           result.count("inline-report") || result.count("disassemble-code");
+    if (not needs_front_end) {
+        if (std::optional<ModuleCache::Entry> cached = cache.load(main_source); cached.has_value()) {
+            std::cerr << cached->messages;
+            std::cout << cached->output;
+            execute(cached->compiled, result);
+            return;
+        }
+    }
 
-    Parser parser{scanner.scan(), main, 0};
-    TypeResolver resolver{main};
-    main.statements = parser.program();
-    resolver.check(main.statements);
+    // The messages are collected so that the cache can print them again when the compiled module is used
+    std::ostringstream front_end_messages{};
+    logger.set_output(front_end_messages);
+    ModuleLoader loader{result["jobs"].as<std::size_t>()};
+    loader.load(main);
+    logger.set_output(std::cerr);
+    std::cerr << front_end_messages.str();
+    std::vector<std::pair<Module, std::size_t>> &modules = loader.get_modules();
     if (result.count("dump-ast")) {
         ASTPrinter{}.print_stmts(main.statements);
     }
 
     if (not result.count("check") && not logger.had_error) {
-        std::sort(Parser::parsed_modules.begin(), Parser::parsed_modules.end(),
-            [](const auto &x1, const auto &x2) { return x1.second > x2.second; });
+        // The entries of the modules are keyed on the sources they import, which are found through the indexes that
+        // sorting the modules makes useless
+        std::unordered_map<std::string, std::vector<ModuleCache::Source>> imported_sources{};
+        std::vector<ModuleCache::Source> main_imports{};
+        if (cache.enabled()) {
+            for (auto &module : modules) {
+                imported_sources[module.first.name] = ModuleCache::imported_sources(module.first, modules);
+            }
+            main_imports = ModuleCache::imported_sources(main, modules);
+        }
+
+        std::sort(modules.begin(), modules.end(), [](const auto &x1, const auto &x2) { return x1.second > x2.second; });
 
-        for (auto &module : Parser::parsed_modules) {
-            std::cout << module.first.name << " -> depth: " << module.second << "\n";
+        // What is printed here is kept in the entry of the main module, so that using the entry prints it too
+        std::ostringstream import_depths{};
+        for (auto &module : modules) {
+            import_depths << module.first.name << " -> depth: " << module.second << "\n";
         }
+        std::cout << import_depths.str();
+
+        ConstantFolder folder{};
+        for (auto &module : modules) {
+            folder.fold(module.first);
+        }
+        folder.fold(main);
 
         Generator generator{};
-        for (auto &module : Parser::parsed_modules) {
-            Generator::compiled_modules.emplace_back(generator.compile(module.first));
+        generator.set_inline_calls(not result.count("no-inline"));
+        generator.set_use_ir(not result.count("no-ir"));
+        for (auto &module : modules) {
+            ModuleCache::Source module_source = ModuleCache::source_of(module.first);
+            if (std::optional<ModuleCache::Entry> cached = cache.load(module_source); cached.has_value()) {
+                Generator::compiled_modules.emplace_back(std::move(cached->compiled));
+            } else {
+                RuntimeModule &compiled = Generator::compiled_modules.emplace_back(generator.compile(module.first));
+                // The top level code of an imported module is never run, but an entry is only read back if every chunk
+                // in it ends in an instruction that stops it
+                compiled.top_level_code.emit_instruction(Instruction::HALT, 0);
+                cache.store(module_source, imported_sources[module.first.name], compiled);
+            }
         }
         RuntimeModule main_compiled = generator.compile(main);
         main_compiled.top_level_code.emit_instruction(Instruction::HALT, 0);
+        if (not logger.had_error) {
+            cache.store(main_source, main_imports, main_compiled, front_end_messages.str(), import_depths.str());
+        }
+
+        if (result.count("dump-ir")) {
+            for (auto &function : generator.get_ir_functions()) {
+                function->print(std::cout);
+                std::cout << '\n';
+            }
+        }
+
+        if (result.count("inline-report")) {
+            generator.get_inliner().print_report(std::cout);
+        }
 
         if (result.count("disassemble-code")) {
             disassemble(main_compiled.top_level_code, main_name);
@@ -58,10 +156,16 @@ void run_module(const char *const main_module, cxxopts::ParseResult &result) {
             for (auto &[function_name, function] : main_compiled.functions) {
                 disassemble(function.code, function_name);
             }
+            std::cout << "\nPeephole optimizer removed " << generator.get_peephole_optimizer().removed()
+                      << " instruction(s)\n";
+            std::cout << "Hoisted " << generator.get_loop_invariants().hoisted()
+                      << " loop-invariant expression(s) out of loop conditions\n";
+            std::cout << "Eliminated " << generator.get_bounds_checks().eliminated() << " bounds check(s)\n";
+            std::cout << "Allocated " << generator.get_escape_analysis().found()
+                      << " non-escaping list(s) in function frames\n";
         }
 
-        VirtualMachine vm{!!result.count("trace-exec-stack"), !!result.count("trace-exec-insn")};
-        vm.run(main_compiled);
+        execute(main_compiled, result);
     }
 }
 
@@ -72,10 +176,20 @@ int main(int argc, char *argv[]) {
     options.add_options()
         ("check", "Do not run the code, only parse and type check it")
         ("dump-ast", "Dump the contents of the AST after parsing and typechecking", cxxopts::value<bool>()->default_value("false"))
+        ("dump-ir", "Dump the IR of the functions that are compiled through it, after it has been optimized", cxxopts::value<bool>()->default_value("false"))
         ("disassemble-code", "Disassemble the byte code produced for the VM", cxxopts::value<bool>()->default_value("false"))
         ("main", "The module from which to start execution", cxxopts::value<std::string>())
+        ("jobs", "The number of threads to load imported modules on (0 uses one for every core)", cxxopts::value<std::size_t>()->default_value("0"))
         ("trace-exec-stack", "Print the contents of the stack as the VM executes code", cxxopts::value<bool>()->default_value("false"))
         ("trace-exec-insn", "Print the instructions as they are executed by the VM", cxxopts::value<bool>()->default_value("false"))
+        ("list-pool-stats", "Print the statistics of the list allocator after execution", cxxopts::value<bool>()->default_value("false"))
+        ("free-budget", "Release dead lists incrementally, this many elements per list allocation or destruction (0 releases them immediately)", cxxopts::value<std::size_t>()->default_value("0"))
+        ("no-inline", "Do not inline calls to small functions", cxxopts::value<bool>()->default_value("false"))
+        ("inline-report", "Print the function calls that were inlined", cxxopts::value<bool>()->default_value("false"))
+        ("no-ir", "Compile every function straight from the AST instead of through the IR", cxxopts::value<bool>()->default_value("false"))
+        ("no-cache", "Do not use or write the cache of compiled modules", cxxopts::value<bool>()->default_value("false"))
+        ("emit-bytecode", "Write the compiled code to the given file for wisVM to run, instead of running it", cxxopts::value<std::string>())
+        ("cache-dir", "Where to keep the cache of compiled modules (the default is $XDG_CACHE_HOME/wis or ~/.cache/wis)", cxxopts::value<std::string>())
         ("h,help", "Print usage");
     // clang-format on
 
@@ -85,7 +199,7 @@ int main(int argc, char *argv[]) {
             std::cout << options.help() << '\n';
             return 0;
         } else if (result.count("main")) {
-            run_module(result["main"].as<std::string>().c_str(), result);
+            run_module(result["main"].as<std::string>().c_str(), argv[0], result);
         }
     } catch (cxxopts::OptionException &ex) { std::cout << ex.what() << '\n'; }
     return 0;
@@ -1,10 +1,83 @@
 #!/usr/bin/env bash
 
 WIS=$(find ../ -name wis | head -n 1)
+WISVM=$(find ../ -name wisVM | head -n 1)
 
-for i in $(find ./ -type f); do
-  if ! [[ ${i} =~ RunTests.sh ]]; then
-    echo "Running ${i}"
-    ${WIS} --main ${i}
+# Options that only change how a program is compiled or run, which must never change what it prints
+SAME_OUTPUT_OPTIONS=("--no-inline" "--no-ir" "--free-budget 1" "--jobs 1" "--jobs 8")
+
+status=0
+for i in $(find ./ -type f -name '*.wis'); do
+  echo "Running ${i}"
+  # Every test starts from an empty cache of its own, so that neither earlier runs nor the cache of the user can change
+  # what it prints
+  cache=$(mktemp -d)
+  output=$(${WIS} --cache-dir ${cache} --main ${i} 2>&1)
+  echo "${output}"
+  # A test with a .out file next to it has to print exactly what is in the file
+  if [[ -f ${i%.wis}.out ]] && ! diff <(echo "${output}") ${i%.wis}.out; then
+    echo "FAILED ${i}"
+    status=1
+  fi
+  # Running it again uses the entries written by the first run
+  if ! diff <(echo "${output}") <(echo "$(${WIS} --cache-dir ${cache} --main ${i} 2>&1)"); then
+    echo "FAILED ${i} from the cache"
+    status=1
+  fi
+  rm -rf ${cache}
+  # Without the cache, so that the options change how the program is compiled and not only how it is run
+  for option in "${SAME_OUTPUT_OPTIONS[@]}"; do
+    if ! diff <(echo "${output}") <(echo "$(${WIS} --no-cache ${option} --main ${i} 2>&1)"); then
+      echo "FAILED ${i} with ${option}"
+      status=1
+    fi
+  done
+done
+
+# Changing a module that the main module imports, even indirectly, has to make the entry of the main module stale
+echo "Running the cache with a changed import"
+cache=$(mktemp -d)
+modules=$(mktemp -d)
+cp ./Modules/Diamond/*.wis ${modules}
+before=$(${WIS} --cache-dir ${cache} --main ${modules}/Main.wis 2>&1)
+sed -i -e 's/-> int {/-> string {/' -e 's/return x \* 2/return string(x * 2)/' ${modules}/Shared.wis
+after=$(${WIS} --cache-dir ${cache} --main ${modules}/Main.wis 2>&1)
+if [[ "${before}" == "${after}" ]] ||
+  ! diff <(echo "${after}") <(echo "$(${WIS} --no-cache --main ${modules}/Main.wis 2>&1)"); then
+  echo "FAILED the cache with a changed import"
+  status=1
+fi
+rm -rf ${cache} ${modules}
+
+# The programs in Bytecode/ are also written to a file with --emit-bytecode and run by wisVM, which has to print the
+# same thing as running them directly. The same file cut in half, or with the operand of every instruction pointing far
+# outside of its chunk, has to be rejected instead of run
+bytecode=$(mktemp)
+for i in $(find ./Bytecode -type f -name '*.wis'); do
+  echo "Running ${i} with wisVM"
+  if ! ${WIS} --no-cache --emit-bytecode ${bytecode} --main ${i} ||
+    ! diff <(echo "$(${WIS} --no-cache --main ${i} 2>&1)") <(echo "$(${WISVM} --file ${bytecode} 2>&1)"); then
+    echo "FAILED ${i} with wisVM"
+    status=1
+  fi
+  head -c $(($(wc -c < ${bytecode}) / 2)) ${bytecode} > ${bytecode}.truncated
+  # wisVM exits with 1 when it rejects a file, anything else means that it ran the file (or crashed on it)
+  ${WISVM} --file ${bytecode}.truncated > /dev/null 2>&1
+  if [[ $? -ne 1 ]]; then
+    echo "FAILED ${i} with wisVM: a truncated bytecode file was run"
+    status=1
+  fi
+  # The offset and the number of instructions of the code section are in the header, 80 bytes from its start
+  read -r code_offset code_count <<< "$(od -An -t u8 -j 80 -N 16 ${bytecode})"
+  cp ${bytecode} ${bytecode}.corrupted
+  for ((j = 0; j < code_count; j++)); do
+    printf '\xf0\xff\xff' | dd of=${bytecode}.corrupted bs=1 seek=$((code_offset + 4 * j)) conv=notrunc status=none
+  done
+  ${WISVM} --file ${bytecode}.corrupted > /dev/null 2>&1
+  if [[ $? -ne 1 ]]; then
+    echo "FAILED ${i} with wisVM: a bytecode file with operands outside of its chunks was run"
+    status=1
   fi
-done
\ No newline at end of file
+done
+rm -f ${bytecode} ${bytecode}.truncated ${bytecode}.corrupted
+exit ${status}